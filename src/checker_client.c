@@ -0,0 +1,527 @@
+
+#define _GNU_SOURCE // for pipe2
+
+#include "checker_client.h"
+#include <errno.h>                       // for errno, EINTR
+#include <fcntl.h>                       // for O_CLOEXEC, fcntl, F_SETFD
+#include <pthread.h>                     // for pthread_create, pthread_cond_wait, ...
+#include <signal.h>                      // for sigset_t, sigaddset, SIGPIPE
+#include <stdio.h>                       // for snprintf
+#include <stdlib.h>                      // for free
+#include <string.h>                      // for memcpy, strcmp, strerror
+#include <sys/wait.h>                    // for waitpid, WIFEXITED, WEXITSTATUS
+#include <unistd.h>                      // for fork, execv, read, write, close
+#include "trusted/checker_interface.h"   // for TRUSTED_CHK_*
+#include "trusted/trusted_utils.h"       // for trusted_utils_malloc, trusted_utils_msgstr
+
+// A directive whose answer is outstanding.
+struct pending {
+    char directive;
+    u64 id;
+    bool has_sig; // the answer carries a signature
+    struct checker_future* future;
+};
+
+struct checker_client {
+    pid_t pid;
+    int fd_directives;
+    int fd_feedback;
+    pthread_t writer;
+    pthread_t reader;
+    void (*on_answer)(void* user, const struct checker_answer* answer);
+    void* user;
+
+    // Outgoing directives: the bytes [tail, head) of a ring buffer. The caller
+    // encodes each directive at position end and then publishes it by moving
+    // head to end; the writer thread writes the published bytes and moves tail.
+    u8* queue;
+    u64 queue_capacity; // power of two
+    u64 head;
+    u64 end;
+    u64 tail;
+
+    // Outstanding answers: the records [nb_answered, nb_submitted) of a ring
+    // buffer of nb_records records, submitted by the caller and completed
+    // by the reader thread in the order of the directives. Besides up to
+    // max_in_flight directives, one record is reserved for a flush query.
+    struct pending* pending;
+    u64 max_in_flight;
+    u64 nb_records;
+    u64 nb_submitted;
+    u64 nb_answered;
+    // Directives after which the checker flushes its answers (see
+    // IMPCHECK_FLUSH_ALWAYS): the number of records up to the last such one.
+    u64 nb_flushed;
+
+    // With -overlap-load, the checker withholds its answers to the directives
+    // after INIT while the formula is loaded, i.e., until END_LOAD.
+    bool overlap_load;
+    bool loading;
+
+    bool failed; // some answer has been negative
+    bool closed; // the checker has stopped answering or a pipe has failed
+    bool stopping;
+
+    // Only for sleeping and waking up; the queues themselves are lock-free.
+    // Each side announces that it sleeps before re-checking its condition,
+    // and each waker checks for a sleeper after making progress.
+    pthread_mutex_t mutex;
+    pthread_cond_t cond_writer;
+    pthread_cond_t cond_caller;
+    bool writer_sleeping;
+    bool caller_sleeping;
+};
+
+#define LOAD(x) __atomic_load_n(&(x), __ATOMIC_SEQ_CST)
+#define STORE(x, val) __atomic_store_n(&(x), (val), __ATOMIC_SEQ_CST)
+
+void client_wake(struct checker_client* c, bool* sleeping, pthread_cond_t* cond) {
+    if (!LOAD(*sleeping)) return;
+    pthread_mutex_lock(&c->mutex);
+    pthread_cond_broadcast(cond);
+    pthread_mutex_unlock(&c->mutex);
+}
+
+void client_close(struct checker_client* c) {
+    pthread_mutex_lock(&c->mutex);
+    STORE(c->closed, true);
+    pthread_cond_broadcast(&c->cond_caller);
+    pthread_mutex_unlock(&c->mutex);
+}
+
+// Conditions the caller can wait for
+bool client_has_space(struct checker_client* c, const void* arg) {
+    (void) arg;
+    return c->end - LOAD(c->tail) < c->queue_capacity;
+}
+bool client_has_slot(struct checker_client* c, const void* arg) {
+    (void) arg;
+    return c->nb_submitted - LOAD(c->nb_answered) < c->max_in_flight;
+}
+bool client_flush_arrived(struct checker_client* c, const void* arg) {
+    (void) arg;
+    return LOAD(c->nb_answered) >= c->nb_flushed;
+}
+bool future_is_done(struct checker_client* c, const void* arg) {
+    (void) c;
+    return LOAD(((struct checker_future*) arg)->done);
+}
+
+// Block the caller until ready(c, arg) holds or the client is closed.
+// Returns whether ready(c, arg) holds.
+bool client_wait(struct checker_client* c, bool (*ready)(struct checker_client*, const void*), const void* arg) {
+    if (ready(c, arg)) return true;
+    pthread_mutex_lock(&c->mutex);
+    STORE(c->caller_sleeping, true);
+    while (!ready(c, arg) && !LOAD(c->closed)) pthread_cond_wait(&c->cond_caller, &c->mutex);
+    STORE(c->caller_sleeping, false);
+    pthread_mutex_unlock(&c->mutex);
+    return ready(c, arg);
+}
+
+void client_publish(struct checker_client* c) {
+    if (c->head == c->end) return;
+    STORE(c->head, c->end);
+    client_wake(c, &c->writer_sleeping, &c->cond_writer);
+}
+
+void client_push(struct checker_client* c, const void* data, u64 nb_bytes) {
+    const u8* bytes = data;
+    while (nb_bytes > 0) {
+        if (!client_has_space(c, 0)) {
+            // let the writer make room (a directive may exceed the queue)
+            client_publish(c);
+            if (!client_wait(c, client_has_space, 0)) return;
+        }
+        const u64 pos = c->end & (c->queue_capacity-1);
+        u64 n = c->queue_capacity - (c->end - LOAD(c->tail));
+        if (n > c->queue_capacity - pos) n = c->queue_capacity - pos;
+        if (n > nb_bytes) n = nb_bytes;
+        memcpy(c->queue + pos, bytes, n);
+        c->end += n;
+        bytes += n;
+        nb_bytes -= n;
+    }
+}
+void client_push_char(struct checker_client* c, char ch) {client_push(c, &ch, 1);}
+void client_push_int(struct checker_client* c, int i) {client_push(c, &i, sizeof(int));}
+void client_push_ul(struct checker_client* c, u64 u) {client_push(c, &u, sizeof(u64));}
+
+void client_submit(struct checker_client* c, char directive, u64 id, bool has_sig, struct checker_future* future) {
+    struct pending* p = &c->pending[c->nb_submitted % c->nb_records];
+    p->directive = directive;
+    p->id = id;
+    p->has_sig = has_sig;
+    p->future = future;
+    if (future) {
+        future->seq = c->nb_submitted;
+        future->done = false;
+        future->ok = false;
+    }
+    // the record must be visible before the answer can arrive
+    STORE(c->nb_submitted, c->nb_submitted + 1);
+    client_push_char(c, directive);
+}
+
+// Complete a directive. If the checker flushes its answers after it, the
+// outstanding answers up to here are bound to arrive.
+bool client_finish(struct checker_client* c, bool flushed) {
+    if (flushed) c->nb_flushed = c->nb_submitted;
+    client_publish(c);
+    return !LOAD(c->closed);
+}
+
+// Report an error if the caller would wait for answers which the checker
+// withholds until END_LOAD (see overlap_load).
+bool client_awaits_end_load(struct checker_client* c) {
+    if (!c->loading) return false;
+    snprintf(trusted_utils_msgstr, 512, "Checker withholds its answers until END_LOAD (-overlap-load)");
+    return true;
+}
+
+// Make sure that the answers to the first nb_answers directives arrive.
+// Without IMPCHECK_FLUSH_ALWAYS, the checker may keep answers in its buffer:
+// query its statistics to make it flush. Only one such query is outstanding
+// at a time, which it awaits in the reserved record.
+bool client_ensure_flushed(struct checker_client* c, u64 nb_answers) {
+    if (c->nb_flushed >= nb_answers) return true;
+    if (client_awaits_end_load(c) || !client_wait(c, client_flush_arrived, 0)) return false;
+    client_submit(c, TRUSTED_CHK_QUERY_STATS, 0, false, 0);
+    return client_finish(c, true);
+}
+
+// Begin a directive which receives an answer.
+bool client_begin(struct checker_client* c, char directive, u64 id, bool has_sig, struct checker_future* future) {
+    if (LOAD(c->closed)) return false;
+    if (c->loading && directive == TRUSTED_CHK_END_LOAD) {
+        // may take the record reserved for a flush query since
+        // no such query is sent while loading
+    } else if (!client_has_slot(c, 0)) {
+        // the oldest outstanding answer must arrive to free a record
+        if (!client_ensure_flushed(c, LOAD(c->nb_answered) + 1)
+            || !client_wait(c, client_has_slot, 0)) return false;
+    }
+    client_submit(c, directive, id, has_sig, future);
+    return true;
+}
+
+bool client_read(int fd, void* data, u64 nb_bytes) {
+    u8* bytes = data;
+    while (nb_bytes > 0) {
+        const ssize_t n = read(fd, bytes, nb_bytes);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        bytes += n;
+        nb_bytes -= n;
+    }
+    return true;
+}
+
+void* client_run_writer(void* arg) {
+    struct checker_client* c = arg;
+    // Report a closed pipe as an error of write() instead of a signal
+    sigset_t sigpipe;
+    sigemptyset(&sigpipe);
+    sigaddset(&sigpipe, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &sigpipe, 0);
+
+    while (true) {
+        const u64 tail = c->tail;
+        if (LOAD(c->head) == tail) {
+            if (LOAD(c->stopping)) break;
+            pthread_mutex_lock(&c->mutex);
+            STORE(c->writer_sleeping, true);
+            while (LOAD(c->head) == tail && !LOAD(c->stopping)) pthread_cond_wait(&c->cond_writer, &c->mutex);
+            STORE(c->writer_sleeping, false);
+            pthread_mutex_unlock(&c->mutex);
+            continue;
+        }
+        // write everything published so far (up to the end of the buffer)
+        const u64 pos = tail & (c->queue_capacity-1);
+        u64 n = LOAD(c->head) - tail;
+        if (n > c->queue_capacity - pos) n = c->queue_capacity - pos;
+        const ssize_t nb_written = write(c->fd_directives, c->queue + pos, n);
+        if (nb_written < 0 && errno == EINTR) continue;
+        if (nb_written <= 0) {
+            client_close(c);
+            break;
+        }
+        STORE(c->tail, tail + nb_written);
+        client_wake(c, &c->caller_sleeping, &c->cond_caller);
+    }
+    close(c->fd_directives);
+    return 0;
+}
+
+void* client_run_reader(void* arg) {
+    struct checker_client* c = arg;
+    while (true) {
+        u8 res;
+        if (!client_read(c->fd_feedback, &res, 1)) break; // checker exited
+        const u64 seq = c->nb_answered;
+        if (seq == LOAD(c->nb_submitted)) break; // unexpected answer
+        const struct pending* p = &c->pending[seq % c->nb_records];
+        signature sig;
+        if (p->has_sig && !client_read(c->fd_feedback, sig, SIG_SIZE_BYTES)) break;
+        if (p->directive == TRUSTED_CHK_QUERY_STATS) {
+            // only used to make the checker flush: skip the report
+            int len;
+            if (!client_read(c->fd_feedback, &len, sizeof(int))) break;
+            char buf[512];
+            bool skipped = true;
+            for (int i = 0; skipped && i < len; i += 512)
+                skipped = client_read(c->fd_feedback, buf, len-i < 512 ? len-i : 512);
+            if (!skipped) break;
+        }
+        const bool ok = res == TRUSTED_CHK_RES_ACCEPT;
+        if (!ok) STORE(c->failed, true);
+        if (c->on_answer && p->directive != TRUSTED_CHK_QUERY_STATS) {
+            const struct checker_answer answer = {p->directive, p->id, ok, p->has_sig ? sig : 0};
+            c->on_answer(c->user, &answer);
+        }
+        if (p->future) {
+            p->future->ok = ok;
+            if (p->has_sig) memcpy(p->future->sig, sig, SIG_SIZE_BYTES);
+            STORE(p->future->done, true);
+        }
+        STORE(c->nb_answered, seq + 1);
+        client_wake(c, &c->caller_sleeping, &c->cond_caller);
+    }
+    client_close(c);
+    return 0;
+}
+
+void checker_client_default_options(struct checker_client_options* opts) {
+    opts->checker_path = 0;
+    opts->checker_args = 0;
+    opts->max_in_flight = 1<<14;
+    opts->queue_bytes = 1<<20;
+    opts->on_answer = 0;
+    opts->user = 0;
+}
+
+struct checker_client* checker_client_start(const struct checker_client_options* opts) {
+    if (opts->max_in_flight == 0 || opts->queue_bytes == 0) {
+        snprintf(trusted_utils_msgstr, 512, "Checker client needs a positive in-flight limit and queue size");
+        return 0;
+    }
+    if (!opts->checker_path) {
+        snprintf(trusted_utils_msgstr, 512, "Checker client needs the path of the impcheck_check executable");
+        return 0;
+    }
+    // Pipes for directives and feedback, and a pipe to report a failed exec
+    int fds_directives[2], fds_feedback[2], fds_exec[2];
+    int* pipes[3] = {fds_directives, fds_feedback, fds_exec};
+    for (int i = 0; i < 3; i++) {
+        if (pipe2(pipes[i], O_CLOEXEC) == 0) continue;
+        snprintf(trusted_utils_msgstr, 512, "Cannot create pipes: %s", strerror(errno));
+        // close the pipes created so far
+        while (i-- > 0) {
+            close(pipes[i][0]);
+            close(pipes[i][1]);
+        }
+        return 0;
+    }
+    int nb_args = 0;
+    bool overlap_load = false;
+    while (opts->checker_args && opts->checker_args[nb_args]) {
+        if (strcmp(opts->checker_args[nb_args], "-overlap-load") == 0) overlap_load = true;
+        nb_args++;
+    }
+    char arg_directives[64], arg_feedback[64];
+    snprintf(arg_directives, 64, "-fifo-directives=/dev/fd/%i", fds_directives[0]);
+    snprintf(arg_feedback, 64, "-fifo-feedback=/dev/fd/%i", fds_feedback[1]);
+    char** argv = trusted_utils_calloc(nb_args+4, sizeof(char*));
+    argv[0] = (char*) opts->checker_path;
+    argv[1] = arg_directives;
+    argv[2] = arg_feedback;
+    for (int i = 0; i < nb_args; i++) argv[3+i] = (char*) opts->checker_args[i];
+
+    const pid_t pid = fork();
+    if (pid == 0) {
+        // child: only async-signal-safe calls from here on
+        fcntl(fds_directives[0], F_SETFD, 0);
+        fcntl(fds_feedback[1], F_SETFD, 0);
+        execv(opts->checker_path, argv);
+        const int err = errno;
+        if (write(fds_exec[1], &err, sizeof(int)) < 0) {}
+        _exit(127);
+    }
+    free(argv);
+    close(fds_directives[0]);
+    close(fds_feedback[1]);
+    close(fds_exec[1]);
+    int exec_err = 0;
+    const bool exec_failed = pid < 0 || client_read(fds_exec[0], &exec_err, sizeof(int));
+    close(fds_exec[0]);
+    if (exec_failed) {
+        snprintf(trusted_utils_msgstr, 512, "Cannot run checker %.400s: %s", opts->checker_path,
+            strerror(pid < 0 ? errno : exec_err));
+        if (pid > 0) waitpid(pid, 0, 0);
+        close(fds_directives[1]);
+        close(fds_feedback[0]);
+        return 0;
+    }
+
+    struct checker_client* c = trusted_utils_calloc(1, sizeof(struct checker_client));
+    c->pid = pid;
+    c->fd_directives = fds_directives[1];
+    c->fd_feedback = fds_feedback[0];
+    c->on_answer = opts->on_answer;
+    c->user = opts->user;
+    c->overlap_load = overlap_load;
+    c->queue_capacity = 1;
+    while (c->queue_capacity < opts->queue_bytes) c->queue_capacity *= 2;
+    c->queue = trusted_utils_malloc(c->queue_capacity);
+    c->max_in_flight = opts->max_in_flight;
+    c->nb_records = c->max_in_flight + 1;
+    c->pending = trusted_utils_calloc(c->nb_records, sizeof(struct pending));
+    pthread_mutex_init(&c->mutex, 0);
+    pthread_cond_init(&c->cond_writer, 0);
+    pthread_cond_init(&c->cond_caller, 0);
+    if (pthread_create(&c->writer, 0, client_run_writer, c) != 0) abort();
+    if (pthread_create(&c->reader, 0, client_run_reader, c) != 0) abort();
+    return c;
+}
+
+bool checker_client_init(struct checker_client* c, int nb_vars, const u8* formula_sig,
+    struct checker_future* future_or_null) {
+    if (!client_begin(c, TRUSTED_CHK_INIT, 0, false, future_or_null)) return false;
+    client_push_int(c, nb_vars);
+    client_push(c, formula_sig, SIG_SIZE_BYTES);
+    c->loading = c->overlap_load;
+    return client_finish(c, true);
+}
+
+bool checker_client_load(struct checker_client* c, const int* lits, int nb_lits) {
+    if (LOAD(c->closed)) return false;
+    client_push_char(c, TRUSTED_CHK_LOAD); // no answer
+    client_push_int(c, nb_lits);
+    client_push(c, lits, nb_lits * sizeof(int));
+    return client_finish(c, false);
+}
+
+bool checker_client_end_load(struct checker_client* c, struct checker_future* future_or_null) {
+    if (!client_begin(c, TRUSTED_CHK_END_LOAD, 0, false, future_or_null)) return false;
+    c->loading = false;
+    return client_finish(c, true);
+}
+
+bool checker_client_add_increment(struct checker_client* c, u64 first_id, const int* lits, int nb_lits,
+    const u8* inc_sig, struct checker_future* future_or_null) {
+    if (!client_begin(c, TRUSTED_CHK_ADD_INCREMENT, first_id, false, future_or_null)) return false;
+    client_push_ul(c, first_id);
+    client_push_int(c, nb_lits);
+    client_push(c, lits, nb_lits * sizeof(int));
+    client_push(c, inc_sig, SIG_SIZE_BYTES);
+    return client_finish(c, true);
+}
+
+bool checker_client_produce(struct checker_client* c, u64 id, const int* lits, int nb_lits,
+    const u64* hints, int nb_hints, bool share, struct checker_future* future_or_null) {
+    if (!client_begin(c, TRUSTED_CHK_CLS_PRODUCE, id, share, future_or_null)) return false;
+    client_push_ul(c, id);
+    client_push_int(c, nb_lits);
+    client_push(c, lits, nb_lits * sizeof(int));
+    client_push_int(c, nb_hints);
+    client_push(c, hints, nb_hints * sizeof(u64));
+    client_push_char(c, share ? 1 : 0);
+    return client_finish(c, false);
+}
+
+bool checker_client_import(struct checker_client* c, u64 id, const int* lits, int nb_lits,
+    const u8* sig, struct checker_future* future_or_null) {
+    if (!client_begin(c, TRUSTED_CHK_CLS_IMPORT, id, false, future_or_null)) return false;
+    client_push_ul(c, id);
+    client_push_int(c, nb_lits);
+    client_push(c, lits, nb_lits * sizeof(int));
+    client_push(c, sig, SIG_SIZE_BYTES);
+    return client_finish(c, false);
+}
+
+bool checker_client_delete(struct checker_client* c, const u64* ids, int nb_ids,
+    struct checker_future* future_or_null) {
+    if (!client_begin(c, TRUSTED_CHK_CLS_DELETE, 0, false, future_or_null)) return false;
+    client_push_int(c, nb_ids);
+    client_push(c, ids, nb_ids * sizeof(u64));
+    return client_finish(c, false);
+}
+
+bool checker_client_delete_ranges(struct checker_client* c, const u64* ranges, int nb_ranges,
+    struct checker_future* future_or_null) {
+    if (!client_begin(c, TRUSTED_CHK_CLS_DELETE_RANGES, 0, false, future_or_null)) return false;
+    client_push_int(c, nb_ranges);
+    client_push(c, ranges, 3 * nb_ranges * sizeof(u64));
+    return client_finish(c, false);
+}
+
+bool checker_client_delete_bitmap(struct checker_client* c, u64 base_id, const u64* words, int nb_words,
+    struct checker_future* future_or_null) {
+    if (!client_begin(c, TRUSTED_CHK_CLS_DELETE_BITMAP, 0, false, future_or_null)) return false;
+    client_push_ul(c, base_id);
+    client_push_int(c, nb_words);
+    client_push(c, words, nb_words * sizeof(u64));
+    return client_finish(c, false);
+}
+
+bool checker_client_validate_unsat(struct checker_client* c, struct checker_future* future_or_null) {
+    if (!client_begin(c, TRUSTED_CHK_VALIDATE_UNSAT, 0, true, future_or_null)) return false;
+    return client_finish(c, true);
+}
+
+bool checker_client_validate_unsat_assuming(struct checker_client* c, const int* assumptions,
+    int nb_assumptions, u64 id, struct checker_future* future_or_null) {
+    if (!client_begin(c, TRUSTED_CHK_VALIDATE_UNSAT_ASSUMING, id, true, future_or_null)) return false;
+    client_push_int(c, nb_assumptions);
+    client_push(c, assumptions, nb_assumptions * sizeof(int));
+    client_push_ul(c, id);
+    return client_finish(c, true);
+}
+
+bool checker_client_validate_sat(struct checker_client* c, const int* model, int model_size,
+    struct checker_future* future_or_null) {
+    if (!client_begin(c, TRUSTED_CHK_VALIDATE_SAT, 0, true, future_or_null)) return false;
+    client_push_int(c, model_size);
+    client_push(c, model, model_size * sizeof(int));
+    return client_finish(c, true);
+}
+
+bool checker_future_wait(struct checker_client* c, struct checker_future* future) {
+    if (!LOAD(future->done) && !client_ensure_flushed(c, future->seq + 1))
+        return LOAD(future->done) && future->ok;
+    return client_wait(c, future_is_done, future) && future->ok;
+}
+
+bool checker_client_sync(struct checker_client* c) {
+    struct checker_future future;
+    if (client_awaits_end_load(c) || !client_begin(c, TRUSTED_CHK_QUERY_STATS, 0, false, &future)) return false;
+    client_finish(c, true);
+    return client_wait(c, future_is_done, &future) && !LOAD(c->failed);
+}
+
+bool checker_client_stop(struct checker_client* c) {
+    struct checker_future future;
+    bool ok = client_begin(c, TRUSTED_CHK_TERMINATE, 0, false, &future);
+    if (ok) {
+        // (the checker may well have exited by the time this returns)
+        client_finish(c, true);
+        ok = client_wait(c, future_is_done, &future) && future.ok && !LOAD(c->failed);
+    }
+    // the writer thread closes the pipe once all directives are written
+    pthread_mutex_lock(&c->mutex);
+    STORE(c->stopping, true);
+    pthread_cond_broadcast(&c->cond_writer);
+    pthread_mutex_unlock(&c->mutex);
+    pthread_join(c->writer, 0);
+    pthread_join(c->reader, 0);
+    close(c->fd_feedback);
+    int status;
+    ok = waitpid(c->pid, &status, 0) == c->pid && WIFEXITED(status) && WEXITSTATUS(status) == 0 && ok;
+    pthread_mutex_destroy(&c->mutex);
+    pthread_cond_destroy(&c->cond_writer);
+    pthread_cond_destroy(&c->cond_caller);
+    free(c->queue);
+    free(c->pending);
+    free(c);
+    return ok;
+}
@@ -0,0 +1,93 @@
+
+#pragma once
+
+#include <stdbool.h>                // for bool
+#include "trusted/trusted_utils.h"  // for u64, u8, signature
+
+// Client for a checker process (impcheck_check), to be used by solvers.
+// The client spawns the checker and talks to it via two pipes, using the
+// format in trusted/checker_interface.h. Directives are encoded into a
+// lock-free single-producer single-consumer queue, which a writer thread
+// drains into the checker in batches of whatever has accumulated. A reader
+// thread receives the checker's answers and completes the corresponding
+// futures and/or invokes a callback, so that submitting a directive never
+// waits for its answer and reads and writes can never block each other.
+//
+// All directives and waits must be issued by one thread at a time (the
+// "caller"); callbacks are invoked on the reader thread.
+//
+// With -overlap-load among the checker's arguments, the checker withholds
+// its answers to the directives between INIT and END_LOAD until END_LOAD.
+// In between, waiting for any of these answers fails instead of blocking
+// forever, and so does any directive beyond the in-flight limit.
+
+// An answer of the checker to a directive.
+struct checker_answer {
+    char directive; // TRUSTED_CHK_* of the directive
+    u64 id; // clause ID of a derivation or import, first ID of an increment
+    bool ok;
+    const u8* sig_or_null; // for shared derivations and validations
+};
+
+// Caller-owned handle for a single answer. It must remain valid until the
+// answer has arrived (see checker_future_wait).
+struct checker_future {
+    u64 seq; // position among all directives with answers
+    bool done;
+    bool ok;
+    signature sig; // only if the answer carries a signature
+};
+
+struct checker_client_options {
+    const char* checker_path; // path of the impcheck_check executable (required)
+    const char* const* checker_args; // further arguments (null-terminated) or 0
+    u64 max_in_flight; // max. number of directives awaiting their answer
+    u64 queue_bytes; // capacity of the queue of outgoing directives
+    // Invoked on the reader thread for each answer, if set.
+    void (*on_answer)(void* user, const struct checker_answer* answer);
+    void* user;
+};
+
+struct checker_client;
+
+void checker_client_default_options(struct checker_client_options* opts);
+// Spawn a checker process. Returns 0 (and sets trusted_utils_msgstr) upon an error.
+struct checker_client* checker_client_start(const struct checker_client_options* opts);
+
+// Each of these functions enqueues a directive and returns without waiting
+// for its answer, unless max_in_flight answers or queue_bytes of directives
+// are outstanding. If future_or_null is set, it receives the answer.
+// They return false if the checker has failed or has exited.
+bool checker_client_init(struct checker_client* c, int nb_vars, const u8* formula_sig,
+    struct checker_future* future_or_null);
+bool checker_client_load(struct checker_client* c, const int* lits, int nb_lits);
+bool checker_client_end_load(struct checker_client* c, struct checker_future* future_or_null);
+bool checker_client_add_increment(struct checker_client* c, u64 first_id, const int* lits, int nb_lits,
+    const u8* inc_sig, struct checker_future* future_or_null);
+// With share, the answer carries the clause's signature.
+bool checker_client_produce(struct checker_client* c, u64 id, const int* lits, int nb_lits,
+    const u64* hints, int nb_hints, bool share, struct checker_future* future_or_null);
+bool checker_client_import(struct checker_client* c, u64 id, const int* lits, int nb_lits,
+    const u8* sig, struct checker_future* future_or_null);
+bool checker_client_delete(struct checker_client* c, const u64* ids, int nb_ids,
+    struct checker_future* future_or_null);
+bool checker_client_delete_ranges(struct checker_client* c, const u64* ranges, int nb_ranges,
+    struct checker_future* future_or_null);
+bool checker_client_delete_bitmap(struct checker_client* c, u64 base_id, const u64* words, int nb_words,
+    struct checker_future* future_or_null);
+// The answers of validations carry the result's signature.
+bool checker_client_validate_unsat(struct checker_client* c, struct checker_future* future_or_null);
+bool checker_client_validate_unsat_assuming(struct checker_client* c, const int* assumptions,
+    int nb_assumptions, u64 id, struct checker_future* future_or_null);
+bool checker_client_validate_sat(struct checker_client* c, const int* model, int model_size,
+    struct checker_future* future_or_null);
+
+// Wait for the answer of a future; returns whether the directive was accepted.
+// If needed, the checker is queried for its statistics to make it flush.
+bool checker_future_wait(struct checker_client* c, struct checker_future* future);
+// Wait until all directives enqueued so far have been answered; returns
+// whether all answers so far have been positive.
+bool checker_client_sync(struct checker_client* c);
+// Terminate the checker, wait for it to exit, and release the client.
+// Returns whether all answers have been positive.
+bool checker_client_stop(struct checker_client* c);
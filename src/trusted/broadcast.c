@@ -0,0 +1,188 @@
+
+#include "broadcast.h"
+#include <errno.h>          // for errno, ENXIO, EINTR
+#include <fcntl.h>          // for open, fcntl, O_WRONLY, O_NONBLOCK, ...
+#include <pthread.h>        // for pthread_mutex_lock, pthread_cond_wait, ...
+#include <signal.h>         // for signal, SIGPIPE, SIG_IGN
+#include <stdio.h>          // for fdopen, fwrite, fclose, FILE
+#include <stdlib.h>         // for free, abort
+#include <string.h>         // for memcpy
+#include <time.h>           // for clock_gettime, nanosleep, timespec
+#include <unistd.h>         // for close
+#include "trusted_utils.h"  // for trusted_utils_malloc, u64, u8
+
+#define BROADCAST_BLOCK_SIZE (1 << 20)
+
+struct broadcast_block {
+    u64 size;
+    int nb_pending; // number of outputs which still need to write this block
+    u8 data[BROADCAST_BLOCK_SIZE];
+};
+
+struct broadcast_ref {
+    struct broadcast_block* block;
+    struct broadcast_ref* next;
+};
+
+struct broadcast_output {
+    struct broadcast* bc;
+    const char* path;
+    pthread_t thread;
+    struct broadcast_ref* head; // next block to write
+    struct broadcast_ref* tail;
+    bool ok;
+};
+
+struct broadcast {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    pthread_cond_t cond_released;
+    struct broadcast_block* current; // being filled, not yet visible to outputs
+    int nb_blocks; // published and not yet released
+    bool finished;
+    struct broadcast_output* outputs;
+    int nb_outputs;
+};
+
+struct broadcast_block* new_block(void) {
+    struct broadcast_block* block = trusted_utils_malloc(sizeof(struct broadcast_block));
+    block->size = 0;
+    return block;
+}
+
+// Append the current block to the queue of each output. Waits while the
+// slowest output lags BROADCAST_MAX_BLOCKS blocks behind.
+void publish_current_block(struct broadcast* bc) {
+    struct broadcast_block* block = bc->current;
+    block->nb_pending = bc->nb_outputs;
+    pthread_mutex_lock(&bc->mutex);
+    while (bc->nb_blocks >= BROADCAST_MAX_BLOCKS) pthread_cond_wait(&bc->cond_released, &bc->mutex);
+    bc->nb_blocks++;
+    for (int i = 0; i < bc->nb_outputs; i++) {
+        struct broadcast_output* out = &bc->outputs[i];
+        struct broadcast_ref* ref = trusted_utils_malloc(sizeof(struct broadcast_ref));
+        ref->block = block;
+        ref->next = 0;
+        if (out->tail) out->tail->next = ref;
+        else out->head = ref;
+        out->tail = ref;
+    }
+    pthread_cond_broadcast(&bc->cond);
+    pthread_mutex_unlock(&bc->mutex);
+    bc->current = new_block();
+}
+
+// Open a file for writing like fopen(path, "w"), but give up on a named
+// pipe if no reader has opened it within BROADCAST_OPEN_TIMEOUT_SECS.
+FILE* open_output(const char* path) {
+    struct timespec start, now;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (true) {
+        // Without a reader, a non-blocking open of a named pipe fails with ENXIO.
+        const int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_NONBLOCK, 0644);
+        if (fd >= 0) {
+            // all further writes are blocking
+            const int flags = fcntl(fd, F_GETFL);
+            FILE* file = flags >= 0 && fcntl(fd, F_SETFL, flags & ~O_NONBLOCK) == 0 ? fdopen(fd, "w") : 0;
+            if (!file) close(fd);
+            return file;
+        }
+        if (errno != ENXIO && errno != EINTR) return 0;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (now.tv_sec - start.tv_sec >= BROADCAST_OPEN_TIMEOUT_SECS) return 0;
+        const struct timespec delay = {0, 10 * 1000 * 1000};
+        nanosleep(&delay, 0);
+    }
+}
+
+void* run_output(void* arg) {
+    struct broadcast_output* out = (struct broadcast_output*) arg;
+    struct broadcast* bc = out->bc;
+    FILE* file = open_output(out->path);
+    out->ok = file != 0;
+    while (true) {
+        pthread_mutex_lock(&bc->mutex);
+        while (!out->head && !bc->finished) pthread_cond_wait(&bc->cond, &bc->mutex);
+        struct broadcast_ref* ref = out->head;
+        if (!ref) {
+            // finished and nothing left to write
+            pthread_mutex_unlock(&bc->mutex);
+            break;
+        }
+        out->head = ref->next;
+        if (!out->head) out->tail = 0;
+        pthread_mutex_unlock(&bc->mutex);
+
+        // A failed output keeps consuming its queue (without writing)
+        // so that all blocks are eventually released.
+        struct broadcast_block* block = ref->block;
+        if (out->ok) out->ok = UNLOCKED_IO(fwrite)(block->data, 1, block->size, file) == block->size;
+        free(ref);
+
+        pthread_mutex_lock(&bc->mutex);
+        const bool release = --block->nb_pending == 0;
+        if (release) {
+            bc->nb_blocks--;
+            pthread_cond_signal(&bc->cond_released);
+        }
+        pthread_mutex_unlock(&bc->mutex);
+        if (release) free(block);
+    }
+    if (file && fclose(file) != 0) out->ok = false;
+    return 0;
+}
+
+struct broadcast* broadcast_init(const char** paths, int nb_outputs) {
+    // A reader which goes away must not terminate the entire process.
+    signal(SIGPIPE, SIG_IGN);
+    struct broadcast* bc = trusted_utils_malloc(sizeof(struct broadcast));
+    pthread_mutex_init(&bc->mutex, 0);
+    pthread_cond_init(&bc->cond, 0);
+    pthread_cond_init(&bc->cond_released, 0);
+    bc->current = new_block();
+    bc->nb_blocks = 0;
+    bc->finished = false;
+    bc->nb_outputs = nb_outputs;
+    bc->outputs = trusted_utils_calloc(nb_outputs, sizeof(struct broadcast_output));
+    for (int i = 0; i < nb_outputs; i++) {
+        struct broadcast_output* out = &bc->outputs[i];
+        out->bc = bc;
+        out->path = paths[i];
+        if (pthread_create(&out->thread, 0, run_output, out) != 0) abort();
+    }
+    return bc;
+}
+
+void broadcast_write(struct broadcast* bc, const void* data, u64 nb_bytes) {
+    const u8* bytes = (const u8*) data;
+    while (nb_bytes > 0) {
+        struct broadcast_block* block = bc->current;
+        u64 nb_copied = BROADCAST_BLOCK_SIZE - block->size;
+        if (nb_copied > nb_bytes) nb_copied = nb_bytes;
+        memcpy(block->data + block->size, bytes, nb_copied);
+        block->size += nb_copied;
+        bytes += nb_copied;
+        nb_bytes -= nb_copied;
+        if (block->size == BROADCAST_BLOCK_SIZE) publish_current_block(bc);
+    }
+}
+
+bool broadcast_end(struct broadcast* bc) {
+    if (bc->current->size > 0) publish_current_block(bc);
+    free(bc->current);
+    pthread_mutex_lock(&bc->mutex);
+    bc->finished = true;
+    pthread_cond_broadcast(&bc->cond);
+    pthread_mutex_unlock(&bc->mutex);
+    bool ok = true;
+    for (int i = 0; i < bc->nb_outputs; i++) {
+        pthread_join(bc->outputs[i].thread, 0);
+        ok = ok && bc->outputs[i].ok;
+    }
+    pthread_cond_destroy(&bc->cond);
+    pthread_cond_destroy(&bc->cond_released);
+    pthread_mutex_destroy(&bc->mutex);
+    free(bc->outputs);
+    free(bc);
+    return ok;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdbool.h>        // for bool
+#include "trusted_utils.h"  // for u64
+
+// Writes one byte stream to several files (e.g., named pipes) concurrently.
+// The data is collected in blocks which are shared among all outputs. Each
+// output has a writer thread of its own and a queue of the blocks it has yet
+// to write, so a slow (or not yet connected) reader delays neither the
+// producer nor the other readers - as long as it lags less than
+// BROADCAST_MAX_BLOCKS blocks behind, at which point the producer waits.
+// A block is freed as soon as all outputs have written it.
+
+#define BROADCAST_MAX_BLOCKS 64
+#define BROADCAST_OPEN_TIMEOUT_SECS 60
+
+struct broadcast;
+
+// Open the files within the writer threads, so that opening a named pipe
+// only delays the respective output until its reader has arrived. An output
+// whose reader does not arrive within BROADCAST_OPEN_TIMEOUT_SECS fails.
+struct broadcast* broadcast_init(const char** paths, int nb_outputs);
+void broadcast_write(struct broadcast* bc, const void* data, u64 nb_bytes);
+// Write all remaining data, close all outputs, and free all resources.
+// Returns false iff writing to some output failed.
+bool broadcast_end(struct broadcast* bc);
@@ -9,6 +9,9 @@
 // Initialize and begin the loading stage.
 // IN: #vars (int); 128-bit signature of the formula (from trusted parser)
 // OUT: OK
+// If a checker serves several streams of directives, only the first stream
+// loads the formula. Each further stream begins with INIT, whose #vars and
+// signature must match the loaded formula, directly followed by END_LOAD.
 #define TRUSTED_CHK_INIT 'B'
 
 // Load a chunk of the original problem formula.
@@ -21,6 +24,19 @@
 // OUT: OK
 #define TRUSTED_CHK_END_LOAD 'E'
 
+// Add original clauses to the formula after the loading stage, e.g., for
+// the next call of an incremental solver. The clauses receive consecutive
+// IDs beginning with the given first ID. The increment is signed by the
+// trusted parser just like a formula of its own; the checker verifies this
+// signature and then extends the formula signature, so that all clause
+// and result signatures from now on refer to the extended formula. The
+// variables of the increment must not exceed the #vars given upon INIT.
+// Each stream of a checker adds its increments itself.
+// IN: 64-bit ID of the first clause; int k; sequence of k literals, each
+//     clause terminated by a zero; 128-bit signature of the increment.
+// OUT: OK
+#define TRUSTED_CHK_ADD_INCREMENT 'N'
+
 // Add the derivation of a new, local clause.
 // IN: 64-bit ID; int k; sequence of k literals;
 //     int l; sequence of l 64-bit hints;
@@ -38,17 +54,53 @@
 // OUT: OK
 #define TRUSTED_CHK_CLS_DELETE 'd'
 
+// Delete a sequence of ranges of clauses. Each range consists of a first
+// ID f, a number n of IDs, and a stride s >= 1, and it denotes the IDs
+// f, f+s, ..., f+(n-1)s (e.g., all IDs of one solver among s solvers).
+// IN: int k; sequence of k ranges, each as three 64-bit numbers f, n, s.
+// OUT: OK
+#define TRUSTED_CHK_CLS_DELETE_RANGES 'r'
+
+// Delete the clauses whose IDs are marked in a bitmap.
+// IN: 64-bit base ID b; int k; sequence of k 64-bit words, where bit j
+//     (counting from the least significant bit) of word i marks ID b+64i+j.
+// OUT: OK
+#define TRUSTED_CHK_CLS_DELETE_BITMAP 'b'
+
 // Confirm that the formula is proven unsatisfiable.
 // IN: (none)
 // OUT: OK
 #define TRUSTED_CHK_VALIDATE_UNSAT 'V'
 
+// Confirm that the formula is unsatisfiable under a set of assumptions,
+// which is shown by a live clause consisting only of negated assumptions
+// (or by the empty clause). Checking can continue afterwards.
+// IN: int k; sequence of k assumption literals; 64-bit ID of the clause.
+// OUT: OK; 128-bit signature of the result under the assumptions
+#define TRUSTED_CHK_VALIDATE_UNSAT_ASSUMING 'U'
+
 // Check the provided model to confirm that the formula is satisfiable.
 // IN: int k, sequence M of k literals where M[x] ∈ ±(x+1) indicates
 //     the assignment to variable x+1.
 // OUT: OK
 #define TRUSTED_CHK_VALIDATE_SAT 'M'
 
+// Report the checker's performance metrics (see stats.h) as text.
+// IN: (none)
+// OUT: OK; int k; sequence of k characters
+#define TRUSTED_CHK_QUERY_STATS 'Q'
+
+// Write a snapshot of the checker's state (see snapshot.h) to the given
+// path in the background. The snapshot appears at the path (atomically)
+// once it is complete; a checker can be restored from it via -restore=.
+// At most one snapshot is written at a time. An empty path (k = 0) writes
+// nothing but awaits the snapshot being written, if any.
+// IN: int k; sequence of k characters (the path).
+// OUT: for a path, OK iff the previous snapshot (if any) was written and
+// writing this snapshot has begun; for an empty path, OK iff the snapshot
+// being written (if any) was written successfully
+#define TRUSTED_CHK_CHECKPOINT 'C'
+
 // Terminate.
 // IN: (none)
 // OUT: OK
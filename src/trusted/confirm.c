@@ -2,10 +2,39 @@
 #include "trusted_utils.h"
 #include "siphash.h"
 
+// Domain tags of increment and assumption signatures (see secret.h).
+const char* INCREMENT_TAG = "IMPINCRM";
+const char* ASSUMING_TAG = "IMPASSUM";
+
+void confirm_result_ctx(struct siphash* sh, const u8* f_sig, u8 constant, u8* out) {
+    siphash_ctx_reset(sh);
+    siphash_ctx_update(sh, f_sig, SIG_SIZE_BYTES);
+    siphash_ctx_update(sh, &constant, 1);
+    u8* sig = siphash_ctx_digest(sh);
+    trusted_utils_copy_bytes(out, sig, SIG_SIZE_BYTES);
+}
+
 void confirm_result(u8* f_sig, u8 constant, u8* out) {
-    siphash_reset();
-    siphash_update(f_sig, SIG_SIZE_BYTES);
-    siphash_update(&constant, 1);
-    u8* sig = siphash_digest();
+    confirm_result_ctx(siphash_default(), f_sig, constant, out);
+}
+
+void confirm_increment_ctx(struct siphash* sh, const u8* f_sig, const u8* inc_sig, u8* out) {
+    siphash_ctx_reset(sh);
+    siphash_ctx_update(sh, f_sig, SIG_SIZE_BYTES);
+    siphash_ctx_update(sh, inc_sig, SIG_SIZE_BYTES);
+    siphash_ctx_update(sh, (const u8*) INCREMENT_TAG, 8);
+    u8* sig = siphash_ctx_digest(sh);
+    trusted_utils_copy_bytes(out, sig, SIG_SIZE_BYTES);
+}
+
+void confirm_result_assuming_ctx(struct siphash* sh, const u8* f_sig,
+    const int* assumptions, int nb_assumptions, u8* out) {
+    const u8 constant = 20;
+    siphash_ctx_reset(sh);
+    siphash_ctx_update(sh, f_sig, SIG_SIZE_BYTES);
+    siphash_ctx_update(sh, (const u8*) assumptions, nb_assumptions * sizeof(int));
+    siphash_ctx_update(sh, &constant, 1);
+    siphash_ctx_update(sh, (const u8*) ASSUMING_TAG, 8);
+    u8* sig = siphash_ctx_digest(sh);
     trusted_utils_copy_bytes(out, sig, SIG_SIZE_BYTES);
 }
@@ -1,6 +1,19 @@
 
 #pragma once
 
+#include "siphash.h"
 #include "trusted_utils.h"
 
 void confirm_result(u8* f_sig, u8 constant, u8* out);
+// Same as confirm_result, using the given SipHash context.
+void confirm_result_ctx(struct siphash* sh, const u8* f_sig, u8 constant, u8* out);
+
+// Signature of a formula extended by an increment of original clauses,
+// given the signature of the formula so far and the increment's signature
+// (computed by the trusted parser as for a formula of its own).
+void confirm_increment_ctx(struct siphash* sh, const u8* f_sig, const u8* inc_sig, u8* out);
+
+// Signature of the result that a formula is unsatisfiable under the given
+// sequence of assumption literals.
+void confirm_result_assuming_ctx(struct siphash* sh, const u8* f_sig,
+    const int* assumptions, int nb_assumptions, u8* out);
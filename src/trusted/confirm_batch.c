@@ -0,0 +1,183 @@
+
+#include "confirm_batch.h"
+#include <pthread.h>         // for pthread_mutex_lock, pthread_create, ...
+#include <stdio.h>           // for printf, fopen, getline, FILE
+#include <stdlib.h>          // for free, atoi, abort
+#include <string.h>          // for strlen, strrchr, strnlen
+#include "confirm.h"         // for confirm_result_ctx, confirm_increment_ctx, ...
+#include "secret.h"          // for SECRET_KEY
+#include "siphash.h"         // for siphash, siphash_ctx_init
+#include "trusted_parser.h"  // for tp_ctx_init, tp_ctx_parse, tp_ctx_end
+#include "trusted_utils.h"   // for trusted_utils_str_to_sig, signature
+
+// Parse a formula (or increment) with a parser of its own to get its
+// signature, without writing the formula anywhere.
+bool parse_signature(const char* path, const struct confirm_options* opts, u8* out) {
+    struct trusted_parser* tp = tp_ctx_init(path, 0);
+    if (opts->formula_cache) tp_ctx_use_cache(tp, opts->formula_cache);
+    tp_ctx_set_threads(tp, opts->parse_threads);
+    u8* sig;
+    const bool ok = tp_ctx_parse(tp, &sig);
+    if (ok) trusted_utils_copy_bytes(out, sig, SIG_SIZE_BYTES);
+    tp_ctx_end(tp);
+    return ok;
+}
+
+const char* confirm_entry(const char* formula_input, int result, const char* result_sig,
+    const struct confirm_options* opts) {
+    return confirm_incremental_entry(formula_input, 0, 0, 0, 0, result, result_sig, opts);
+}
+
+const char* confirm_incremental_entry(const char* formula_input,
+    const char** increments, int nb_increments, const int* assumptions_or_null, int nb_assumptions,
+    int result, const char* result_sig, const struct confirm_options* opts) {
+
+    // valid input?
+    if (result != 10 && result != 20) return "Result code missing or invalid";
+    if (assumptions_or_null && result != 20) return "Assumptions only apply to UNSAT results";
+    if (strnlen(result_sig, 2*SIG_SIZE_BYTES+1) != 2*SIG_SIZE_BYTES)
+        return "Result signature missing or malformed";
+    // convert the reported signature from hex string to raw data
+    signature sig_res_reported;
+    if (!trusted_utils_str_to_sig(result_sig, sig_res_reported)) return "Invalid signature string";
+
+    // Parse formula and increments to get the signature of the final formula
+    signature sig_formula, sig_increment;
+    if (!parse_signature(formula_input, opts, sig_formula)) return "Problem during parsing";
+    struct siphash sh;
+    siphash_ctx_init(&sh, SECRET_KEY);
+    for (int i = 0; i < nb_increments; i++) {
+        if (!parse_signature(increments[i], opts, sig_increment)) return "Problem during parsing of increment";
+        confirm_increment_ctx(&sh, sig_formula, sig_increment, sig_formula);
+    }
+
+    // re-compute result signature
+    signature sig_res_computed;
+    if (assumptions_or_null)
+        confirm_result_assuming_ctx(&sh, sig_formula, assumptions_or_null, nb_assumptions, sig_res_computed);
+    else confirm_result_ctx(&sh, sig_formula, (u8) result, sig_res_computed);
+
+    // check reported signature against computed signature
+    if (!trusted_utils_equal_signatures(sig_res_computed, sig_res_reported))
+        return "Signature does not match!";
+    return 0;
+}
+
+struct batch_entry {
+    char* line; // holds the path
+    int result;
+    const char* sig;
+    const char* error;
+    bool done;
+};
+
+struct batch {
+    struct batch_entry* entries;
+    int nb_entries;
+    int next_entry; // to be confirmed next
+    int next_verdict; // to be printed next
+    int nb_confirmed;
+    const struct confirm_options* opts;
+    pthread_mutex_t mutex;
+};
+
+// Split a manifest line into path, result code, and signature, which are
+// the last two fields. (The path may thus contain spaces.)
+bool parse_manifest_line(char* line, struct batch_entry* entry) {
+    u64 len = strlen(line);
+    while (len > 0 && (line[len-1] == '\n' || line[len-1] == '\r' || line[len-1] == ' '))
+        line[--len] = '\0';
+    char* sig_begin = strrchr(line, ' ');
+    if (!sig_begin) return false;
+    *sig_begin = '\0';
+    char* result_begin = strrchr(line, ' ');
+    if (!result_begin) return false;
+    *result_begin = '\0';
+    entry->line = line;
+    entry->result = atoi(result_begin+1);
+    entry->sig = sig_begin+1;
+    entry->error = 0;
+    entry->done = false;
+    return true;
+}
+
+void print_verdict(const struct batch_entry* entry) {
+    if (entry->error) printf("s NOT VERIFIED %s (%s)\n", entry->line, entry->error);
+    else if (entry->result == 10) printf("s VERIFIED SATISFIABLE %s\n", entry->line);
+    else printf("s VERIFIED UNSATISFIABLE %s\n", entry->line);
+}
+
+void* run_worker(void* arg) {
+    struct batch* b = (struct batch*) arg;
+    while (true) {
+        pthread_mutex_lock(&b->mutex);
+        const int idx = b->next_entry++;
+        pthread_mutex_unlock(&b->mutex);
+        if (idx >= b->nb_entries) break;
+
+        struct batch_entry* entry = &b->entries[idx];
+        entry->error = confirm_entry(entry->line, entry->result, entry->sig, b->opts);
+
+        // Print all verdicts which are now complete in manifest order
+        pthread_mutex_lock(&b->mutex);
+        entry->done = true;
+        if (!entry->error) b->nb_confirmed++;
+        while (b->next_verdict < b->nb_entries && b->entries[b->next_verdict].done)
+            print_verdict(&b->entries[b->next_verdict++]);
+        fflush(stdout);
+        pthread_mutex_unlock(&b->mutex);
+    }
+    return 0;
+}
+
+bool confirm_batch(const char* manifest, int nb_threads, const struct confirm_options* opts) {
+    FILE* f = fopen(manifest, "r");
+    if (!f) {
+        trusted_utils_log_err("Cannot open manifest");
+        return false;
+    }
+    struct batch b;
+    b.nb_entries = 0;
+    int capacity = 64;
+    b.entries = trusted_utils_malloc(capacity * sizeof(struct batch_entry));
+    char* buf = 0;
+    size_t buf_size = 0;
+    ssize_t len;
+    bool ok = true;
+    while ((len = getline(&buf, &buf_size, f)) > 0) {
+        if (buf[0] == '#' || buf[0] == '\n') continue; // comment or empty line
+        if (b.nb_entries == capacity) {
+            capacity *= 2;
+            b.entries = trusted_utils_realloc(b.entries, capacity * sizeof(struct batch_entry));
+        }
+        char* line = trusted_utils_malloc(len+1);
+        memcpy(line, buf, len+1);
+        if (!parse_manifest_line(line, &b.entries[b.nb_entries])) {
+            snprintf(trusted_utils_msgstr, 512, "Malformed manifest line \"%.400s\"", line);
+            trusted_utils_log_err(trusted_utils_msgstr);
+            free(line);
+            ok = false;
+            break;
+        }
+        b.nb_entries++;
+    }
+    free(buf);
+    fclose(f);
+
+    if (ok) {
+        b.next_entry = b.next_verdict = b.nb_confirmed = 0;
+        b.opts = opts;
+        pthread_mutex_init(&b.mutex, 0);
+        if (nb_threads < 1) nb_threads = 1;
+        pthread_t threads[nb_threads];
+        for (int i = 0; i < nb_threads; i++) {
+            if (pthread_create(&threads[i], 0, run_worker, &b) != 0) abort();
+        }
+        for (int i = 0; i < nb_threads; i++) pthread_join(threads[i], 0);
+        pthread_mutex_destroy(&b.mutex);
+        ok = b.nb_confirmed == b.nb_entries;
+    }
+    for (int i = 0; i < b.nb_entries; i++) free(b.entries[i].line);
+    free(b.entries);
+    return ok;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdbool.h>  // for bool
+
+struct confirm_options {
+    const char* formula_cache; // may be null
+    int parse_threads;
+};
+
+// Confirm a single result: parse the formula, re-compute the result
+// signature and compare it with the reported one (given as a hex string).
+// Returns null if the result is confirmed and an error message otherwise.
+const char* confirm_entry(const char* formula_input, int result, const char* result_sig,
+    const struct confirm_options* opts);
+
+// Confirm a result of an incremental run: the formula is extended by the
+// given increments in order (each a CNF file of its own), and if
+// assumptions_or_null is set, the result is UNSAT under these assumptions.
+const char* confirm_incremental_entry(const char* formula_input,
+    const char** increments, int nb_increments, const int* assumptions_or_null, int nb_assumptions,
+    int result, const char* result_sig, const struct confirm_options* opts);
+
+// Confirm each entry of a manifest with one line "<path/to/cnf> <result> <signature>"
+// per entry on a pool of worker threads, each with its own parser and SipHash
+// context. One verdict line is printed per entry, in the order of the manifest.
+// Returns true iff all entries have been confirmed.
+bool confirm_batch(const char* manifest, int nb_threads, const struct confirm_options* opts);
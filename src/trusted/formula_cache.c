@@ -0,0 +1,125 @@
+
+#include "formula_cache.h"
+#include <stdio.h>          // for fopen, fread, fwrite, rename, snprintf
+#include <stdlib.h>         // for free
+#include <sys/mman.h>       // for mmap, munmap
+#include <sys/stat.h>       // for stat
+#include "formula_image.h"  // for formula_image_map, formula_image_unmap
+#include "secret.h"         // for secret_derive_key
+#include "siphash.h"        // for siphash_ctx_init, siphash_ctx_update, siphash_...
+#include "trusted_utils.h"  // for trusted_utils_copy_bytes, u64
+
+// Purposes of the keys derived from the secret key (see secret.h): content
+// digests and entry names are stored in the clear, and the contents of
+// entries are determined by the (untrusted) input files.
+const char* DIGEST_KEY_PURPOSE = "IMPCDIGS";
+const char* MAC_KEY_PURPOSE = "IMPCMACS";
+
+void init_cache_hash(struct siphash* sh, u8* key, const char* purpose) {
+    secret_derive_key(purpose, key);
+    siphash_ctx_init(sh, key);
+}
+
+void compute_cache_hash(const char* purpose, const u8* data, u64 nb_bytes, u8* out) {
+    signature key;
+    struct siphash sh;
+    init_cache_hash(&sh, key, purpose);
+    siphash_ctx_update(&sh, data, nb_bytes);
+    trusted_utils_copy_bytes(out, siphash_ctx_digest(&sh), SIG_SIZE_BYTES);
+}
+
+bool equal_keys(const struct formula_cache_key* left, const struct formula_cache_key* right) {
+    return left->dev == right->dev && left->ino == right->ino && left->size == right->size
+        && left->mtime_sec == right->mtime_sec && left->mtime_nsec == right->mtime_nsec
+        && trusted_utils_equal_signatures(left->content_digest, right->content_digest);
+}
+
+bool formula_cache_compute_key(const char* cnf_path, struct formula_cache_key* key) {
+    struct stat st;
+    if (stat(cnf_path, &st) != 0 || !S_ISREG(st.st_mode)) return false;
+    key->dev = st.st_dev;
+    key->ino = st.st_ino;
+    key->size = st.st_size;
+    key->mtime_sec = st.st_mtim.tv_sec;
+    key->mtime_nsec = st.st_mtim.tv_nsec;
+
+    FILE* f = fopen(cnf_path, "r");
+    if (!f) return false;
+    const u64 buf_size = 1 << 20;
+    u8* buf = trusted_utils_malloc(buf_size);
+    signature digest_key;
+    struct siphash sh;
+    init_cache_hash(&sh, digest_key, DIGEST_KEY_PURPOSE);
+    u64 nb_read_total = 0;
+    while (true) {
+        const u64 nb_read = UNLOCKED_IO(fread)(buf, 1, buf_size, f);
+        if (nb_read == 0) break;
+        siphash_ctx_update(&sh, buf, nb_read);
+        nb_read_total += nb_read;
+    }
+    trusted_utils_copy_bytes(key->content_digest, siphash_ctx_digest(&sh), SIG_SIZE_BYTES);
+    free(buf);
+    fclose(f);
+    return nb_read_total == key->size; // file changed while reading?
+}
+
+void formula_cache_entry_path(const char* dir, const struct formula_cache_key* key,
+    char* out, int out_size) {
+    signature name;
+    compute_cache_hash(DIGEST_KEY_PURPOSE, (const u8*) key, sizeof(struct formula_cache_key), name);
+    char name_str[2*SIG_SIZE_BYTES+1];
+    trusted_utils_sig_to_str(name, name_str);
+    snprintf(out, out_size, "%s/%s.impcache", dir, name_str);
+}
+
+bool formula_cache_load(const char* dir, const struct formula_cache_key* key,
+    struct formula_image* img, struct formula_cache_trailer* trailer) {
+
+    char path[1024];
+    formula_cache_entry_path(dir, key, path, 1024);
+    if (!formula_image_map(path, img)) return false;
+
+    const u64 trailer_pos = img->header->sig_pos + SIG_SIZE_BYTES;
+    bool ok = img->mapping_size == trailer_pos + sizeof(struct formula_cache_trailer);
+    if (ok) {
+        const u8* data = (const u8*) img->mapping;
+        const struct formula_cache_trailer* t = (const struct formula_cache_trailer*) (data + trailer_pos);
+        signature mac;
+        compute_cache_hash(MAC_KEY_PURPOSE, data, img->mapping_size - SIG_SIZE_BYTES, mac);
+        ok = trusted_utils_equal_signatures(mac, t->mac) && equal_keys(key, &t->key);
+        if (ok) *trailer = *t;
+    }
+    if (!ok) formula_image_unmap(img);
+    return ok;
+}
+
+bool formula_cache_commit(const char* dir, const char* tmp_path,
+    const struct formula_cache_key* key, long nb_vars_declared, long nb_clauses_declared) {
+
+    struct formula_cache_trailer trailer;
+    trailer.key = *key;
+    trailer.nb_vars_declared = nb_vars_declared;
+    trailer.nb_clauses_declared = nb_clauses_declared;
+    FILE* f = fopen(tmp_path, "a+");
+    if (!f) return false;
+    bool ok = fwrite(&trailer, sizeof(trailer) - SIG_SIZE_BYTES, 1, f) == 1
+        && fflush(f) == 0;
+    // Compute the MAC over everything written so far
+    const long size = ok ? ftell(f) : -1;
+    void* data = size > 0 ? mmap(0, size, PROT_READ, MAP_SHARED, fileno(f), 0) : MAP_FAILED;
+    ok = ok && data != MAP_FAILED;
+    if (ok) {
+        compute_cache_hash(MAC_KEY_PURPOSE, (const u8*) data, size, trailer.mac);
+        munmap(data, size);
+        ok = fwrite(trailer.mac, SIG_SIZE_BYTES, 1, f) == 1;
+    }
+    ok = (fclose(f) == 0) && ok;
+    if (!ok) {
+        remove(tmp_path);
+        return false;
+    }
+    // Atomically move the complete entry to its final location
+    char path[1024];
+    formula_cache_entry_path(dir, key, path, 1024);
+    return rename(tmp_path, path) == 0;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdbool.h>        // for bool
+#include "formula_image.h"  // for formula_image
+#include "trusted_utils.h"  // for u64, signature
+
+// An opt-in cache of parsed formulas. A cache entry is a formula image
+// (see formula_image.h) followed by a trailer which identifies the
+// original DIMACS file - by its file system identity and by a digest of
+// its raw content - and which carries a MAC over the entire entry.
+// The MAC is computed with a key derived from the secret key, so a valid
+// entry can only have been written by a trusted parser. The content digest
+// uses another derived key, so it reveals nothing that is valid elsewhere.
+
+struct formula_cache_key {
+    u64 dev;
+    u64 ino;
+    u64 size;
+    u64 mtime_sec;
+    u64 mtime_nsec;
+    signature content_digest;
+};
+
+struct formula_cache_trailer {
+    struct formula_cache_key key;
+    long nb_vars_declared;     // -1 if not present
+    long nb_clauses_declared;  // -1 if not present
+    signature mac;
+};
+
+// Compute the key of a DIMACS file. This reads the entire file.
+bool formula_cache_compute_key(const char* cnf_path, struct formula_cache_key* key);
+// Path of the cache entry for the given key within the cache directory.
+void formula_cache_entry_path(const char* dir, const struct formula_cache_key* key,
+    char* out, int out_size);
+// Map and authenticate the cache entry for the given key.
+bool formula_cache_load(const char* dir, const struct formula_cache_key* key,
+    struct formula_image* img, struct formula_cache_trailer* trailer);
+// Complete a freshly written formula image at tmp_path to a cache entry
+// and move it to its final location in the cache directory.
+bool formula_cache_commit(const char* dir, const char* tmp_path,
+    const struct formula_cache_key* key, long nb_vars_declared, long nb_clauses_declared);
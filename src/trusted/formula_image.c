@@ -0,0 +1,104 @@
+
+#include "formula_image.h"
+#include <fcntl.h>          // for open, O_RDONLY
+#include <stdio.h>          // for fopen, fclose, fseek, fwrite
+#include <stdlib.h>         // for free
+#include <sys/mman.h>       // for mmap, munmap
+#include <sys/stat.h>       // for fstat
+#include <unistd.h>         // for close
+#include "trusted_utils.h"  // for trusted_utils_malloc, u64
+
+struct formula_image_writer* formula_image_writer_init(const char* path) {
+    FILE* file = fopen(path, "w");
+    if (!file) return 0;
+    struct formula_image_writer* w = trusted_utils_malloc(sizeof(struct formula_image_writer));
+    w->file = file;
+    w->nb_lits = 0;
+    w->clause_begin = 0;
+    w->nb_clauses = 0;
+    w->offsets_capacity = 1 << 12;
+    w->offsets = trusted_utils_malloc(w->offsets_capacity * sizeof(u64));
+    // placeholder for the header, which is written in the end
+    struct formula_image_header header = {0};
+    fwrite(&header, sizeof(header), 1, w->file);
+    return w;
+}
+
+void formula_image_writer_add(struct formula_image_writer* w, const int* lits, u64 nb_lits) {
+    fwrite(lits, sizeof(int), nb_lits, w->file);
+    for (u64 i = 0; i < nb_lits; i++) {
+        if (lits[i] != 0) continue;
+        if (w->nb_clauses == w->offsets_capacity) {
+            w->offsets_capacity *= 2;
+            w->offsets = trusted_utils_realloc(w->offsets, w->offsets_capacity * sizeof(u64));
+        }
+        w->offsets[w->nb_clauses++] = w->clause_begin;
+        w->clause_begin = w->nb_lits + i + 1;
+    }
+    w->nb_lits += nb_lits;
+}
+
+bool formula_image_writer_end(struct formula_image_writer* w, int nb_vars, const u8* sig) {
+    struct formula_image_header header;
+    header.magic = FORMULA_IMAGE_MAGIC;
+    header.nb_vars = nb_vars;
+    header.nb_clauses = w->nb_clauses;
+    header.nb_lits = w->nb_lits;
+    header.offsets_pos = sizeof(header) + w->nb_lits * sizeof(int);
+    const int padding = 0;
+    if (header.offsets_pos % 8 != 0) {
+        fwrite(&padding, sizeof(int), 1, w->file);
+        header.offsets_pos += sizeof(int);
+    }
+    header.sig_pos = header.offsets_pos + w->nb_clauses * sizeof(u64);
+    fwrite(w->offsets, sizeof(u64), w->nb_clauses, w->file);
+    fwrite(sig, 1, SIG_SIZE_BYTES, w->file);
+    bool ok = fseek(w->file, 0, SEEK_SET) == 0
+        && fwrite(&header, sizeof(header), 1, w->file) == 1;
+    ok = (fclose(w->file) == 0) && ok;
+    free(w->offsets);
+    free(w);
+    return ok;
+}
+
+bool formula_image_map(const char* path, struct formula_image* img) {
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (u64) st.st_size < sizeof(struct formula_image_header)) {
+        close(fd);
+        return false;
+    }
+    const u64 size = st.st_size;
+    void* mapping = mmap(0, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); // the mapping remains valid
+    if (mapping == MAP_FAILED) return false;
+
+    const struct formula_image_header* header = mapping;
+    // Validate the layout; the sizes are bounded by the file size first
+    // to rule out any overflows in the subsequent computations.
+    const bool ok = header->magic == FORMULA_IMAGE_MAGIC
+        && header->nb_lits <= size / sizeof(int)
+        && header->nb_clauses <= size / sizeof(u64)
+        && header->offsets_pos >= sizeof(struct formula_image_header) + header->nb_lits * sizeof(int)
+        && header->offsets_pos % 8 == 0
+        && header->offsets_pos <= size
+        && header->sig_pos >= header->offsets_pos + header->nb_clauses * sizeof(u64)
+        && header->sig_pos <= size - SIG_SIZE_BYTES;
+    if (!ok) {
+        munmap(mapping, size);
+        return false;
+    }
+    img->mapping = mapping;
+    img->mapping_size = size;
+    img->header = header;
+    img->lits = (const int*) (header+1);
+    img->offsets = (const u64*) (((const u8*) mapping) + header->offsets_pos);
+    img->sig = ((const u8*) mapping) + header->sig_pos;
+    return true;
+}
+
+void formula_image_unmap(struct formula_image* img) {
+    munmap(img->mapping, img->mapping_size);
+    img->mapping = 0;
+}
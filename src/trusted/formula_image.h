@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdbool.h>        // for bool
+#include <stdio.h>          // for FILE
+#include "trusted_utils.h"  // for u64, u8
+
+// A binary image of a parsed formula which the trusted parser can write
+// and which checkers can map read-only into memory, so that all checkers
+// on a machine share a single copy of the formula in the page cache.
+// Layout (all integers in the system's endianness):
+//   - header (struct formula_image_header)
+//   - nb_lits literals (int), each clause terminated by a zero
+//   - zero padding to a multiple of 8 bytes
+//   - nb_clauses clause offsets (u64), indexing into the literals
+//   - 128-bit signature of the formula
+// Only the literals are covered by the signature. A checker which maps an
+// image must therefore verify the clause offsets against the literals.
+
+#define FORMULA_IMAGE_MAGIC 0x474d49464b435049UL // "IPCKFIMG"
+
+struct formula_image_header {
+    u64 magic;
+    u64 nb_vars;
+    u64 nb_clauses;
+    u64 nb_lits;
+    u64 offsets_pos; // in bytes, relative to the beginning of the file
+    u64 sig_pos;     // in bytes, relative to the beginning of the file
+};
+
+struct formula_image_writer {
+    FILE* file;
+    u64 nb_lits;
+    u64 clause_begin;
+    u64 nb_clauses;
+    u64 offsets_capacity;
+    u64* offsets;
+};
+
+struct formula_image {
+    void* mapping;
+    u64 mapping_size;
+    const struct formula_image_header* header;
+    const int* lits;
+    const u64* offsets;
+    const u8* sig;
+};
+
+struct formula_image_writer* formula_image_writer_init(const char* path);
+void formula_image_writer_add(struct formula_image_writer* w, const int* lits, u64 nb_lits);
+bool formula_image_writer_end(struct formula_image_writer* w, int nb_vars, const u8* sig);
+
+bool formula_image_map(const char* path, struct formula_image* img);
+void formula_image_unmap(struct formula_image* img);
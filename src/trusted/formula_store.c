@@ -0,0 +1,103 @@
+
+#include "formula_store.h"
+#include <stdlib.h>         // for free
+#include "trusted_utils.h"  // for trusted_utils_malloc, MALLOB_UNLIKELY
+
+void grow_deleted_bitmap(struct formula_store* fs) {
+    const u64 old_cap = fs->deleted_capacity;
+    fs->deleted_capacity = 2 * old_cap;
+    fs->deleted = trusted_utils_realloc(fs->deleted, fs->deleted_capacity * sizeof(u64));
+    for (u64 i = old_cap; i < fs->deleted_capacity; i++) fs->deleted[i] = 0;
+}
+
+struct formula_store* formula_store_init(void) {
+    struct formula_store* fs = trusted_utils_malloc(sizeof(struct formula_store));
+    fs->lits_capacity = 1 << 14;
+    fs->lits = trusted_utils_malloc(fs->lits_capacity * sizeof(int));
+    fs->nb_lits = 0;
+    fs->offsets_capacity = 1 << 12;
+    fs->offsets = trusted_utils_malloc(fs->offsets_capacity * sizeof(u64));
+    fs->nb_clauses = 0;
+    fs->clause_begin = 0;
+    fs->deleted_capacity = 1 << 6;
+    fs->deleted = trusted_utils_calloc(fs->deleted_capacity, sizeof(u64));
+    fs->external = false;
+    return fs;
+}
+
+struct formula_store* formula_store_init_external(int* lits, u64 nb_lits,
+    u64* offsets, u64 nb_clauses) {
+    struct formula_store* fs = trusted_utils_malloc(sizeof(struct formula_store));
+    fs->lits = lits;
+    fs->nb_lits = fs->lits_capacity = nb_lits;
+    fs->offsets = offsets;
+    fs->nb_clauses = fs->offsets_capacity = nb_clauses;
+    fs->clause_begin = nb_lits;
+    fs->deleted_capacity = nb_clauses > 0 ? (nb_clauses + 63) / 64 : 1;
+    fs->deleted = trusted_utils_calloc(fs->deleted_capacity, sizeof(u64));
+    fs->external = true;
+    return fs;
+}
+
+u64 formula_store_append(struct formula_store* fs, const int* lits, u64 nb_lits,
+    u64* out_nb_empty_clauses) {
+
+    if (MALLOB_UNLIKELY(fs->nb_lits + nb_lits > fs->lits_capacity)) {
+        while (fs->nb_lits + nb_lits > fs->lits_capacity) fs->lits_capacity *= 2;
+        fs->lits = trusted_utils_realloc(fs->lits, fs->lits_capacity * sizeof(int));
+    }
+    // Copy the literals and record the beginning of each completed clause
+    // in a single pass over the chunk.
+    int* dest = fs->lits + fs->nb_lits;
+    const u64 nb_clauses_before = fs->nb_clauses;
+    u64 nb_empty = 0;
+    for (u64 i = 0; i < nb_lits; i++) {
+        const int lit = lits[i];
+        dest[i] = lit;
+        if (lit != 0) continue;
+        // clause complete
+        if (MALLOB_UNLIKELY(fs->nb_clauses == fs->offsets_capacity)) {
+            fs->offsets_capacity *= 2;
+            fs->offsets = trusted_utils_realloc(fs->offsets, fs->offsets_capacity * sizeof(u64));
+        }
+        const u64 clause_end = fs->nb_lits + i;
+        if (clause_end == fs->clause_begin) nb_empty++;
+        fs->offsets[fs->nb_clauses++] = fs->clause_begin;
+        fs->clause_begin = clause_end + 1;
+    }
+    fs->nb_lits += nb_lits;
+    while (MALLOB_UNLIKELY(fs->nb_clauses > 64 * fs->deleted_capacity))
+        grow_deleted_bitmap(fs);
+    *out_nb_empty_clauses = nb_empty;
+    return fs->nb_clauses - nb_clauses_before;
+}
+
+int* formula_store_find(struct formula_store* fs, u64 id) {
+    const u64 idx = id-1; // wraps around for id=0
+    if (idx >= fs->nb_clauses) return 0;
+    if (fs->deleted[idx / 64] & (1UL << (idx % 64))) return 0;
+    return fs->lits + fs->offsets[idx];
+}
+
+bool formula_store_delete(struct formula_store* fs, u64 id) {
+    const u64 idx = id-1;
+    if (idx >= fs->nb_clauses) return false;
+    const u64 bit = 1UL << (idx % 64);
+    if (fs->deleted[idx / 64] & bit) return false;
+    fs->deleted[idx / 64] |= bit;
+    return true;
+}
+
+void formula_store_free(struct formula_store* fs) {
+    if (!fs->external) {
+        free(fs->lits);
+        free(fs->offsets);
+    }
+    free(fs->deleted);
+    free(fs);
+}
+
+u64 formula_store_bytes(const struct formula_store* fs) {
+    return fs->lits_capacity * sizeof(int) + fs->offsets_capacity * sizeof(u64)
+        + fs->deleted_capacity * sizeof(u64) + sizeof(struct formula_store);
+}
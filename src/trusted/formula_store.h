@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdbool.h>        // for bool
+#include "trusted_utils.h"  // for u64
+
+// Storage for the clauses of the original problem formula.
+// All literals are kept in a single array in which each clause is
+// terminated by a zero, and the clause with ID x (1 <= x <= nb_clauses)
+// begins at position offsets[x-1]. Once loading is complete, literals
+// and offsets are never written to again: deleting an original clause
+// only sets a bit in a separate bitmap. This way, the bulk of the formula
+// can be shared among several checkers (e.g., across fork()).
+
+struct formula_store {
+    int* lits;
+    u64 nb_lits;
+    u64 lits_capacity;
+    u64* offsets;
+    u64 nb_clauses;
+    u64 offsets_capacity;
+    u64 clause_begin; // offset of the clause currently being loaded
+    u64* deleted; // bitmap of deleted clauses
+    u64 deleted_capacity; // in 64-bit words
+    bool external; // literals and offsets are owned by someone else
+};
+
+struct formula_store* formula_store_init(void);
+// Use externally provided (e.g., memory-mapped) literals and offsets,
+// which must remain valid for the lifetime of the store.
+struct formula_store* formula_store_init_external(int* lits, u64 nb_lits,
+    u64* offsets, u64 nb_clauses);
+// Append a chunk of literals in which each zero terminates a clause.
+// A clause may begin in one chunk and end in a later chunk. Returns the
+// number of clauses completed within this chunk, of which the number of
+// empty clauses is written to the out parameter.
+u64 formula_store_append(struct formula_store* fs, const int* lits, u64 nb_lits,
+    u64* out_nb_empty_clauses);
+int* formula_store_find(struct formula_store* fs, u64 id);
+bool formula_store_delete(struct formula_store* fs, u64 id);
+void formula_store_free(struct formula_store* fs);
+// Bytes occupied by the store, including external (mapped) data.
+u64 formula_store_bytes(const struct formula_store* fs);
@@ -1,5 +1,6 @@
 
 #include "hash.h"
+#include "probes.h"  // for IMPCHECK_PROBE1, IMPCHECK_PROBE2
 #include "trusted_utils.h"
 #include <assert.h>  // for assert
 #include <stdlib.h>  // for free
@@ -45,6 +46,7 @@ bool find_entry(struct hash_table* ht, u64 key, u64* idx) {
 bool realloc_table(struct hash_table* ht) {
     u64 new_capacity = (u64) (ht->growth_factor * ht->capacity);
     //printf("GROW %lu -> %lu\n", ht->capacity, new_capacity);
+    IMPCHECK_PROBE2(table_grow_begin, ht->capacity, new_capacity);
     struct hash_table_entry* old_data = ht->data;
     u64 old_capacity = ht->capacity;
     ht->data = (struct hash_table_entry*) trusted_utils_calloc(new_capacity, sizeof(struct hash_table_entry));
@@ -60,6 +62,7 @@ bool realloc_table(struct hash_table* ht) {
         }
     }
     free(old_data);
+    IMPCHECK_PROBE1(table_grow_end, ht->size);
     return true;
 }
 
@@ -163,5 +166,13 @@ bool hash_table_delete_last_found(struct hash_table* ht) {
 }
 
 void hash_table_free(struct hash_table* ht) {
+    free(ht->data);
     free(ht);
 }
+
+u64 hash_table_probe_length(struct hash_table* ht, u64 key) {
+    const u64 home_idx = compute_idx(ht, key);
+    u64 idx = home_idx;
+    find_entry(ht, key, &idx);
+    return ((idx - home_idx) & (ht->capacity-1)) + 1;
+}
@@ -34,3 +34,5 @@ bool hash_table_insert(struct hash_table* ht, u64 key, void* data);
 bool hash_table_delete(struct hash_table* ht, u64 key);
 bool hash_table_delete_last_found(struct hash_table* ht);
 void hash_table_free(struct hash_table* ht);
+// Number of cells inspected by a lookup of the key (for diagnostics).
+u64 hash_table_probe_length(struct hash_table* ht, u64 key);
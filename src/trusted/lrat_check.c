@@ -1,10 +1,20 @@
 
+#include <malloc.h>         // for malloc_usable_size
+#include <stdint.h>         // for uintptr_t
 #include <stdlib.h>
 #include <stdbool.h>        // for bool, false, true
 #include <stdio.h>          // for snprintf
+#include <string.h>         // for memcpy
+#include "formula_image.h"  // for formula_image_map, formula_image
+#include "formula_store.h"  // for formula_store_find, formula_store_append
 #include "hash.h"           // for hash_table_find, hash_table_delete_last_f...
-#include "siphash.h"        // for siphash_digest, siphash_update
+#include "probes.h"         // for IMPCHECK_PROBE2, IMPCHECK_PROBE3
+#include "secret.h"         // for SECRET_KEY
+#include "siphash.h"        // for siphash_ctx_init, siphash_ctx_update, ...
+#include "snapshot.h"       // for snapshot_write, snapshot_header, snapshot
+#include "stats.h"          // for stats_memory_add, stats_memory, ...
 #include "trusted_utils.h"  // for u64, trusted_utils_msgstr, MALLOB_UNLIKELY
+#include "watch_index.h"    // for watch_index_add, watch_index_propagate, ...
 
 // Instantiate int_vec
 #define TYPE int
@@ -20,26 +30,68 @@
 #undef TYPED
 #undef TYPE
 
-// The hash table where we keep all clauses and which uses most of our RAM.
-// We still use a power-of-two growth policy since this makes lookups faster.
-struct hash_table* clause_table;
+// The state of a checker. Several checkers can exist in a process, each
+// of which must only be used by one thread at a time.
+struct lrat_check {
 
-// Table of all variables with their current assignment (-1/0/1).
-// We perform all LRUP checks using one big vector of all variable polarities,
-// which is set and reset for each check. This allows for O(1) queries
-// for a literal's assignment.
-struct i8_vec* var_values;
+    // The hash table where we keep all derived and imported clauses as well
+    // as original clauses added after loading (see lrat_check_add_increment).
+    // We still use a power-of-two growth policy since this makes lookups faster.
+    // The lowest bit of each (aligned) clause pointer in the table is set iff
+    // the clause was imported, which is needed for memory accounting, and the
+    // second lowest bit is set iff the clause is an original clause.
+    struct hash_table* clause_table;
+    u64 clause_table_capacity; // as last accounted for
 
-// We remember the set variables in a stack to reset them later.
-struct int_vec* assigned_units;
+    // The clauses of the original problem formula, which usually make up
+    // most of our RAM. They are kept apart from the hash table in a single
+    // block of memory which is read-only after loading.
+    struct formula_store* formula;
+    struct formula_image image; // if the formula is used from a mapped image
 
-bool check_model;
-bool lenient;
-u64 id_to_add = 1;
-u64 nb_loaded_clauses = 0;
-struct int_vec* clause_to_add;
-bool done_loading = false;
-bool unsat_proven = false;
+    // Table of all variables with their current assignment (-1/0/1).
+    // We perform all LRUP checks using one big vector of all variable polarities,
+    // which is set and reset for each check. This allows for O(1) queries
+    // for a literal's assignment.
+    struct i8_vec* var_values;
+
+    // We remember the set variables in a stack to reset them later.
+    struct int_vec* assigned_units;
+
+    // Persistent top-level assignment: the literal of each live unit clause
+    // remains assigned in var_values across checks, so that hint chains do
+    // not need to re-derive it and resetting a check leaves it alone.
+    // unit_counts[2*var] and unit_counts[2*var+1] are the numbers of live unit
+    // clauses with the literals var and -var; the assignment is retracted once
+    // no such clause is left. If there are units of both polarities, var keeps
+    // the assignment it had first and counts as a top-level conflict.
+    u32* unit_counts;
+    u64 nb_root_conflicts;
+    int root_nb_vars;
+
+    // Optional checking of derivations without hints by unit propagation over
+    // a watched-literal index of all live clauses. The index is only built upon
+    // the first such derivation and maintained incrementally from then on.
+    bool rup_fallback;
+    struct watch_index* watches;
+    int* rup_queue; // variables assigned during a check
+
+    // The formula signature is computed while loading in a SipHash context of
+    // its own, so that clause signatures can be computed meanwhile.
+    struct siphash formula_hash;
+
+    // Only the process-wide checker reports to the (unsynchronized) statistics
+    // in stats.h. It adds its share as the difference to what it accounted for last.
+    bool process_stats;
+    u64 accounted[STATS_NB_MEMORY];
+
+    bool check_model;
+    bool lenient;
+    u64 max_clause_id;
+    u64 nb_loaded_clauses;
+    bool done_loading;
+    bool unsat_proven;
+};
 
 
 int* clause_init(const int* data, int nb_lits) {
@@ -49,20 +101,181 @@ int* clause_init(const int* data, int nb_lits) {
     return cls;
 }
 
-void reset_assignments(void) {
-    for (u64 i = 0; i < assigned_units->size; i++)
-        var_values->data[assigned_units->data[i]] = 0;
-    int_vec_clear(assigned_units);
+#define IMPORTED_TAG 1UL
+#define ORIGINAL_TAG 2UL
+#define CLAUSE_TAGS (IMPORTED_TAG | ORIGINAL_TAG)
+int* untag_clause(void* val) {
+    return (int*) ((uintptr_t) val & ~CLAUSE_TAGS);
+}
+
+enum stats_memory clause_memory_kind(uintptr_t tags) {
+    if (tags & ORIGINAL_TAG) return STATS_MEM_ORIGINAL;
+    return (tags & IMPORTED_TAG) ? STATS_MEM_IMPORTED : STATS_MEM_PRODUCED;
+}
+
+// Heap bytes of a clause, including the allocator's chunk header.
+u64 clause_bytes(int* cls) {
+    return malloc_usable_size(cls) + sizeof(size_t);
+}
+
+// Set this checker's share of a process-wide memory statistic.
+void account(struct lrat_check* lc, enum stats_memory kind, u64 nb_bytes) {
+    if (!lc->process_stats) return;
+    stats_memory_add(kind, (long) nb_bytes - (long) lc->accounted[kind]);
+    lc->accounted[kind] = nb_bytes;
+}
+
+void account_clause(struct lrat_check* lc, uintptr_t tags, long nb_bytes) {
+    if (lc->process_stats) stats_memory_add(clause_memory_kind(tags), nb_bytes);
+}
+
+void account_index(struct lrat_check* lc) {
+    u64 nb_bytes = lc->clause_table_capacity * sizeof(struct hash_table_entry);
+    if (lc->watches) nb_bytes += lc->watches->nb_bytes + lc->watches->clauses->capacity * sizeof(struct hash_table_entry);
+    account(lc, STATS_MEM_TABLE, nb_bytes);
+}
+
+void account_table(struct lrat_check* lc) {
+    if (MALLOB_UNLIKELY(lc->clause_table->capacity != lc->clause_table_capacity)) {
+        lc->clause_table_capacity = lc->clause_table->capacity;
+        account_index(lc);
+    }
+}
+
+void account_scratch(struct lrat_check* lc) {
+    account(lc, STATS_MEM_SCRATCH, lc->var_values->capacity * sizeof(signed char)
+        + lc->assigned_units->capacity * sizeof(int) + 2 * (lc->root_nb_vars+1) * sizeof(u32)
+        + (lc->rup_fallback ? (lc->root_nb_vars+1) * sizeof(int) : 0));
+}
+
+bool is_root(struct lrat_check* lc, int var) {
+    return lc->unit_counts[2*var] > 0 || lc->unit_counts[2*var+1] > 0;
+}
+
+void update_unit_count(struct lrat_check* lc, int lit, int delta) {
+    const int var = lit > 0 ? lit : -lit;
+    if (MALLOB_UNLIKELY(var > lc->root_nb_vars)) return;
+    u32* pos = &lc->unit_counts[2*var];
+    u32* neg = &lc->unit_counts[2*var+1];
+    const bool was_conflict = *pos > 0 && *neg > 0;
+    *(lit > 0 ? pos : neg) += delta;
+    const bool is_conflict = *pos > 0 && *neg > 0;
+    lc->nb_root_conflicts += (long) is_conflict - (long) was_conflict;
+
+    const signed char old_value = lc->var_values->data[var];
+    const signed char new_value = is_conflict ? old_value : (*pos > 0 ? 1 : (*neg > 0 ? -1 : 0));
+    if (new_value == old_value) return;
+    lc->var_values->data[var] = 0;
+    if (old_value != 0 && lc->watches) watch_index_unassign(lc->watches, old_value > 0 ? var : -var);
+    lc->var_values->data[var] = new_value;
+    if (new_value != 0 && lc->watches) watch_index_assign(lc->watches, new_value > 0 ? var : -var);
+}
+
+void add_root_unit(struct lrat_check* lc, int lit) {
+    update_unit_count(lc, lit, 1);
+}
+
+void remove_root_unit(struct lrat_check* lc, const int* cls) {
+    if (cls[0] == 0 || cls[1] != 0) return; // not a unit clause
+    update_unit_count(lc, cls[0], -1);
+}
+
+void add_root_units_of_formula(struct lrat_check* lc) {
+    for (u64 id = 1; id <= lc->formula->nb_clauses; id++) {
+        const int* cls = formula_store_find(lc->formula, id);
+        if (cls && cls[0] != 0 && cls[1] == 0) add_root_unit(lc, cls[0]);
+    }
+}
+
+int* find_clause(struct lrat_check* lc, u64 id) {
+    int* cls = formula_store_find(lc->formula, id);
+    if (cls) return cls;
+    return untag_clause(hash_table_find(lc->clause_table, id));
+}
+
+void reset_assignments(struct lrat_check* lc) {
+    for (u64 i = 0; i < lc->assigned_units->size; i++)
+        lc->var_values->data[lc->assigned_units->data[i]] = 0;
+    int_vec_clear(lc->assigned_units);
+}
+
+int clause_length(const int* cls) {
+    int len = 0;
+    while (cls[len] != 0) len++;
+    return len;
+}
+
+void build_watch_index(struct lrat_check* lc) {
+    lc->watches = watch_index_init(lc->root_nb_vars, lc->var_values->data);
+    for (u64 id = 1; id <= lc->formula->nb_clauses; id++) {
+        const int* cls = formula_store_find(lc->formula, id);
+        if (!cls) continue;
+        const int len = clause_length(cls);
+        if (len >= 2) watch_index_add(lc->watches, id, cls, len);
+    }
+    for (u64 i = 0; i < lc->clause_table->capacity; i++) {
+        const struct hash_table_entry* entry = &lc->clause_table->data[i];
+        if (entry->key == 0) continue;
+        const int* cls = untag_clause(entry->val);
+        const int len = clause_length(cls);
+        if (len >= 2) watch_index_add(lc->watches, entry->key, cls, len);
+    }
+    account_index(lc);
+}
+
+// Check a clause without hints: assume the negation of its literals and
+// propagate them (on top of the top-level assignment) to a conflict.
+bool check_clause_rup(struct lrat_check* lc, u64 base_id, const int* lits, int nb_lits) {
+    IMPCHECK_PROBE3(check_begin, base_id, nb_lits, 0);
+    if (MALLOB_UNLIKELY(!lc->watches)) build_watch_index(lc);
+    watch_index_settle(lc->watches);
+
+    u64 size = 0;
+    // Live unit clauses of opposite polarities already imply everything
+    bool implied = lc->nb_root_conflicts > 0;
+    for (int i = 0; i < nb_lits && !implied; i++) {
+        const int var = lits[i] > 0 ? lits[i] : -lits[i];
+        const signed char negated = lits[i]>0 ? -1 : 1;
+        if (lc->var_values->data[var] != 0) {
+            if (lc->var_values->data[var] == negated) continue;
+            implied = true; // literal is true
+            break;
+        }
+        lc->var_values->data[var] = negated;
+        lc->rup_queue[size++] = var;
+    }
+    if (!implied) implied = !watch_index_propagate(lc->watches, lc->rup_queue, &size);
+    // Reset all assignments except for the top-level ones
+    for (u64 i = 0; i < size; i++) lc->var_values->data[lc->rup_queue[i]] = 0;
+    account_index(lc);
+
+    if (!implied) snprintf(trusted_utils_msgstr, 512, "Derivation %lu: no conflict by unit propagation", base_id);
+    IMPCHECK_PROBE2(check_end, base_id, implied);
+    return implied;
 }
 
-bool check_clause(u64 base_id, const int* lits, int nb_lits, const u64* hints, int nb_hints) {
+bool check_clause(struct lrat_check* lc, u64 base_id, const int* lits, int nb_lits, const u64* hints, int nb_hints) {
+    IMPCHECK_PROBE3(check_begin, base_id, nb_lits, nb_hints);
 
-    int_vec_reserve(assigned_units, nb_lits + nb_hints);
+    if (MALLOB_UNLIKELY((u64) (nb_lits + nb_hints) > lc->assigned_units->capacity)) {
+        int_vec_reserve(lc->assigned_units, nb_lits + nb_hints);
+        account_scratch(lc);
+    }
     // Assume the negation of each literal in the new clause
     for (int i = 0; i < nb_lits; i++) {
         const int var = lits[i] > 0 ? lits[i] : -lits[i];
-        var_values->data[var] = lits[i]>0 ? -1 : 1; // negated
-        int_vec_push(assigned_units, var); // remember to reset later
+        const signed char negated = lits[i]>0 ? -1 : 1;
+        if (MALLOB_UNLIKELY(lc->var_values->data[var] != 0)) {
+            // Already assigned at the top level or by a duplicate literal.
+            if (lc->var_values->data[var] == negated) continue;
+            // The literal is true, so the clause is implied by a live unit
+            // clause (or is a tautology).
+            reset_assignments(lc);
+            IMPCHECK_PROBE2(check_end, base_id, true);
+            return true;
+        }
+        lc->var_values->data[var] = negated;
+        int_vec_push(lc->assigned_units, var); // remember to reset later
     }
 
     // Traverse the provided hints to derive a conflict, i.e., the empty clause
@@ -71,7 +284,7 @@ bool check_clause(u64 base_id, const int* lits, int nb_lits, const u64* hints, i
 
         // Find the clause for this hint
         const u64 hint_id = hints[i];
-        int* cls = (int*) hash_table_find(clause_table, hint_id);
+        int* cls = find_clause(lc, hint_id);
         if (MALLOB_UNLIKELY(!cls)) {
             // ERROR - hint not found
             snprintf(trusted_utils_msgstr, 512, "Derivation %lu: hint %lu not found", base_id, hint_id);
@@ -80,11 +293,12 @@ bool check_clause(u64 base_id, const int* lits, int nb_lits, const u64* hints, i
 
         // Interpret hint clause (should derive a new unit clause)
         int new_unit = 0;
+        bool satisfied = false;
         for (int lit_idx = 0; ; lit_idx++) { // for each literal ...
             const int lit = cls[lit_idx];
             if (lit == 0) break;           // ... until termination zero
             const int var = lit > 0 ? lit : -lit;
-            if (var_values->data[var] == 0) {
+            if (lc->var_values->data[var] == 0) {
                 // Literal is unassigned
                 if (MALLOB_UNLIKELY(new_unit != 0)) {
                     // ERROR - multiple unassigned literals in hint clause!
@@ -95,8 +309,14 @@ bool check_clause(u64 base_id, const int* lits, int nb_lits, const u64* hints, i
                 continue;
             }
             // Literal is fixed
-            const bool sign = var_values->data[var]>0;
+            const bool sign = lc->var_values->data[var]>0;
             if (MALLOB_UNLIKELY(sign == (lit>0))) {
+                if (is_root(lc, var)) {
+                    // Satisfied at the top level: the hint is redundant
+                    // (e.g., a live unit clause) and can be skipped.
+                    new_unit = 0;
+                    satisfied = true; break;
+                }
                 // ERROR - clause is satisfied, so it is not a correct hint
                 snprintf(trusted_utils_msgstr, 512, "Derivation %lu: dependency %lu is satisfied", base_id, hint_id);
                 ok = false; break;
@@ -104,30 +324,28 @@ bool check_clause(u64 base_id, const int* lits, int nb_lits, const u64* hints, i
             // All OK - literal is false, thus (virtually) removed from the clause
         }
         if (!ok) break; // error detected - stop
+        if (satisfied) continue;
 
         // NO unit derived?
         if (new_unit == 0) {
             // No unassigned literal in the clause && clause not satisfied
-            // -> Empty clause derived.
-            if (MALLOB_UNLIKELY(i+1 < nb_hints)) {
-                // ERROR - not at the final hint yet!
-                snprintf(trusted_utils_msgstr, 512, "Derivation %lu: empty clause produced at non-final hint %lu", base_id, hint_id);
-                break;
-            }
-            // Final hint produced empty clause - everything OK!
-            reset_assignments();
+            // -> Empty clause derived. Since the top-level assignment can
+            // make hints redundant, this may happen before the final hint.
+            reset_assignments(lc);
+            IMPCHECK_PROBE2(check_end, base_id, true);
             return true;
         }
         // Insert the new derived unit clause
         int var = new_unit > 0 ? new_unit : -new_unit;
-        var_values->data[var] = new_unit>0 ? 1 : -1;
-        int_vec_push(assigned_units, var); // remember to reset later
+        lc->var_values->data[var] = new_unit>0 ? 1 : -1;
+        int_vec_push(lc->assigned_units, var); // remember to reset later
     }
 
     // ERROR - something went wrong
     if (trusted_utils_msgstr[0] == '\0')
         snprintf(trusted_utils_msgstr, 512, "Derivation %lu: no empty clause was produced", base_id);
-    reset_assignments();
+    reset_assignments(lc);
+    IMPCHECK_PROBE2(check_end, base_id, false);
     return false;
 }
 
@@ -152,156 +370,469 @@ bool clauses_equivalent(int* left_cls, int* right_cls) {
     return left_size == right_size;
 }
 
-bool lrat_check_add_axiomatic_clause(u64 id, const int* lits, int nb_lits) {
+bool insert_clause(struct lrat_check* lc, u64 id, const int* lits, int nb_lits, uintptr_t tags) {
     int* cls = clause_init(lits, nb_lits);
-    bool ok = hash_table_insert(clause_table, id, cls);
+    int* orig_cls = formula_store_find(lc->formula, id);
+    bool ok = !orig_cls && hash_table_insert(lc->clause_table, id, (void*) ((uintptr_t) cls | tags));
+    if (ok) {
+        account_clause(lc, tags, clause_bytes(cls));
+        account_table(lc);
+        if (lc->watches && nb_lits >= 2) {
+            watch_index_add(lc->watches, id, cls, nb_lits);
+            account_index(lc);
+        }
+        if (id > lc->max_clause_id) lc->max_clause_id = id;
+    }
     if (!ok) {
-        if (lenient) {
+        if (lc->lenient) {
             // In lenient mode, ignore the addition if and only if the clauses
             // are syntactically equivalent (except for literal ordering).
-            int* old_cls = (int*) hash_table_find(clause_table, id);
+            int* old_cls = orig_cls ? orig_cls : untag_clause(hash_table_find(lc->clause_table, id));
             if (old_cls && clauses_equivalent(old_cls, cls)) {
                 ok = true;
             }
         }
+        free(cls);
         if (!ok) snprintf(trusted_utils_msgstr, 512, "Insertion of clause %lu unsuccessful - already present?", id);
     }
-    else if (nb_lits == 0) unsat_proven = true; // added top-level empty clause!
+    else if (nb_lits == 0) lc->unsat_proven = true; // added top-level empty clause!
+    else if (nb_lits == 1) add_root_unit(lc, lits[0]);
     return ok;
 }
 
-void lrat_check_init(int nb_vars, bool opt_check_model, bool opt_lenient) {
-    clause_table = hash_table_init(16);
-    clause_to_add = int_vec_init(512);
-    var_values = i8_vec_init(nb_vars+1);
-    assigned_units = int_vec_init(512);
-    check_model = opt_check_model;
-    lenient = opt_lenient;
+bool lrat_check_add_axiomatic_clause(struct lrat_check* lc, u64 id, const int* lits, int nb_lits) {
+    return insert_clause(lc, id, lits, nb_lits, IMPORTED_TAG);
+}
+
+bool lrat_check_add_increment(struct lrat_check* lc, u64 first_id, const int* lits, int nb_lits) {
+    if (!lc->done_loading) {
+        snprintf(trusted_utils_msgstr, 512, "Increment illegal - loading formula was not concluded");
+        return false;
+    }
+    if (nb_lits > 0 && lits[nb_lits-1] != 0) {
+        snprintf(trusted_utils_msgstr, 512, "Increment: literals left in unterminated clause");
+        return false;
+    }
+    for (int i = 0; i < nb_lits; i++) {
+        if (MALLOB_UNLIKELY(lits[i] > lc->root_nb_vars || lits[i] < -lc->root_nb_vars)) {
+            snprintf(trusted_utils_msgstr, 512, "Increment: literal %i exceeds the %i declared variables", lits[i], lc->root_nb_vars);
+            return false;
+        }
+    }
+    u64 id = first_id;
+    for (int begin = 0, end = 0; end < nb_lits; end++) {
+        if (lits[end] != 0) continue;
+        if (!insert_clause(lc, id, lits+begin, end-begin, ORIGINAL_TAG)) return false;
+        id++;
+        begin = end+1;
+    }
+    return true;
+}
+
+struct lrat_check* lrat_check_init(int nb_vars, bool opt_check_model, bool opt_lenient, bool opt_process_stats) {
+    struct lrat_check* lc = trusted_utils_calloc(1, sizeof(struct lrat_check));
+    lc->process_stats = opt_process_stats;
+    lc->clause_table = hash_table_init(16);
+    lc->formula = formula_store_init();
+    siphash_ctx_init(&lc->formula_hash, SECRET_KEY);
+    lc->var_values = i8_vec_init(nb_vars+1);
+    lc->assigned_units = int_vec_init(512);
+    lc->root_nb_vars = nb_vars;
+    lc->unit_counts = trusted_utils_calloc(2 * (u64) nb_vars + 2, sizeof(u32));
+    account_table(lc);
+    account_scratch(lc);
+    account(lc, STATS_MEM_ORIGINAL, formula_store_bytes(lc->formula));
+    lc->check_model = opt_check_model;
+    lc->lenient = opt_lenient;
+    return lc;
+}
+
+void lrat_check_free(struct lrat_check* lc) {
+    for (u64 i = 0; i < lc->clause_table->capacity; i++) {
+        const struct hash_table_entry* entry = &lc->clause_table->data[i];
+        if (entry->key == 0) continue;
+        int* cls = untag_clause(entry->val);
+        account_clause(lc, (uintptr_t) entry->val, -(long) clause_bytes(cls));
+        free(cls);
+    }
+    hash_table_free(lc->clause_table);
+    formula_store_free(lc->formula);
+    if (lc->image.mapping) formula_image_unmap(&lc->image);
+    i8_vec_free(lc->var_values);
+    int_vec_free(lc->assigned_units);
+    free(lc->unit_counts);
+    if (lc->watches) watch_index_free(lc->watches);
+    free(lc->rup_queue);
+    account(lc, STATS_MEM_ORIGINAL, 0);
+    account(lc, STATS_MEM_TABLE, 0);
+    account(lc, STATS_MEM_SCRATCH, 0);
+    free(lc);
 }
 
-bool lrat_check_load(int lit) {
-    if (lit == 0) {
-        if (!lrat_check_add_axiomatic_clause(id_to_add, clause_to_add->data, clause_to_add->size)) {
+bool lrat_check_load(struct lrat_check* lc, const int* lits, int nb_lits) {
+    // The formula signature is computed over the plain sequence of literals,
+    // so we can hash the entire chunk at once.
+    siphash_ctx_update(&lc->formula_hash, (u8*) lits, nb_lits*sizeof(int));
+    const u64 first_id = lc->formula->nb_clauses + 1;
+    u64 nb_empty;
+    const u64 nb_completed = formula_store_append(lc->formula, lits, nb_lits, &nb_empty);
+    if (nb_empty > 0) lc->unsat_proven = true; // loaded top-level empty clause!
+    account(lc, STATS_MEM_ORIGINAL, formula_store_bytes(lc->formula));
+    // Only if clauses have been added before loading has finished,
+    // we need to check the new IDs against the hash table.
+    for (u64 id = first_id; lc->clause_table->size > 0 && id < first_id + nb_completed; id++) {
+        if (hash_table_find(lc->clause_table, id)) {
+            snprintf(trusted_utils_msgstr, 512, "Insertion of clause %lu unsuccessful - already present?", id);
             return false;
         }
-        id_to_add++;
-        int_vec_push(clause_to_add, 0);
-        siphash_update((u8*) clause_to_add->data, clause_to_add->size*sizeof(int));
-        int_vec_clear(clause_to_add);
-        return true;
     }
-    int_vec_push(clause_to_add, lit);
     return true;
 }
 
-bool lrat_check_end_load(u8** out_sig) {
-    if (clause_to_add->size > 0) {
+bool lrat_check_load_image(struct lrat_check* lc, const char* path, int nb_vars) {
+    struct formula_image img;
+    if (!formula_image_map(path, &img)) {
+        snprintf(trusted_utils_msgstr, 512, "Cannot map formula image %s", path);
+        return false;
+    }
+    const struct formula_image_header* header = img.header;
+    if (header->nb_vars != (u64) nb_vars || lc->formula->nb_lits > 0) {
+        snprintf(trusted_utils_msgstr, 512, "Formula image does not match loading state");
+        formula_image_unmap(&img);
+        return false;
+    }
+    // Verify the (unsigned) clause offsets against the (signed) literals
+    u64 clause_begin = 0, nb_clauses = 0;
+    for (u64 i = 0; i < header->nb_lits; i++) {
+        if (img.lits[i] != 0) continue;
+        if (nb_clauses == header->nb_clauses || img.offsets[nb_clauses] != clause_begin) break;
+        if (i == clause_begin) lc->unsat_proven = true; // loaded top-level empty clause!
+        nb_clauses++;
+        clause_begin = i+1;
+    }
+    if (nb_clauses != header->nb_clauses || clause_begin != header->nb_lits) {
+        snprintf(trusted_utils_msgstr, 512, "Formula image has inconsistent clause offsets");
+        formula_image_unmap(&img);
+        return false;
+    }
+    for (u64 id = 1; lc->clause_table->size > 0 && id <= nb_clauses; id++) {
+        if (hash_table_find(lc->clause_table, id)) {
+            snprintf(trusted_utils_msgstr, 512, "Insertion of clause %lu unsuccessful - already present?", id);
+            formula_image_unmap(&img);
+            return false;
+        }
+    }
+    // Hash all literals at once; the signature is checked in lrat_check_end_load
+    siphash_ctx_update(&lc->formula_hash, (u8*) img.lits, header->nb_lits*sizeof(int));
+    // The mapping remains alive as long as the checker.
+    formula_store_free(lc->formula);
+    lc->image = img;
+    lc->formula = formula_store_init_external((int*) img.lits, header->nb_lits,
+        (u64*) img.offsets, nb_clauses);
+    account(lc, STATS_MEM_ORIGINAL, formula_store_bytes(lc->formula));
+    return true;
+}
+
+bool lrat_check_end_load(struct lrat_check* lc, u8** out_sig) {
+    if (lc->formula->clause_begin < lc->formula->nb_lits) {
         snprintf(trusted_utils_msgstr, 512, "literals left in unterminated clause");
         return false;
     }
-    siphash_pad(2); // two-byte padding for formula signature input
-    *out_sig = siphash_digest();
-    done_loading = true;
-    nb_loaded_clauses = id_to_add-1;
+    siphash_ctx_pad(&lc->formula_hash, 2); // two-byte padding for formula signature input
+    *out_sig = siphash_ctx_digest(&lc->formula_hash);
+    add_root_units_of_formula(lc);
+    lc->done_loading = true;
+    lc->nb_loaded_clauses = lc->formula->nb_clauses;
     return true;
 }
 
 
-bool lrat_check_add_clause(u64 id, const int* lits, int nb_lits, const u64* hints, int nb_hints) {
-    if (!check_clause(id, lits, nb_lits, hints, nb_hints)) {
+void lrat_check_use_rup_fallback(struct lrat_check* lc) {
+    if (lc->rup_fallback) return;
+    lc->rup_fallback = true;
+    lc->rup_queue = trusted_utils_malloc((lc->root_nb_vars+1) * sizeof(int));
+    account_scratch(lc);
+}
+
+bool lrat_check_add_clause(struct lrat_check* lc, u64 id, const int* lits, int nb_lits, const u64* hints, int nb_hints) {
+    const bool ok = (nb_hints == 0 && lc->rup_fallback) ? check_clause_rup(lc, id, lits, nb_lits)
+        : check_clause(lc, id, lits, nb_lits, hints, nb_hints);
+    if (!ok) {
         return false;
     }
-    return lrat_check_add_axiomatic_clause(id, lits, nb_lits);
+    return insert_clause(lc, id, lits, nb_lits, 0);
 }
 
-bool lrat_check_delete_clause(const u64* ids, int nb_ids) {
-    for (int i = 0; i < nb_ids; i++) {
-        u64 id = ids[i];
-        int* cls = hash_table_find(clause_table, id);
-        if (!cls) {
-            snprintf(trusted_utils_msgstr, 512, "Clause deletion: ID %lu not found", id);
-            return false;
+bool lrat_check_has_clause(struct lrat_check* lc, u64 id) {
+    return find_clause(lc, id) != 0;
+}
+
+bool delete_clause(struct lrat_check* lc, u64 id) {
+    const int* orig_cls = formula_store_find(lc->formula, id);
+    if (orig_cls) {
+        // Original problem clause: its memory is not released
+        // (to keep it shareable), we only mark it as deleted.
+        // Do not delete it at all to enable checking of a model.
+        if (!lc->check_model) {
+            // The units of the formula only enter the top-level assignment
+            // upon lrat_check_end_load, which skips deleted clauses.
+            if (lc->done_loading) remove_root_unit(lc, orig_cls);
+            if (lc->watches) watch_index_remove(lc->watches, id);
+            formula_store_delete(lc->formula, id);
         }
-        if (check_model && id <= nb_loaded_clauses) {
-            // Do not delete original problem clauses to enable checking of a model
-            continue;
+        return true;
+    }
+    void* val = hash_table_find(lc->clause_table, id);
+    if (!val) {
+        snprintf(trusted_utils_msgstr, 512, "Clause deletion: ID %lu not found", id);
+        return false;
+    }
+    // Keep original clauses added after loading to enable checking of a model
+    if (((uintptr_t) val & ORIGINAL_TAG) && lc->check_model) return true;
+    int* cls = untag_clause(val);
+    remove_root_unit(lc, cls);
+    if (lc->watches) watch_index_remove(lc->watches, id);
+    account_clause(lc, (uintptr_t) val, -(long) clause_bytes(cls));
+    if (MALLOB_UNLIKELY(stats_enabled) && lc->process_stats)
+        stats_add_value(STATS_DELETION_AGE, lc->max_clause_id >= id ? lc->max_clause_id - id : 0);
+    free(cls);
+    if (!hash_table_delete_last_found(lc->clause_table)) {
+        snprintf(trusted_utils_msgstr, 512, "Clause deletion: Hash table error for ID %lu", id);
+        return false;
+    }
+    return true;
+}
+
+bool lrat_check_delete_clause(struct lrat_check* lc, const u64* ids, int nb_ids) {
+    bool ok = true;
+    for (int i = 0; ok && i < nb_ids; i++) ok = delete_clause(lc, ids[i]);
+    if (lc->watches) account_index(lc);
+    return ok;
+}
+
+bool lrat_check_delete_range(struct lrat_check* lc, u64 first_id, u64 nb_ids, u64 stride) {
+    if (nb_ids == 0) return true;
+    if (stride == 0 || first_id == 0 || (nb_ids-1) > (~0UL - first_id) / stride) {
+        snprintf(trusted_utils_msgstr, 512, "Clause deletion: invalid ID range %lu+%lu*%lu", first_id, nb_ids, stride);
+        return false;
+    }
+    bool ok = true;
+    u64 id = first_id;
+    for (u64 i = 0; ok && i < nb_ids; i++, id += stride) ok = delete_clause(lc, id);
+    if (lc->watches) account_index(lc);
+    return ok;
+}
+
+bool lrat_check_delete_bitmap(struct lrat_check* lc, u64 base_id, const u64* words, int nb_words) {
+    if (nb_words > 0 && (base_id == 0 || base_id > ~0UL - 64 * (u64) nb_words)) {
+        snprintf(trusted_utils_msgstr, 512, "Clause deletion: invalid bitmap base ID %lu", base_id);
+        return false;
+    }
+    bool ok = true;
+    for (int i = 0; ok && i < nb_words; i++) {
+        u64 word = words[i];
+        while (ok && word != 0) {
+            const int bit = __builtin_ctzl(word);
+            word &= word - 1;
+            ok = delete_clause(lc, base_id + 64 * (u64) i + bit);
         }
-        free(cls);
-        if (!hash_table_delete_last_found(clause_table)) {
-            snprintf(trusted_utils_msgstr, 512, "Clause deletion: Hash table error for ID %lu", id);
-            return false;
+    }
+    if (lc->watches) account_index(lc);
+    return ok;
+}
+
+bool lrat_check_write_snapshot(struct lrat_check* lc, struct snapshot_writer* w, struct snapshot_header* h) {
+    if (!lc->done_loading) {
+        snprintf(trusted_utils_msgstr, 512, "Checkpoint illegal - loading formula was not concluded");
+        return false;
+    }
+    h->flags = (lc->check_model ? SNAPSHOT_FLAG_CHECK_MODEL : 0) | (lc->lenient ? SNAPSHOT_FLAG_LENIENT : 0)
+        | (lc->unsat_proven ? SNAPSHOT_FLAG_UNSAT_PROVEN : 0);
+    h->nb_lits = lc->formula->nb_lits;
+    h->nb_clauses = lc->formula->nb_clauses;
+    h->nb_deleted_words = (lc->formula->nb_clauses + 63) / 64;
+    h->nb_loaded_clauses = lc->nb_loaded_clauses;
+    h->max_clause_id = lc->max_clause_id;
+    h->nb_derived = lc->clause_table->size;
+    snapshot_write(w, h, sizeof(struct snapshot_header));
+
+    // original formula
+    snapshot_write(w, lc->formula->lits, lc->formula->nb_lits * sizeof(int));
+    const u64 padding = 0;
+    snapshot_write(w, &padding, ((lc->formula->nb_lits * sizeof(int) + 7) / 8) * 8 - lc->formula->nb_lits * sizeof(int));
+    snapshot_write(w, lc->formula->offsets, lc->formula->nb_clauses * sizeof(u64));
+    snapshot_write(w, lc->formula->deleted, h->nb_deleted_words * sizeof(u64));
+
+    // derived and imported clauses
+    for (u64 i = 0; i < lc->clause_table->capacity; i++) {
+        const struct hash_table_entry* entry = &lc->clause_table->data[i];
+        if (entry->key == 0) continue;
+        const int* cls = untag_clause(entry->val);
+        struct snapshot_clause rec;
+        rec.id = entry->key;
+        for (rec.nb_lits = 0; cls[rec.nb_lits] != 0; rec.nb_lits++) {}
+        rec.imported = (uintptr_t) entry->val & CLAUSE_TAGS;
+        snapshot_write(w, &rec, sizeof(rec));
+        snapshot_write(w, cls, rec.nb_lits * sizeof(int));
+    }
+    return true;
+}
+
+bool lrat_check_restore(struct lrat_check* lc, const struct snapshot* snap) {
+    const struct snapshot_header* h = snap->header;
+    if (h->nb_deleted_words != (h->nb_clauses + 63) / 64) {
+        snprintf(trusted_utils_msgstr, 512, "Snapshot has an inconsistent layout");
+        return false;
+    }
+    lc->check_model = h->flags & SNAPSHOT_FLAG_CHECK_MODEL;
+    lc->lenient = h->flags & SNAPSHOT_FLAG_LENIENT;
+    lc->unsat_proven = h->flags & SNAPSHOT_FLAG_UNSAT_PROVEN;
+    lc->nb_loaded_clauses = h->nb_loaded_clauses;
+    lc->max_clause_id = h->max_clause_id;
+    lc->done_loading = true;
+
+    // The original formula is used directly from the mapping, which
+    // must remain alive as long as the checker.
+    formula_store_free(lc->formula);
+    lc->formula = formula_store_init_external((int*) snap->lits, h->nb_lits,
+        (u64*) snap->offsets, h->nb_clauses);
+    memcpy(lc->formula->deleted, snap->deleted, h->nb_deleted_words * sizeof(u64));
+    account(lc, STATS_MEM_ORIGINAL, formula_store_bytes(lc->formula));
+    add_root_units_of_formula(lc);
+
+    const u8* pos = snap->derived;
+    for (u64 i = 0; i < h->nb_derived; i++) {
+        struct snapshot_clause rec;
+        if (pos + sizeof(rec) > snap->derived_end) break;
+        memcpy(&rec, pos, sizeof(rec));
+        pos += sizeof(rec);
+        if (rec.nb_lits < 0 || pos + rec.nb_lits * sizeof(int) > snap->derived_end) break;
+        int* cls = trusted_utils_malloc((rec.nb_lits+1) * sizeof(int));
+        memcpy(cls, pos, rec.nb_lits * sizeof(int));
+        cls[rec.nb_lits] = 0;
+        pos += rec.nb_lits * sizeof(int);
+        if ((rec.imported & ~CLAUSE_TAGS)
+                || !hash_table_insert(lc->clause_table, rec.id, (void*) ((uintptr_t) cls | rec.imported))) {
+            free(cls);
+            break;
         }
+        account_clause(lc, rec.imported, clause_bytes(cls));
+        if (rec.nb_lits == 1) add_root_unit(lc, cls[0]);
+    }
+    account_table(lc);
+    if (lc->clause_table->size != h->nb_derived || pos != snap->derived_end) {
+        snprintf(trusted_utils_msgstr, 512, "Snapshot has inconsistent derived clauses");
+        return false;
     }
     return true;
 }
 
-bool lrat_check_validate_unsat(void) {
-    if (!done_loading) {
+bool lrat_check_validate_unsat(struct lrat_check* lc) {
+    if (!lc->done_loading) {
         snprintf(trusted_utils_msgstr, 512, "UNSAT validation illegal - loading formula was not concluded");
         return false;
     }
-    if (!unsat_proven) {
+    if (!lc->unsat_proven) {
         snprintf(trusted_utils_msgstr, 512, "UNSAT validation unsuccessful - did not derive or import empty clause");
         return false;
     }
     return true;
 }
 
-bool lrat_check_validate_sat(int* model, u64 size) {
+int compare_ints(const void* left, const void* right) {
+    const int l = *(const int*) left, r = *(const int*) right;
+    return l < r ? -1 : (l > r ? 1 : 0);
+}
+
+bool lrat_check_validate_unsat_assuming(struct lrat_check* lc, const int* assumptions, int nb_assumptions, u64 id) {
+    if (!lc->done_loading) {
+        snprintf(trusted_utils_msgstr, 512, "UNSAT validation illegal - loading formula was not concluded");
+        return false;
+    }
+    if (lc->unsat_proven) return true;
+    const int* cls = find_clause(lc, id);
+    if (!cls) {
+        snprintf(trusted_utils_msgstr, 512, "UNSAT validation under assumptions: clause %lu not found", id);
+        return false;
+    }
+    // Each literal of the clause must be the negation of an assumption
+    int* sorted = trusted_utils_malloc((nb_assumptions+1) * sizeof(int));
+    memcpy(sorted, assumptions, nb_assumptions * sizeof(int));
+    qsort(sorted, nb_assumptions, sizeof(int), compare_ints);
+    bool ok = true;
+    for (int i = 0; ok && cls[i] != 0; i++) {
+        const int negated = -cls[i];
+        ok = bsearch(&negated, sorted, nb_assumptions, sizeof(int), compare_ints) != 0;
+        if (!ok) snprintf(trusted_utils_msgstr, 512, "UNSAT validation under assumptions: "
+            "literal %i of clause %lu does not negate an assumption", cls[i], id);
+    }
+    free(sorted);
+    return ok;
+}
+
+// Check that an original problem clause is satisfied by the model, which
+// is completed with the clause's literals where it leaves variables open.
+bool clause_satisfied_by_model(u64 id, const int* cls, int* model, u64 size) {
+    // Iterate over the literals of the clause
+    for (int lit_idx = 0; cls[lit_idx] != 0; lit_idx++) {
+        const int lit = cls[lit_idx];
+        const int var = lit>0 ? lit : -lit;
+        if (MALLOB_UNLIKELY((u64) (var-1) >= size)) {
+            // ERROR - model does not cover this variable
+            snprintf(trusted_utils_msgstr, 512, "SAT validation: model does not cover variable %i", var);
+            return false;
+        }
+        // Is the literal satisfied in the model?
+        int modelLit = model[var-1];
+        if (MALLOB_UNLIKELY(modelLit != var && modelLit != -var && modelLit != 0)) {
+            // ERROR - clause not found
+            snprintf(trusted_utils_msgstr, 512, "SAT validation: unexpected literal %i in assignment of variable %i", modelLit, var);
+            return false;
+        }
+        if (modelLit == 0) {
+            // The value of this variable allegedly does not matter,
+            // so let us just assign the fitting value.
+            // If this leads to an error, it does matter, which means that the specified model is wrong.
+            modelLit = model[var-1] = lit;
+        }
+        if (modelLit == lit) {
+            // Literal satisfied under the model satisfies the clause
+            return true;
+        }
+    }
+    // ERROR - unsatisfied clause(s) remain(s)
+    snprintf(trusted_utils_msgstr, 512, "SAT validation: original clause %lu not satisfied", id);
+    return false;
+}
+
+bool lrat_check_validate_sat(struct lrat_check* lc, int* model, u64 size) {
 
     // Still loading the formula?
-    if (!done_loading) {
+    if (!lc->done_loading) {
         snprintf(trusted_utils_msgstr, 512, "SAT validation illegal - loading formula was not concluded");
         return false;
     }
     // Not executed with checking of models enabled?
-    if (!check_model) {
+    if (!lc->check_model) {
         snprintf(trusted_utils_msgstr, 512, "SAT validation illegal - not executed to explicitly support this");
         return false;
     }
     // Check each original problem clause
-    for (u64 id = 1; id <= nb_loaded_clauses; id++) {
-        const int* cls = (int*) hash_table_find(clause_table, id);
+    for (u64 id = 1; id <= lc->nb_loaded_clauses; id++) {
+        const int* cls = formula_store_find(lc->formula, id);
         if (MALLOB_UNLIKELY(!cls)) {
             // ERROR - clause not found
             snprintf(trusted_utils_msgstr, 512, "SAT validation: original ID %lu not found", id);
             return false;
         }
-        // Iterate over the literals of the clause
-        bool satisfied = false;
-        for (int lit_idx = 0; cls[lit_idx] != 0; lit_idx++) {
-            const int lit = cls[lit_idx];
-            const int var = lit>0 ? lit : -lit;
-            if (MALLOB_UNLIKELY((u64) (var-1) >= size)) {
-                // ERROR - model does not cover this variable
-                snprintf(trusted_utils_msgstr, 512, "SAT validation: model does not cover variable %i", var);
-                return false;
-            }
-            // Is the literal satisfied in the model?
-            int modelLit = model[var-1];
-            if (MALLOB_UNLIKELY(modelLit != var && modelLit != -var && modelLit != 0)) {
-                // ERROR - clause not found
-                snprintf(trusted_utils_msgstr, 512, "SAT validation: unexpected literal %i in assignment of variable %i", modelLit, var);
-                return false;
-            }
-            if (modelLit == 0) {
-                // The value of this variable allegedly does not matter,
-                // so let us just assign the fitting value.
-                // If this leads to an error, it does matter, which means that the specified model is wrong.
-                modelLit = model[var-1] = lit;
-            }
-            if (modelLit == lit) {
-                // Literal satisfied under the model satisfies the clause
-                satisfied = true;
-                break;
-            }
-        }
-        // Clause NOT satisfied?
-        if (MALLOB_UNLIKELY(!satisfied)) {
-            // ERROR - unsatisfied clause(s) remain(s)
-            snprintf(trusted_utils_msgstr, 512, "SAT validation: original clause %lu not satisfied", id);
+        if (MALLOB_UNLIKELY(!clause_satisfied_by_model(id, cls, model, size))) return false;
+    }
+    // Check each original clause added after loading
+    for (u64 i = 0; i < lc->clause_table->capacity; i++) {
+        const struct hash_table_entry* entry = &lc->clause_table->data[i];
+        if (entry->key == 0 || !((uintptr_t) entry->val & ORIGINAL_TAG)) continue;
+        if (MALLOB_UNLIKELY(!clause_satisfied_by_model(entry->key, untag_clause(entry->val), model, size)))
             return false;
-        }
     }
     // All original problem clauses are satisfied – correct model!
     return true;
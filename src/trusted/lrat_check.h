@@ -2,13 +2,44 @@
 #pragma once
 
 #include <stdbool.h>        // for bool
+#include "snapshot.h"       // for snapshot_writer, snapshot_header, snapshot
 #include "trusted_utils.h"  // for u64, u8
 
-void lrat_check_init(int nb_vars, bool opt_check_model, bool opt_lenient);
-bool lrat_check_load(int lit);
-bool lrat_check_end_load(u8** out_sig);
-bool lrat_check_add_axiomatic_clause(u64 id, const int* lits, int nb_lits);
-bool lrat_check_add_clause(u64 id, const int* lits, int nb_lits, const u64* hints, int nb_hints);
-bool lrat_check_delete_clause(const u64* ids, int nb_ids);
-bool lrat_check_validate_unsat();
-bool lrat_check_validate_sat(int* model, u64 size);
+// An LRAT checker. Independent checkers can be used concurrently, each by
+// a single thread at a time. Upon an error, each function returns false and
+// sets trusted_utils_msgstr (of the calling thread).
+struct lrat_check;
+
+// With opt_process_stats, the checker reports to the process-wide statistics
+// (see stats.h), which must then not be used by any other thread.
+struct lrat_check* lrat_check_init(int nb_vars, bool opt_check_model, bool opt_lenient, bool opt_process_stats);
+// Release the checker and all clauses it holds.
+void lrat_check_free(struct lrat_check* lc);
+// Check derivations without hints by unit propagation from now on.
+void lrat_check_use_rup_fallback(struct lrat_check* lc);
+bool lrat_check_load(struct lrat_check* lc, const int* lits, int nb_lits);
+bool lrat_check_load_image(struct lrat_check* lc, const char* path, int nb_vars);
+bool lrat_check_end_load(struct lrat_check* lc, u8** out_sig);
+bool lrat_check_add_axiomatic_clause(struct lrat_check* lc, u64 id, const int* lits, int nb_lits);
+// Add original clauses after loading, with consecutive IDs from first_id on.
+// Each clause is terminated by a zero.
+bool lrat_check_add_increment(struct lrat_check* lc, u64 first_id, const int* lits, int nb_lits);
+bool lrat_check_add_clause(struct lrat_check* lc, u64 id, const int* lits, int nb_lits, const u64* hints, int nb_hints);
+// Whether a live clause with this ID is present (i.e., usable as a hint).
+bool lrat_check_has_clause(struct lrat_check* lc, u64 id);
+bool lrat_check_delete_clause(struct lrat_check* lc, const u64* ids, int nb_ids);
+// Delete the clauses first_id, first_id+stride, ..., first_id+(nb_ids-1)*stride.
+bool lrat_check_delete_range(struct lrat_check* lc, u64 first_id, u64 nb_ids, u64 stride);
+// Delete each clause base_id + 64*i + j for which bit j of words[i] is set.
+bool lrat_check_delete_bitmap(struct lrat_check* lc, u64 base_id, const u64* words, int nb_words);
+// Fill in the state-dependent fields of the header and write the header
+// and the checker's state. Only legal once loading has been concluded.
+bool lrat_check_write_snapshot(struct lrat_check* lc, struct snapshot_writer* w, struct snapshot_header* h);
+// Replace the (freshly initialized) checker's state with a snapshot's.
+bool lrat_check_restore(struct lrat_check* lc, const struct snapshot* snap);
+bool lrat_check_validate_unsat(struct lrat_check* lc);
+// Validate that the formula is unsatisfiable under the given assumptions:
+// clause id consists of negated assumptions only (or the empty clause has
+// been derived).
+bool lrat_check_validate_unsat_assuming(struct lrat_check* lc, const int* assumptions, int nb_assumptions, u64 id);
+bool lrat_check_validate_sat(struct lrat_check* lc, int* model, u64 size);
@@ -0,0 +1,376 @@
+
+#include "lrat_offline.h"
+#include <fcntl.h>           // for open, O_RDONLY
+#include <stdio.h>           // for snprintf, remove
+#include <stdlib.h>          // for getenv, mkstemp
+#include <sys/mman.h>        // for mmap, munmap, madvise
+#include <sys/stat.h>        // for fstat
+#include <time.h>            // for clock_gettime, CLOCK_MONOTONIC
+#include <unistd.h>          // for close
+#include "stats.h"           // for stats_memory_record
+#include "top_check.h"       // for top_check_produce, top_check_delete, ...
+#include "trusted_parser.h"  // for tp_ctx_init, tp_ctx_parse, tp_ctx_end
+#include "trusted_utils.h"   // for trusted_utils_msgstr, u64, MALLOB_UNLIKELY
+
+// Instantiate int_vec
+#define TYPE int
+#define TYPED(THING) int_ ## THING
+#include "vec.h"
+#undef TYPED
+#undef TYPE
+
+// Instantiate u64_vec
+#define TYPE u64
+#define TYPED(THING) u64_ ## THING
+#include "vec.h"
+#undef TYPED
+#undef TYPE
+
+enum proof_step {STEP_ADD, STEP_DELETE, STEP_END, STEP_ERROR};
+
+struct proof_reader {
+    const u8* begin;
+    const u8* pos;
+    const u8* end;
+    bool binary;
+    int nb_vars;
+    // the current step
+    u64 id;
+    struct int_vec* lits;
+    struct u64_vec* hints; // also holds the IDs of a deletion
+    // statistics
+    u64 nb_additions;
+    u64 nb_checked;
+    u64 nb_deletions;
+    u64 nb_hints;
+};
+
+// Index of all clause additions for backward marking. The IDs of the
+// additions must be increasing so that they can be found by binary search.
+struct proof_index {
+    u64* ids;
+    u64* positions; // in bytes, relative to the beginning of the proof
+    u64 size;
+    u64 capacity;
+    u64* marked; // bitmap over the additions (by index)
+};
+
+double now_secs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 0.000000001 * ts.tv_nsec;
+}
+
+enum proof_step proof_error(struct proof_reader* r, const char* msg) {
+    snprintf(trusted_utils_msgstr, 512, "LRAT proof, byte %lu: %s", (u64) (r->pos - r->begin), msg);
+    return STEP_ERROR;
+}
+
+bool push_lit(struct proof_reader* r, long lit) {
+    const long var = lit > 0 ? lit : -lit;
+    if (MALLOB_UNLIKELY(var > r->nb_vars)) return false;
+    int_vec_push(r->lits, (int) lit);
+    return true;
+}
+
+// Textual LRAT: "<id> <lits> 0 <hints> 0" or "<id> d <ids> 0", one per line.
+
+void skip_blanks(struct proof_reader* r) {
+    while (r->pos < r->end && (*r->pos == ' ' || *r->pos == '\t' || *r->pos == '\r')) r->pos++;
+}
+
+// Read a (possibly negative) number; returns false if there is none.
+bool read_text_num(struct proof_reader* r, long* out) {
+    skip_blanks(r);
+    const bool neg = r->pos < r->end && *r->pos == '-';
+    if (neg) r->pos++;
+    const u8* begin = r->pos;
+    u64 num = 0;
+    while (r->pos < r->end && *r->pos >= '0' && *r->pos <= '9' && r->pos - begin < 19) {
+        num = 10*num + (*r->pos - '0');
+        r->pos++;
+    }
+    if (r->pos == begin || (r->pos < r->end && *r->pos >= '0' && *r->pos <= '9')) return false;
+    *out = neg ? -(long) num : (long) num;
+    return true;
+}
+
+enum proof_step next_text_step(struct proof_reader* r) {
+    long num;
+    while (true) {
+        while (r->pos < r->end && (*r->pos == '\n' || *r->pos == ' ' || *r->pos == '\t' || *r->pos == '\r'))
+            r->pos++;
+        if (r->pos == r->end) return STEP_END;
+        if (*r->pos != 'c') break;
+        // comment line
+        while (r->pos < r->end && *r->pos != '\n') r->pos++;
+    }
+    if (!read_text_num(r, &num) || num <= 0) return proof_error(r, "expected clause ID");
+    r->id = num;
+    skip_blanks(r);
+    u64_vec_clear(r->hints);
+    if (r->pos < r->end && *r->pos == 'd') {
+        r->pos++;
+        while (true) {
+            if (!read_text_num(r, &num) || num < 0) return proof_error(r, "expected clause ID");
+            if (num == 0) return STEP_DELETE;
+            u64_vec_push(r->hints, num);
+        }
+    }
+    int_vec_clear(r->lits);
+    while (true) {
+        if (!read_text_num(r, &num)) return proof_error(r, "expected literal");
+        if (num == 0) break;
+        if (!push_lit(r, num)) return proof_error(r, "literal out of range");
+    }
+    while (true) {
+        if (!read_text_num(r, &num)) return proof_error(r, "expected hint");
+        if (num == 0) return STEP_ADD;
+        if (num < 0) return proof_error(r, "RAT hints are not supported");
+        u64_vec_push(r->hints, num);
+    }
+}
+
+// Binary LRAT: 'a' <id> <lits> 0 <hints> 0 or 'd' <ids> 0, where each number
+// x is mapped to 2x (x >= 0) or -2x+1 (x < 0) and written as a variable-length
+// integer with seven bits per byte, least significant bits first.
+
+bool read_binary_num(struct proof_reader* r, long* out) {
+    u64 mapped = 0;
+    for (int shift = 0; ; shift += 7) {
+        if (MALLOB_UNLIKELY(r->pos == r->end || shift > 62)) return false;
+        const u8 byte = *(r->pos++);
+        mapped |= ((u64) (byte & 0x7f)) << shift;
+        if (!(byte & 0x80)) break;
+    }
+    *out = (mapped & 1) ? -(long) (mapped >> 1) : (long) (mapped >> 1);
+    return true;
+}
+
+enum proof_step next_binary_step(struct proof_reader* r) {
+    long num;
+    if (r->pos == r->end) return STEP_END;
+    const u8 c = *(r->pos++);
+    u64_vec_clear(r->hints);
+    if (c == 'd') {
+        while (true) {
+            if (!read_binary_num(r, &num) || num < 0) return proof_error(r, "expected clause ID");
+            if (num == 0) return STEP_DELETE;
+            u64_vec_push(r->hints, num);
+        }
+    }
+    if (c != 'a') return proof_error(r, "expected 'a' or 'd'");
+    if (!read_binary_num(r, &num) || num <= 0) return proof_error(r, "expected clause ID");
+    r->id = num;
+    int_vec_clear(r->lits);
+    while (true) {
+        if (!read_binary_num(r, &num)) return proof_error(r, "expected literal");
+        if (num == 0) break;
+        if (!push_lit(r, num)) return proof_error(r, "literal out of range");
+    }
+    while (true) {
+        if (!read_binary_num(r, &num)) return proof_error(r, "expected hint");
+        if (num == 0) return STEP_ADD;
+        if (num < 0) return proof_error(r, "RAT hints are not supported");
+        u64_vec_push(r->hints, num);
+    }
+}
+
+enum proof_step next_step(struct proof_reader* r) {
+    return r->binary ? next_binary_step(r) : next_text_step(r);
+}
+
+// Index of the addition with the given ID, or -1 if there is none.
+long find_addition(const struct proof_index* idx, u64 id) {
+    u64 low = 0, high = idx->size;
+    while (low < high) {
+        const u64 mid = low + (high - low) / 2;
+        if (idx->ids[mid] < id) low = mid+1;
+        else high = mid;
+    }
+    return low < idx->size && idx->ids[low] == id ? (long) low : -1;
+}
+
+bool is_marked(const struct proof_index* idx, u64 i) {
+    return (idx->marked[i / 64] >> (i % 64)) & 1;
+}
+void mark(struct proof_index* idx, u64 i) {
+    idx->marked[i / 64] |= 1UL << (i % 64);
+}
+
+// Backward pass: index all additions up to the first empty clause, then go
+// through them in reverse order and mark each clause which is (transitively)
+// required as a hint for the empty clause. Returns false if the proof is
+// malformed or if backward marking is not applicable to it.
+bool mark_required(struct proof_reader* r, struct proof_index* idx, bool hintless_allowed,
+    bool* applicable) {
+    *applicable = true;
+    idx->capacity = 1 << 16;
+    idx->ids = trusted_utils_malloc(idx->capacity * sizeof(u64));
+    idx->positions = trusted_utils_malloc(idx->capacity * sizeof(u64));
+    bool found_empty = false;
+    while (!found_empty) {
+        const u64 position = r->pos - r->begin;
+        const enum proof_step step = next_step(r);
+        if (step == STEP_ERROR) return false;
+        if (step == STEP_END) break;
+        if (step != STEP_ADD) continue;
+        if ((idx->size > 0 && r->id <= idx->ids[idx->size-1])
+            || (hintless_allowed && r->hints->size == 0)) {
+            *applicable = false;
+            return true;
+        }
+        if (idx->size == idx->capacity) {
+            idx->capacity *= 2;
+            idx->ids = trusted_utils_realloc(idx->ids, idx->capacity * sizeof(u64));
+            idx->positions = trusted_utils_realloc(idx->positions, idx->capacity * sizeof(u64));
+        }
+        idx->ids[idx->size] = r->id;
+        idx->positions[idx->size] = position;
+        idx->size++;
+        found_empty = r->lits->size == 0;
+    }
+    idx->marked = trusted_utils_calloc(idx->size / 64 + 1, sizeof(u64));
+    // Without any derived empty clause, nothing needs to be checked
+    // (unless the formula itself contains the empty clause, nothing is proven).
+    if (!found_empty) return true;
+    mark(idx, idx->size-1);
+    for (long i = idx->size-1; i >= 0; i--) {
+        if (!is_marked(idx, i)) continue;
+        r->pos = r->begin + idx->positions[i];
+        if (next_step(r) != STEP_ADD) return false;
+        for (u64 h = 0; h < r->hints->size; h++) {
+            const long hint_idx = find_addition(idx, r->hints->data[h]);
+            // IDs not found refer to original clauses (or to nothing at all,
+            // which the forward pass reports)
+            if (hint_idx >= 0) mark(idx, hint_idx);
+        }
+    }
+    return true;
+}
+
+// Forward pass: check (and store) each marked addition or, without an index,
+// each addition. Deletions of unmarked clauses are dropped.
+bool check_forward(struct proof_reader* r, struct proof_index* idx) {
+    u64 nb_seen = 0;
+    while (true) {
+        const enum proof_step step = next_step(r);
+        if (step == STEP_ERROR) return false;
+        if (step == STEP_END) return true;
+        if (step == STEP_DELETE) {
+            if (idx) {
+                u64 nb_kept = 0;
+                for (u64 i = 0; i < r->hints->size; i++) {
+                    const long add_idx = find_addition(idx, r->hints->data[i]);
+                    if (add_idx >= 0 && !is_marked(idx, add_idx)) continue;
+                    r->hints->data[nb_kept++] = r->hints->data[i];
+                }
+                r->hints->size = nb_kept;
+            }
+            r->nb_deletions += r->hints->size;
+            if (!top_check_delete(r->hints->data, r->hints->size)) return false;
+            continue;
+        }
+        r->nb_additions++;
+        if (idx) {
+            if (nb_seen == idx->size) return true; // beyond the first empty clause
+            if (!is_marked(idx, nb_seen++)) continue;
+        }
+        r->nb_checked++;
+        r->nb_hints += r->hints->size;
+        if (!top_check_produce(r->id, r->lits->data, r->lits->size,
+            r->hints->data, r->hints->size, 0)) return false;
+    }
+}
+
+// Parse the formula and load it into the checker via a temporary formula
+// image, which is removed again as soon as it has been mapped.
+bool load_formula(const char* cnf_path, const struct lrat_offline_options* opts, int* out_nb_vars) {
+    const char* tmp_dir = getenv("TMPDIR");
+    char image_path[1024];
+    snprintf(image_path, 1024, "%s/impcheck.XXXXXX", tmp_dir ? tmp_dir : "/tmp");
+    const int fd = mkstemp(image_path);
+    if (fd < 0) {
+        snprintf(trusted_utils_msgstr, 512, "Cannot create temporary formula image %.400s", image_path);
+        return false;
+    }
+    close(fd);
+
+    struct trusted_parser* tp = tp_ctx_init(cnf_path, 0);
+    if (opts->formula_cache) tp_ctx_use_cache(tp, opts->formula_cache);
+    tp_ctx_set_threads(tp, opts->parse_threads);
+    bool ok = tp_ctx_write_image(tp, image_path);
+    u8* sig;
+    ok = ok && tp_ctx_parse(tp, &sig);
+    if (ok) {
+        *out_nb_vars = tp_ctx_nb_vars(tp);
+        top_check_init(*out_nb_vars, false, opts->lenient);
+        top_check_commit_formula_sig(sig);
+    } else {
+        snprintf(trusted_utils_msgstr, 512, "Problem during parsing %s", cnf_path);
+    }
+    tp_ctx_end(tp);
+    ok = ok && top_check_load_image(image_path) && top_check_end_load();
+    remove(image_path);
+    return ok;
+}
+
+bool lrat_offline_check(const char* cnf_path, const char* proof_path,
+    const struct lrat_offline_options* opts, u8* out_sig) {
+
+    const double time_start = now_secs();
+    struct proof_reader r = {0};
+    if (!load_formula(cnf_path, opts, &r.nb_vars)) return false;
+    const double time_loaded = now_secs();
+
+    const int fd = open(proof_path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        snprintf(trusted_utils_msgstr, 512, "Cannot open LRAT proof %s", proof_path);
+        if (fd >= 0) close(fd);
+        return false;
+    }
+    const u64 size = st.st_size;
+    const u8* data = size == 0 ? 0 : mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        snprintf(trusted_utils_msgstr, 512, "Cannot map LRAT proof %s", proof_path);
+        return false;
+    }
+    if (size > 0) madvise((void*) data, size, MADV_SEQUENTIAL);
+    r.begin = r.pos = data;
+    r.end = data + size;
+    r.lits = int_vec_init(1 << 10);
+    r.hints = u64_vec_init(1 << 10);
+    // A textual proof begins with a clause ID or a comment, a binary one with 'a' or 'd'.
+    r.binary = size > 0 && (data[0] == 'a' || data[0] == 'd');
+
+    struct proof_index idx = {0};
+    bool use_index = opts->backward, ok = true;
+    if (use_index) {
+        ok = mark_required(&r, &idx, opts->rup_fallback, &use_index);
+        if (ok && !use_index) trusted_utils_log("Backward marking not applicable - checking all clauses");
+        r.pos = r.begin;
+    }
+    const double time_marked = now_secs();
+    ok = ok && check_forward(&r, use_index ? &idx : 0);
+    ok = ok && top_check_validate_unsat(out_sig);
+    const double time_end = now_secs();
+
+    char report[512];
+    snprintf(report, 512,
+        "%s proof: additions:%lu checked:%lu deletions:%lu hints:%lu load:%.3fs mark:%.3fs check:%.3fs %.1f MB/s %.0f additions/s",
+        r.binary ? "binary" : "text", r.nb_additions, r.nb_checked, r.nb_deletions, r.nb_hints,
+        time_loaded - time_start, time_marked - time_loaded, time_end - time_marked,
+        size / (1024.0*1024.0) / (time_end - time_loaded), r.nb_additions / (time_end - time_loaded));
+    trusted_utils_log(report);
+    stats_memory_record();
+
+    free(idx.ids);
+    free(idx.positions);
+    free(idx.marked);
+    int_vec_free(r.lits);
+    u64_vec_free(r.hints);
+    if (size > 0) munmap((void*) data, size);
+    return ok;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdbool.h>        // for bool
+#include "trusted_utils.h"  // for u8
+
+// Offline checking of an LRAT proof file against a DIMACS CNF file, without
+// any solver or directive protocol involved. The formula is parsed by the
+// trusted parser and loaded like a formula image; the proof is mapped into
+// memory and its additions and deletions are fed to the checker directly.
+// Both textual and binary LRAT are supported (detected automatically), but
+// no RAT steps (negative hints). The caller must have set up top_check
+// according to the options (see top_check_use_rup_fallback).
+
+struct lrat_offline_options {
+    const char* formula_cache; // may be null
+    int parse_threads;
+    bool lenient;
+    // Only check the clauses which the empty clause (transitively) depends
+    // on, found in a backward pass over the proof. Requires increasing IDs.
+    bool backward;
+    // Additions without hints are checked by unit propagation. Since their
+    // dependencies are unknown, backward marking is not applicable then.
+    bool rup_fallback;
+};
+
+// Returns true iff the proof is valid and derives the empty clause.
+// Writes the signature confirming unsatisfiability to out_sig.
+bool lrat_offline_check(const char* cnf_path, const char* proof_path,
+    const struct lrat_offline_options* opts, u8* out_sig);
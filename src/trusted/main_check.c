@@ -1,7 +1,12 @@
 
 #include <stdbool.h>          // for bool, false
 #include <stdio.h>            // for fflush, stdout
-#include "trusted_checker.h"  // for tc_init, tc_run
+#include <stdlib.h>           // for atof, atoi
+#include "lrat_offline.h"     // for lrat_offline_check
+#include "placement.h"        // for placement_apply, placement_report
+#include "stats.h"            // for stats_init, stats_memory_record
+#include "top_check.h"        // for top_check_use_rup_fallback
+#include "trusted_checker.h"  // for tc_init, tc_run, tc_restore
 #include "trusted_utils.h"    // for trusted_utils_try_match_arg, trusted_ut...
 #if IMPCHECK_WRITE_DIRECTIVES
 #include <unistd.h>
@@ -10,13 +15,92 @@
 
 int main(int argc, char *argv[]) {
 
-    const char *fifo_directives = "", *fifo_feedback = "";
-    bool check_model = false, lenient = false;
+    // Each occurrence of -fifo-directives / -fifo-feedback adds a stream.
+    const char* fifos_directives[argc];
+    const char* fifos_feedback[argc];
+    int nb_directives = 0, nb_feedback = 0;
+    const char* formula_image = 0;
+    const char* restore = 0;
+    const char *stats_file = 0, *stats_interval = "1";
+    const char *formula_input = 0, *lrat_proof = 0, *formula_cache = 0, *parse_threads = "1";
+    const char *cpus = 0, *mem_policy = 0;
+    bool check_model = false, lenient = false, stats = false, backward = false, rup_fallback = false;
+    bool overlap_load = false;
     for (int i = 1; i < argc; i++) {
+        const char *fifo_directives = 0, *fifo_feedback = 0;
         trusted_utils_try_match_arg(argv[i], "-fifo-directives=", &fifo_directives);
         trusted_utils_try_match_arg(argv[i], "-fifo-feedback=", &fifo_feedback);
+        if (fifo_directives) fifos_directives[nb_directives++] = fifo_directives;
+        if (fifo_feedback) fifos_feedback[nb_feedback++] = fifo_feedback;
+        trusted_utils_try_match_arg(argv[i], "-formula-image=", &formula_image);
+        trusted_utils_try_match_arg(argv[i], "-restore=", &restore);
         trusted_utils_try_match_flag(argv[i], "-check-model", &check_model);
         trusted_utils_try_match_flag(argv[i], "-lenient", &lenient);
+        trusted_utils_try_match_flag(argv[i], "-stats", &stats);
+        trusted_utils_try_match_arg(argv[i], "-stats-file=", &stats_file);
+        trusted_utils_try_match_arg(argv[i], "-stats-interval=", &stats_interval);
+        trusted_utils_try_match_arg(argv[i], "-formula-input=", &formula_input);
+        trusted_utils_try_match_arg(argv[i], "-lrat-proof=", &lrat_proof);
+        trusted_utils_try_match_arg(argv[i], "-formula-cache=", &formula_cache);
+        trusted_utils_try_match_arg(argv[i], "-parse-threads=", &parse_threads);
+        trusted_utils_try_match_flag(argv[i], "-backward", &backward);
+        trusted_utils_try_match_flag(argv[i], "-rup-fallback", &rup_fallback);
+        trusted_utils_try_match_flag(argv[i], "-overlap-load", &overlap_load);
+        trusted_utils_try_match_arg(argv[i], "-cpus=", &cpus);
+        trusted_utils_try_match_arg(argv[i], "-mem-policy=", &mem_policy);
+    }
+
+    // Place the process before it allocates its data structures
+    if (cpus || mem_policy) {
+        if (!placement_apply(cpus, mem_policy)) {
+            trusted_utils_log_err(trusted_utils_msgstr);
+            return 1;
+        }
+        placement_report();
+    }
+
+    // Log what the memory was used for if we run out of it
+    trusted_utils_oom_hook = stats_memory_record;
+    if (rup_fallback) top_check_use_rup_fallback();
+
+    if (lrat_proof) {
+        // Offline mode: check an LRAT proof file instead of serving directives
+        if (!formula_input) {
+            trusted_utils_log_err("Need -formula-input together with -lrat-proof");
+            return 1;
+        }
+        struct lrat_offline_options opts;
+        opts.formula_cache = formula_cache;
+        opts.parse_threads = atoi(parse_threads);
+        opts.lenient = lenient;
+        opts.backward = backward;
+        opts.rup_fallback = rup_fallback;
+        signature sig;
+        if (!lrat_offline_check(formula_input, lrat_proof, &opts, sig)) {
+            trusted_utils_log_err(trusted_utils_msgstr);
+            printf("s NOT VERIFIED\n");
+            return 1;
+        }
+        char sig_str[2*SIG_SIZE_BYTES+1];
+        trusted_utils_sig_to_str(sig, sig_str);
+        printf("s VERIFIED UNSATISFIABLE\nv %s\n", sig_str);
+        fflush(stdout);
+        return 0;
+    }
+
+    if (nb_directives == 0 || nb_directives != nb_feedback) {
+        trusted_utils_log_err("Need matching pairs of -fifo-directives and -fifo-feedback");
+        return 1;
+    }
+    if (overlap_load && nb_directives > 1) {
+        // further streams would inherit the clauses of the first stream
+        trusted_utils_log_err("-overlap-load requires a single stream");
+        return 1;
+    }
+    if (restore && nb_directives > 1) {
+        // further streams would inherit the restored clauses of the first stream
+        trusted_utils_log_err("-restore requires a single stream");
+        return 1;
     }
 
 #if IMPCHECK_WRITE_DIRECTIVES
@@ -25,7 +109,15 @@ int main(int argc, char *argv[]) {
     writer_init(output_path);
 #endif
 
-    tc_init(fifo_directives, fifo_feedback);
+    if (stats || stats_file) stats_init(stats_file, atof(stats_interval));
+    if (restore && !tc_restore(restore)) {
+        trusted_utils_log_err(trusted_utils_msgstr);
+        return 1;
+    }
+    tc_init(fifos_directives[0], fifos_feedback[0]);
+    if (overlap_load) tc_overlap_load();
+    if (formula_image) tc_use_formula_image(formula_image);
+    tc_add_streams(nb_directives-1, fifos_directives+1, fifos_feedback+1);
     int res = tc_run(check_model, lenient);
     tc_end();
     fflush(stdout);
@@ -1,12 +1,11 @@
 
 #include <stdbool.h>         // for bool
-#include <stdio.h>           // for fopen, FILE
-#include <stdlib.h>          // for abort
-#include <string.h>
+#include <stdio.h>           // for printf
+#include <stdlib.h>          // for atoi, strtol
+#include <string.h>          // for strlen
 
-#include "trusted_parser.h"  // for tp_init, tp_parse
-#include "trusted_utils.h"   // for trusted_utils_begins_with
-#include "confirm.h"
+#include "confirm_batch.h"   // for confirm_incremental_entry, confirm_batch, ...
+#include "trusted_utils.h"   // for trusted_utils_try_match_arg
 
 int error(void) {
     printf("s NOT VERIFIED\n");
@@ -16,54 +15,58 @@ int error(void) {
 int main(int argc, char *argv[]) {
 
     const char *formula_input = "", *result_sig = "", *resultint_str = "";
+    const char *formula_cache = 0, *parse_threads = "1";
+    const char *batch = 0, *threads = "1";
+    // Each occurrence of -increment adds an increment, in order.
+    const char* increments[argc];
+    int nb_increments = 0;
+    const char* assumptions_str = 0;
     for (int i = 0; i < argc; i++) {
+        const char* increment = 0;
+        trusted_utils_try_match_arg(argv[i], "-increment=", &increment);
+        if (increment) increments[nb_increments++] = increment;
+        trusted_utils_try_match_arg(argv[i], "-assumptions=", &assumptions_str);
         trusted_utils_try_match_arg(argv[i], "-formula-input=", &formula_input);
         trusted_utils_try_match_arg(argv[i], "-result-sig=", &result_sig);
         trusted_utils_try_match_arg(argv[i], "-result=", &resultint_str);
+        trusted_utils_try_match_arg(argv[i], "-formula-cache=", &formula_cache);
+        trusted_utils_try_match_arg(argv[i], "-parse-threads=", &parse_threads);
+        trusted_utils_try_match_arg(argv[i], "-batch=", &batch);
+        trusted_utils_try_match_arg(argv[i], "-threads=", &threads);
     }
+    struct confirm_options opts;
+    opts.formula_cache = formula_cache;
+    opts.parse_threads = atoi(parse_threads);
 
-    // valid input?
-    int result = atoi(resultint_str);
-    if (result != 10 && result != 20) {
-        trusted_utils_log_err("Result code missing or invalid");
-        return error();
-    }
-    if (strnlen(result_sig, 2*SIG_SIZE_BYTES+1) != 2*SIG_SIZE_BYTES) {
-        trusted_utils_log_err("Result signature missing or malformed");
-        return error();
-    }
+    // Batch mode: confirm all entries of a manifest
+    if (batch) return confirm_batch(batch, atoi(threads), &opts) ? 0 : 1;
 
-    // Parse formula to get its signature
-    FILE* source = fopen("/dev/null", "w"); // write formula to /dev/null
-    tp_init(formula_input, source);
-    u8* sig_formula;
-    bool ok = tp_parse((u8**) &sig_formula);
-    if (!ok) {
-        trusted_utils_log_err("Problem during parsing");
-        return error();
+    // Comma-separated assumption literals
+    int assumptions[assumptions_str ? strlen(assumptions_str)/2+1 : 1];
+    int nb_assumptions = 0;
+    for (const char* pos = assumptions_str; pos && *pos != '\0'; ) {
+        char* end;
+        assumptions[nb_assumptions++] = strtol(pos, &end, 10);
+        if (end == pos || (*end != ',' && *end != '\0')) {
+            trusted_utils_log_err("Malformed assumptions");
+            return error();
+        }
+        pos = *end == ',' ? end+1 : end;
     }
 
-    // convert the reported signature from hex string to raw data
-    signature sig_res_reported;
-    ok = trusted_utils_str_to_sig(result_sig, sig_res_reported);
-    if (!ok) {
-        trusted_utils_log_err("Invalid signature string");
-        return error();
-    }
-
-    // re-compute result signature
-    signature sig_res_computed;
-    confirm_result(sig_formula, (u8) result, sig_res_computed);
-
-    // check reported signature against computed signature
-    if (!trusted_utils_equal_signatures(sig_res_computed, sig_res_reported)) {
-        trusted_utils_log_err("Signature does not match!");
+    int result = atoi(resultint_str);
+    const char* err = confirm_incremental_entry(formula_input, increments, nb_increments,
+        assumptions_str ? assumptions : 0, nb_assumptions, result, result_sig, &opts);
+    if (err) {
+        trusted_utils_log_err(err);
         return error();
     }
 
     if (result == 10)
         printf("s VERIFIED SATISFIABLE\n");
-    if (result == 20)
+    if (result == 20 && assumptions_str)
+        printf("s VERIFIED UNSATISFIABLE UNDER ASSUMPTIONS\n");
+    else if (result == 20)
         printf("s VERIFIED UNSATISFIABLE\n");
     return 0;
 }
@@ -7,15 +7,30 @@
 
 int main(int argc, char *argv[]) {
 
-    const char *formula_input = "", *fifo_parsed_formula = "";
+    // Each occurrence of -fifo-parsed-formula adds an output.
+    const char* fifos_parsed_formula[argc];
+    int nb_outputs = 0;
+    const char *formula_input = "", *formula_image = 0;
+    const char *formula_cache = 0, *parse_threads = "1";
     for (int i = 0; i < argc; i++) {
+        const char* fifo_parsed_formula = 0;
         trusted_utils_try_match_arg(argv[i], "-formula-input=", &formula_input);
         trusted_utils_try_match_arg(argv[i], "-fifo-parsed-formula=", &fifo_parsed_formula);
+        if (fifo_parsed_formula) fifos_parsed_formula[nb_outputs++] = fifo_parsed_formula;
+        trusted_utils_try_match_arg(argv[i], "-formula-image=", &formula_image);
+        trusted_utils_try_match_arg(argv[i], "-formula-cache=", &formula_cache);
+        trusted_utils_try_match_arg(argv[i], "-parse-threads=", &parse_threads);
     }
 
     // Parse
-    FILE* source = fopen(fifo_parsed_formula, "w");
+    // A single output is written directly, several outputs concurrently.
+    FILE* source = nb_outputs == 1 ? fopen(fifos_parsed_formula[0], "w") : 0;
+    if (nb_outputs == 1 && !source) abort();
     tp_init(formula_input, source);
+    if (nb_outputs > 1) tp_broadcast(fifos_parsed_formula, nb_outputs);
+    if (formula_image && !tp_write_image(formula_image)) abort();
+    if (formula_cache) tp_use_cache(formula_cache);
+    tp_set_threads(atoi(parse_threads));
     u8* sig;
     bool ok = tp_parse(&sig);
     if (!ok) abort();
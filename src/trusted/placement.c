@@ -0,0 +1,161 @@
+
+#define _GNU_SOURCE // for sched_setaffinity, CPU_SET, syscall
+
+#include "placement.h"
+#include <linux/mempolicy.h>  // for MPOL_BIND, MPOL_DEFAULT, MPOL_LOCAL, ...
+#include <sched.h>            // for sched_setaffinity, cpu_set_t, CPU_SET
+#include <stdio.h>            // for fopen, fgets, snprintf
+#include <stdlib.h>           // for strtol
+#include <string.h>           // for memset, strcmp, strcspn
+#include <sys/syscall.h>      // for SYS_set_mempolicy, SYS_get_mempolicy, ...
+#include <unistd.h>           // for syscall
+#include "trusted_utils.h"    // for u64, trusted_utils_msgstr, trusted_utils_log
+
+// Bit masks of CPUs and nodes, in the layout the kernel expects.
+#define PLACEMENT_MAX_IDS 1024
+#define PLACEMENT_NB_WORDS (PLACEMENT_MAX_IDS / 64)
+
+bool parse_id_list(const char* str, u64* mask) {
+    memset(mask, 0, PLACEMENT_NB_WORDS * sizeof(u64));
+    const char* pos = str;
+    while (*pos != '\0' && *pos != '\n') {
+        char* end;
+        const long first = strtol(pos, &end, 10);
+        long last = first;
+        if (end == pos) return false;
+        if (*end == '-') {
+            pos = end+1;
+            last = strtol(pos, &end, 10);
+            if (end == pos) return false;
+        }
+        if (first < 0 || last < first || last >= PLACEMENT_MAX_IDS) return false;
+        for (long id = first; id <= last; id++) mask[id / 64] |= 1UL << (id % 64);
+        if (*end == ',') end++;
+        else if (*end != '\0' && *end != '\n') return false;
+        pos = end;
+    }
+    return true;
+}
+
+void format_id_list(const u64* mask, char* out, int out_size) {
+    int len = 0;
+    out[0] = '\0';
+    for (int id = 0; id < PLACEMENT_MAX_IDS && len < out_size; id++) {
+        if (!(mask[id / 64] & (1UL << (id % 64)))) continue;
+        int last = id;
+        while (last+1 < PLACEMENT_MAX_IDS && (mask[(last+1) / 64] & (1UL << ((last+1) % 64)))) last++;
+        if (last == id) len += snprintf(out+len, out_size-len, "%s%i", len > 0 ? "," : "", id);
+        else len += snprintf(out+len, out_size-len, "%s%i-%i", len > 0 ? "," : "", id, last);
+        id = last;
+    }
+}
+
+bool read_id_list(const char* path, u64* mask) {
+    FILE* f = fopen(path, "r");
+    if (!f) return false;
+    char buf[4096];
+    const bool ok = fgets(buf, 4096, f) && parse_id_list(buf, mask);
+    fclose(f);
+    return ok;
+}
+
+bool get_cpus(u64* mask) {
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set) != 0) return false;
+    memset(mask, 0, PLACEMENT_NB_WORDS * sizeof(u64));
+    for (int cpu = 0; cpu < PLACEMENT_MAX_IDS && cpu < CPU_SETSIZE; cpu++)
+        if (CPU_ISSET(cpu, &set)) mask[cpu / 64] |= 1UL << (cpu % 64);
+    return true;
+}
+
+// The nodes which have any of the given CPUs.
+bool get_nodes_of_cpus(const u64* cpus, u64* nodes) {
+    u64 online[PLACEMENT_NB_WORDS], node_cpus[PLACEMENT_NB_WORDS];
+    if (!read_id_list("/sys/devices/system/node/online", online)) return false;
+    memset(nodes, 0, PLACEMENT_NB_WORDS * sizeof(u64));
+    for (int node = 0; node < PLACEMENT_MAX_IDS; node++) {
+        if (!(online[node / 64] & (1UL << (node % 64)))) continue;
+        char path[128];
+        snprintf(path, 128, "/sys/devices/system/node/node%i/cpulist", node);
+        if (!read_id_list(path, node_cpus)) return false;
+        for (int w = 0; w < PLACEMENT_NB_WORDS; w++) {
+            if (node_cpus[w] & cpus[w]) nodes[node / 64] |= 1UL << (node % 64);
+        }
+    }
+    return true;
+}
+
+bool set_cpus(const char* cpus) {
+    u64 mask[PLACEMENT_NB_WORDS];
+    if (!parse_id_list(cpus, mask)) {
+        snprintf(trusted_utils_msgstr, 512, "Malformed CPU list \"%.400s\"", cpus);
+        return false;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu = 0; cpu < PLACEMENT_MAX_IDS && cpu < CPU_SETSIZE; cpu++)
+        if (mask[cpu / 64] & (1UL << (cpu % 64))) CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+        snprintf(trusted_utils_msgstr, 512, "Cannot pin process to CPUs %.400s", cpus);
+        return false;
+    }
+    return true;
+}
+
+bool set_mem_policy(const char* policy) {
+    if (!strcmp(policy, "first-touch")) {
+        if (syscall(SYS_set_mempolicy, MPOL_DEFAULT, 0, 0) != 0) {
+            snprintf(trusted_utils_msgstr, 512, "Cannot reset memory policy");
+            return false;
+        }
+        return true;
+    }
+    u64 nodes[PLACEMENT_NB_WORDS], cpus[PLACEMENT_NB_WORDS];
+    if (!strcmp(policy, "local")) {
+        if (!get_cpus(cpus) || !get_nodes_of_cpus(cpus, nodes)) {
+            snprintf(trusted_utils_msgstr, 512, "Cannot determine the NUMA nodes of this process' CPUs");
+            return false;
+        }
+    } else if (!parse_id_list(policy, nodes)) {
+        snprintf(trusted_utils_msgstr, 512, "Malformed memory policy \"%.400s\"", policy);
+        return false;
+    }
+    if (syscall(SYS_set_mempolicy, MPOL_BIND, nodes, PLACEMENT_MAX_IDS+1) != 0) {
+        snprintf(trusted_utils_msgstr, 512, "Cannot bind memory to NUMA nodes (policy \"%.400s\")", policy);
+        return false;
+    }
+    return true;
+}
+
+bool placement_apply(const char* cpus_or_null, const char* mem_policy_or_null) {
+    // Pin first so that "local" refers to the new CPU set
+    if (cpus_or_null && !set_cpus(cpus_or_null)) return false;
+    if (mem_policy_or_null && !set_mem_policy(mem_policy_or_null)) return false;
+    return true;
+}
+
+void placement_report(void) {
+    u64 mask[PLACEMENT_NB_WORDS];
+    char cpus_str[256] = "?", nodes_str[256] = "";
+    if (get_cpus(mask)) format_id_list(mask, cpus_str, 256);
+    int mode = -1;
+    const char* mode_str = "?";
+    if (syscall(SYS_get_mempolicy, &mode, mask, PLACEMENT_MAX_IDS+1, 0, 0) == 0) {
+        mode &= ~MPOL_MODE_FLAGS;
+        if (mode == MPOL_DEFAULT) mode_str = "first-touch";
+        else if (mode == MPOL_LOCAL) mode_str = "local";
+        else if (mode == MPOL_BIND) mode_str = "bind";
+        else if (mode == MPOL_PREFERRED) mode_str = "preferred";
+        else if (mode == MPOL_INTERLEAVE) mode_str = "interleave";
+        if (mode != MPOL_DEFAULT && mode != MPOL_LOCAL) {
+            nodes_str[0] = ':';
+            format_id_list(mask, nodes_str+1, 255);
+        }
+    }
+    unsigned int cpu = 0, node = 0;
+    const bool cur_ok = syscall(SYS_getcpu, &cpu, &node, 0) == 0;
+    char msg[1024];
+    if (cur_ok) snprintf(msg, 1024, "placement cpus=%s mem=%s%s cpu=%u node=%u", cpus_str, mode_str, nodes_str, cpu, node);
+    else snprintf(msg, 1024, "placement cpus=%s mem=%s%s", cpus_str, mode_str, nodes_str);
+    trusted_utils_log(msg);
+}
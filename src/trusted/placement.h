@@ -0,0 +1,21 @@
+
+#pragma once
+
+#include <stdbool.h>  // for bool
+
+// Placement of a checker process on the CPUs and NUMA nodes of a machine.
+// CPUs and nodes are given as lists of numbers and ranges, e.g., "0-7,16".
+
+// Pin the process to the given CPUs (if cpus_or_null is set) and then set
+// its memory policy (if mem_policy_or_null is set) to one of
+// - "first-touch": each page is allocated on the node of the CPU which
+//   first touches it (the system's default, overriding inherited policies),
+// - "local": allocations are bound to the nodes of the CPUs the process
+//   may run on, or
+// - a list of nodes to which allocations are bound.
+// Must be called before any larger allocation; forked processes inherit
+// the placement. Returns false and sets trusted_utils_msgstr upon an error.
+bool placement_apply(const char* cpus_or_null, const char* mem_policy_or_null);
+
+// Log the effective CPU set, memory policy, and the current CPU and node.
+void placement_report(void);
@@ -0,0 +1,20 @@
+#pragma once
+
+// Static tracepoints (USDT probes) on hot paths of the checker, for use with
+// perf, bpftrace, or SystemTap on running processes (provider "impcheck").
+// With -DIMPCHECK_PROBES=1 (requires <sys/sdt.h>, e.g., from systemtap-sdt-dev),
+// each probe compiles to a single nop instruction plus a note in the ELF file,
+// which costs nothing unless a tracer attaches to it. Otherwise the probes
+// are compiled out entirely.
+// Example: bpftrace -e 'usdt:build/impcheck_check:impcheck:check_end { ... }'
+
+#if IMPCHECK_PROBES
+#include <sys/sdt.h>
+#define IMPCHECK_PROBE1(name, a) DTRACE_PROBE1(impcheck, name, a)
+#define IMPCHECK_PROBE2(name, a, b) DTRACE_PROBE2(impcheck, name, a, b)
+#define IMPCHECK_PROBE3(name, a, b, c) DTRACE_PROBE3(impcheck, name, a, b, c)
+#else
+#define IMPCHECK_PROBE1(name, a) ((void) 0)
+#define IMPCHECK_PROBE2(name, a, b) ((void) 0)
+#define IMPCHECK_PROBE3(name, a, b, c) ((void) 0)
+#endif
@@ -1,7 +1,17 @@
 
 #include "secret.h"
+#include "siphash.h"        // for siphash_ctx_init, siphash_ctx_update, siphash_...
+#include "trusted_utils.h"  // for trusted_utils_copy_bytes
 
 const unsigned char SECRET_KEY[] = {
     86, 93, 1, 209, 112, 176, 13, 40,
     168, 223, 25, 22, 134, 58, 21, 211
 };
+
+void secret_derive_key(const char* purpose, unsigned char* out) {
+    struct siphash sh;
+    siphash_ctx_init(&sh, SECRET_KEY);
+    siphash_ctx_update(&sh, (const u8*) purpose, 8);
+    siphash_ctx_update(&sh, (const u8*) "KEY", 3);
+    trusted_utils_copy_bytes(out, siphash_ctx_digest(&sh), SIG_SIZE_BYTES);
+}
@@ -14,3 +14,19 @@
 // this data should instead be set dynamically for each solving attempt
 // following some secure key exchange procedure.
 extern const unsigned char SECRET_KEY[];
+
+// All data signed with SECRET_KEY belongs to one of the following domains,
+// which are kept apart by the length of the input modulo 4 and, where the
+// length alone does not suffice, by its final bytes:
+// - formula: its literals and two zero bytes (2 mod 4)
+// - clause: its ID, its literals, and the formula signature (0 mod 4)
+// - result: the formula signature and a one-byte result code (17 bytes)
+// - result under assumptions: the formula signature, the assumptions, the
+//   result code, and the tag "IMPASSUM" (1 mod 4, at least 25 bytes)
+// - increment: the formula signature, the increment's signature, and the
+//   tag "IMPINCRM" (40 bytes, ending in a tag instead of a formula signature)
+// - key derivation: an 8-character purpose tag and "KEY" (11 bytes)
+// Nothing else may be signed with SECRET_KEY. In particular, data which is
+// MAC'd or digested for storage uses a key derived for that purpose, so that
+// storing or revealing the result never reveals a signature.
+void secret_derive_key(const char* purpose, unsigned char* out);
@@ -46,31 +46,22 @@
         v2 = ROTL(v2, 32);                                                     \
     } while (0)
 
-const unsigned char* kk;
-u8* out;
-const int outlen = 128 / 8;
-u64 v0, v1, v2, v3;
-u64 k0, k1;
-u64 m;
-int i;
-u64 inlen;
-
-u8* buf;
-unsigned char buflen = 0;
-
-void process_next_block(void) {
-    m = U8TO64_LE(buf);
+void process_block(struct siphash* sh, const u8* block) {
+    u64 v0 = sh->v0, v1 = sh->v1, v2 = sh->v2, v3 = sh->v3;
+    const u64 m = U8TO64_LE(block);
     v3 ^= m;
-    for (i = 0; i < cROUNDS; ++i)
+    for (int i = 0; i < cROUNDS; ++i)
         SIPROUND;
     v0 ^= m;
+    sh->v0 = v0; sh->v1 = v1; sh->v2 = v2; sh->v3 = v3;
 }
 
-void process_final_block(void) {
-    const int left = inlen & 7;
-    assert(left == buflen);
-    u64 b = ((u64)inlen) << 56;
-    u8* ni = buf;
+void process_final_block(struct siphash* sh) {
+    u64 v0 = sh->v0, v1 = sh->v1, v2 = sh->v2, v3 = sh->v3;
+    const int left = sh->inlen & 7;
+    assert(left == sh->buflen);
+    u64 b = ((u64)sh->inlen) << 56;
+    const u8* ni = sh->buf;
 
     switch (left) {
     case 7:
@@ -100,78 +91,120 @@ void process_final_block(void) {
 
     v3 ^= b;
 
-    for (i = 0; i < cROUNDS; ++i)
+    for (int i = 0; i < cROUNDS; ++i)
         SIPROUND;
 
     v0 ^= b;
 
-    if (outlen == 16)
+    if (SIPHASH_OUTLEN == 16)
         v2 ^= 0xee;
     else
         v2 ^= 0xff;
 
-    for (i = 0; i < dROUNDS; ++i)
+    for (int i = 0; i < dROUNDS; ++i)
         SIPROUND;
 
     b = v0 ^ v1 ^ v2 ^ v3;
-    U64TO8_LE(out, b);
+    U64TO8_LE(sh->out, b);
 
     v1 ^= 0xdd;
 
-    for (i = 0; i < dROUNDS; ++i)
+    for (int i = 0; i < dROUNDS; ++i)
         SIPROUND;
 
     b = v0 ^ v1 ^ v2 ^ v3;
-    U64TO8_LE(out + 8, b);
+    U64TO8_LE(sh->out + 8, b);
+    sh->v0 = v0; sh->v1 = v1; sh->v2 = v2; sh->v3 = v3;
 }
 
-void siphash_init(const unsigned char* key_128bit) {
-    kk = key_128bit;
-    out = trusted_utils_malloc(128 / 8);
-    buf = trusted_utils_malloc(8);
-    if (kk) siphash_reset();
+void siphash_ctx_init(struct siphash* sh, const unsigned char* key_128bit) {
+    sh->key = key_128bit;
+    if (sh->key) siphash_ctx_reset(sh);
 }
-void siphash_reset(void) {
-    v0 = SH_UINT64_C(0x736f6d6570736575);
-    v1 = SH_UINT64_C(0x646f72616e646f6d);
-    v2 = SH_UINT64_C(0x6c7967656e657261);
-    v3 = SH_UINT64_C(0x7465646279746573);
-    k0 = U8TO64_LE(kk);
-    k1 = U8TO64_LE(kk + 8);
-    v3 ^= k1;
-    v2 ^= k0;
-    v1 ^= k1;
-    v0 ^= k0;
-    inlen = 0;
-    buflen = 0;
-    if (outlen == 16)
-        v1 ^= 0xee;
+void siphash_ctx_reset(struct siphash* sh) {
+    sh->v0 = SH_UINT64_C(0x736f6d6570736575);
+    sh->v1 = SH_UINT64_C(0x646f72616e646f6d);
+    sh->v2 = SH_UINT64_C(0x6c7967656e657261);
+    sh->v3 = SH_UINT64_C(0x7465646279746573);
+    const u64 k0 = U8TO64_LE(sh->key);
+    const u64 k1 = U8TO64_LE(sh->key + 8);
+    sh->v3 ^= k1;
+    sh->v2 ^= k0;
+    sh->v1 ^= k1;
+    sh->v0 ^= k0;
+    sh->inlen = 0;
+    sh->buflen = 0;
+    if (SIPHASH_OUTLEN == 16)
+        sh->v1 ^= 0xee;
 }
-void siphash_update(const unsigned char* data, u64 nb_bytes) {
-    u32 datapos = 0;
-    while (true) {
-        while (buflen < 8u && datapos < nb_bytes) {
-            buf[buflen++] = data[datapos++];
+void siphash_ctx_update(struct siphash* sh, const unsigned char* data, u64 nb_bytes) {
+    u64 datapos = 0;
+    // Complete a partially filled block from an earlier call
+    if (sh->buflen > 0) {
+        while (sh->buflen < 8u && datapos < nb_bytes) {
+            sh->buf[sh->buflen++] = data[datapos++];
         }
-        if (buflen < 8u) {
-            break;
+        if (sh->buflen < 8u) {
+            sh->inlen += nb_bytes;
+            return;
+        }
+        process_block(sh, sh->buf);
+        sh->buflen = 0;
+    }
+    // Process full blocks directly from the input
+    if (datapos + 8 <= nb_bytes) {
+        u64 v0 = sh->v0, v1 = sh->v1, v2 = sh->v2, v3 = sh->v3;
+        while (datapos + 8 <= nb_bytes) {
+            const u64 m = U8TO64_LE(data + datapos);
+            v3 ^= m;
+            for (int i = 0; i < cROUNDS; ++i)
+                SIPROUND;
+            v0 ^= m;
+            datapos += 8;
         }
-        process_next_block();
-        buflen = 0;
+        sh->v0 = v0; sh->v1 = v1; sh->v2 = v2; sh->v3 = v3;
     }
-    inlen += nb_bytes;
+    // Keep the remainder for later
+    while (datapos < nb_bytes) {
+        sh->buf[sh->buflen++] = data[datapos++];
+    }
+    sh->inlen += nb_bytes;
 }
-void siphash_pad(u64 nb_bytes) {
+void siphash_ctx_pad(struct siphash* sh, u64 nb_bytes) {
     const unsigned char c = 0;
-    for (u64 i = 0; i < nb_bytes; i++) siphash_update(&c, 1);
+    for (u64 i = 0; i < nb_bytes; i++) siphash_ctx_update(sh, &c, 1);
+}
+u8* siphash_ctx_digest(struct siphash* sh) {
+    process_final_block(sh);
+    return sh->out;
+}
+
+// Default context for the process-wide interface
+struct siphash* global_sh;
+
+struct siphash* siphash_default(void) {
+    return global_sh;
+}
+
+void siphash_init(const unsigned char* key_128bit) {
+    if (!global_sh) global_sh = trusted_utils_malloc(sizeof(struct siphash));
+    siphash_ctx_init(global_sh, key_128bit);
+}
+void siphash_reset(void) {
+    siphash_ctx_reset(global_sh);
+}
+void siphash_update(const unsigned char* data, u64 nb_bytes) {
+    siphash_ctx_update(global_sh, data, nb_bytes);
+}
+void siphash_pad(u64 nb_bytes) {
+    siphash_ctx_pad(global_sh, nb_bytes);
 }
 u8* siphash_digest(void) {
-    process_final_block();
-    return out;
+    return siphash_ctx_digest(global_sh);
 }
 void siphash_free(void) {
-    free(buf);
-    free(out);
+    free(global_sh);
+    global_sh = 0;
 }
 
 #undef SH_UINT64_C
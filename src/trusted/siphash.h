@@ -1,8 +1,28 @@
-
 #pragma once
 
 #include "trusted_utils.h"
 
+#define SIPHASH_OUTLEN 16
+
+// State of a single SipHash-128 computation. Independent contexts can be
+// used concurrently (e.g., one per thread).
+struct siphash {
+    const unsigned char* key;
+    u64 v0, v1, v2, v3;
+    u64 inlen;
+    u8 buf[8];
+    unsigned char buflen;
+    u8 out[SIPHASH_OUTLEN];
+};
+
+void siphash_ctx_init(struct siphash* sh, const unsigned char* key_128bit);
+void siphash_ctx_reset(struct siphash* sh);
+void siphash_ctx_update(struct siphash* sh, const unsigned char* data, u64 nb_bytes);
+void siphash_ctx_pad(struct siphash* sh, u64 nb_bytes);
+u8* siphash_ctx_digest(struct siphash* sh);
+
+// Process-wide default context
+struct siphash* siphash_default(void);
 void siphash_init(const unsigned char* key_128bit);
 void siphash_reset();
 void siphash_update(const unsigned char* data, u64 nb_bytes);
@@ -0,0 +1,86 @@
+
+#include "snapshot.h"
+#include <fcntl.h>          // for open, O_RDONLY
+#include <stdio.h>          // for fopen, fwrite, fclose, rename, remove
+#include <sys/mman.h>       // for mmap, munmap
+#include <sys/stat.h>       // for fstat
+#include <unistd.h>         // for close, getpid
+#include "secret.h"         // for secret_derive_key
+#include "siphash.h"        // for siphash_ctx_init, siphash_ctx_update, ...
+#include "trusted_utils.h"  // for trusted_utils_equal_signatures, u64
+
+// Purpose of the key derived from the secret key (see secret.h) for MACs.
+const char* SNAPSHOT_KEY_PURPOSE = "IMPSNAPS";
+
+bool snapshot_writer_init(struct snapshot_writer* w, const char* path) {
+    w->path = path;
+    snprintf(w->tmp_path, 1024, "%s.tmp.%i", path, getpid());
+    w->file = fopen(w->tmp_path, "w");
+    w->ok = w->file != 0;
+    secret_derive_key(SNAPSHOT_KEY_PURPOSE, w->mac_key);
+    siphash_ctx_init(&w->sh, w->mac_key);
+    return w->ok;
+}
+
+void snapshot_write(struct snapshot_writer* w, const void* data, u64 nb_bytes) {
+    if (!w->ok || nb_bytes == 0) return;
+    siphash_ctx_update(&w->sh, (const u8*) data, nb_bytes);
+    w->ok = UNLOCKED_IO(fwrite)(data, 1, nb_bytes, w->file) == nb_bytes;
+}
+
+bool snapshot_writer_end(struct snapshot_writer* w) {
+    if (w->file) {
+        const u8* mac = siphash_ctx_digest(&w->sh);
+        w->ok = w->ok && UNLOCKED_IO(fwrite)(mac, 1, SIG_SIZE_BYTES, w->file) == SIG_SIZE_BYTES;
+        w->ok = (fclose(w->file) == 0) && w->ok;
+    }
+    if (w->ok) w->ok = rename(w->tmp_path, w->path) == 0;
+    if (!w->ok) remove(w->tmp_path);
+    return w->ok;
+}
+
+bool snapshot_map(const char* path, struct snapshot* snap) {
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (u64) st.st_size < sizeof(struct snapshot_header) + SIG_SIZE_BYTES) {
+        close(fd);
+        return false;
+    }
+    snap->mapping_size = st.st_size;
+    snap->mapping = mmap(0, snap->mapping_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (snap->mapping == MAP_FAILED) return false;
+
+    // authenticate the entire snapshot before looking at it
+    const u8* data = (const u8*) snap->mapping;
+    const u64 mac_pos = snap->mapping_size - SIG_SIZE_BYTES;
+    signature mac_key;
+    secret_derive_key(SNAPSHOT_KEY_PURPOSE, mac_key);
+    struct siphash sh;
+    siphash_ctx_init(&sh, mac_key);
+    siphash_ctx_update(&sh, data, mac_pos);
+    const struct snapshot_header* h = (const struct snapshot_header*) data;
+    bool ok = trusted_utils_equal_signatures(siphash_ctx_digest(&sh), data + mac_pos)
+        && h->magic == SNAPSHOT_MAGIC;
+    if (ok) {
+        snap->header = h;
+        u64 pos = sizeof(struct snapshot_header);
+        snap->lits = (const int*) (data + pos);
+        pos += ((h->nb_lits * sizeof(int) + 7) / 8) * 8;
+        snap->offsets = (const u64*) (data + pos);
+        pos += h->nb_clauses * sizeof(u64);
+        snap->deleted = (const u64*) (data + pos);
+        pos += h->nb_deleted_words * sizeof(u64);
+        snap->derived = data + pos;
+        snap->derived_end = data + mac_pos;
+        ok = pos <= mac_pos;
+    }
+    if (!ok) snapshot_unmap(snap);
+    return ok;
+}
+
+void snapshot_unmap(struct snapshot* snap) {
+    munmap(snap->mapping, snap->mapping_size);
+    snap->mapping = 0;
+}
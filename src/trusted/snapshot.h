@@ -0,0 +1,75 @@
+#pragma once
+
+#include <stdbool.h>        // for bool
+#include <stdio.h>          // for FILE
+#include "siphash.h"        // for siphash
+#include "trusted_utils.h"  // for u64, u8, signature
+
+// A snapshot of a checker's state, from which a checker can be restored.
+// Layout (all integers in the system's endianness):
+//   - header (struct snapshot_header)
+//   - nb_lits literals of the original formula (int), each clause
+//     terminated by a zero, padded with zeros to a multiple of 8 bytes
+//   - nb_clauses clause offsets (u64), indexing into the literals
+//   - nb_deleted_words words (u64) of the bitmap of deleted original clauses
+//   - nb_derived derived or imported clauses, each as a record
+//     (struct snapshot_clause) followed by its nb_lits literals (int)
+//   - MAC over everything before it (SipHash with a key derived from the
+//     secret key, see secret.h)
+// The sections are 8-byte aligned up to and excluding the clause records,
+// so that the original formula can be used directly from a mapping.
+
+#define SNAPSHOT_MAGIC 0x50414e534b435049UL // "IPCKSNAP"
+
+#define SNAPSHOT_FLAG_CHECK_MODEL 1
+#define SNAPSHOT_FLAG_LENIENT 2
+#define SNAPSHOT_FLAG_UNSAT_PROVEN 4
+
+struct snapshot_header {
+    u64 magic;
+    u64 nb_vars;
+    signature formula_sig;
+    u64 flags;
+    u64 nb_lits;
+    u64 nb_clauses;
+    u64 nb_deleted_words;
+    u64 nb_loaded_clauses;
+    u64 max_clause_id;
+    u64 nb_derived;
+};
+
+struct snapshot_clause {
+    u64 id;
+    int nb_lits;
+    int imported;
+};
+
+struct snapshot_writer {
+    FILE* file;
+    struct siphash sh;
+    signature mac_key;
+    char tmp_path[1024];
+    const char* path;
+    bool ok;
+};
+
+struct snapshot {
+    void* mapping;
+    u64 mapping_size;
+    const struct snapshot_header* header;
+    const int* lits;
+    const u64* offsets;
+    const u64* deleted;
+    const u8* derived; // clause records
+    const u8* derived_end;
+};
+
+// Write to a temporary file which is renamed to path upon completion.
+bool snapshot_writer_init(struct snapshot_writer* w, const char* path);
+void snapshot_write(struct snapshot_writer* w, const void* data, u64 nb_bytes);
+// Append the MAC and move the snapshot to its final location.
+bool snapshot_writer_end(struct snapshot_writer* w);
+
+// Map a snapshot and authenticate it.
+bool snapshot_map(const char* path, struct snapshot* snap);
+void snapshot_unmap(struct snapshot* snap);
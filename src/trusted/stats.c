@@ -0,0 +1,275 @@
+
+#include "stats.h"
+#include <stdio.h>              // for snprintf, fopen, fwrite, rename
+#include <time.h>               // for clock_gettime, CLOCK_MONOTONIC
+#include "checker_interface.h"  // for TRUSTED_CHK_CLS_PRODUCE, ...
+#include "trusted_utils.h"      // for u64, trusted_utils_log, MALLOB_UNLIKELY
+
+#define STATS_NB_BUCKETS 65
+#define STATS_REPORT_SIZE (1 << 15)
+
+// Histogram over buckets [0], [1], [2,3], [4,7], ..., [2^63, 2^64-1].
+struct log_histogram {
+    u64 buckets[STATS_NB_BUCKETS];
+    u64 count;
+    u64 sum;
+    u64 max;
+};
+
+enum stats_directive {
+    STATS_DIR_PRODUCE, STATS_DIR_IMPORT, STATS_DIR_DELETE, STATS_DIR_LOAD,
+    STATS_DIR_INIT, STATS_DIR_END_LOAD, STATS_DIR_VALIDATE, STATS_DIR_OTHER,
+    STATS_NB_DIRECTIVES
+};
+const char* directive_names[STATS_NB_DIRECTIVES] = {
+    "produce", "import", "delete", "load", "init", "end_load", "validate", "other"
+};
+const char* value_names[STATS_NB_VALUES] = {
+    "hints_per_derivation", "clause_length", "deletion_age"
+};
+const char* memory_names[STATS_NB_MEMORY] = {
+    "original", "produced", "imported", "table", "io", "scratch"
+};
+
+bool stats_enabled = false;
+
+const char* stats_path;
+char stream_path[512];
+u64 interval_ns;
+u64 time_start_ns;
+u64 time_last_write_ns;
+
+struct log_histogram directive_latency[STATS_NB_DIRECTIVES];
+struct log_histogram values[STATS_NB_VALUES];
+u64 input_wait_ns;
+u64 sig_time_ns;
+u64 nb_sigs;
+
+// memory accounting
+u64 memory[STATS_NB_MEMORY];
+u64 memory_total;
+u64 memory_at_peak[STATS_NB_MEMORY]; // breakdown at the highest total
+u64 memory_peak_total;
+u64 nb_clauses[STATS_NB_MEMORY]; // live clauses (for the clause categories)
+u64 nb_clauses_total[STATS_NB_MEMORY];
+
+char report[STATS_REPORT_SIZE];
+
+
+void histogram_add(struct log_histogram* h, u64 value) {
+    const int bucket = value == 0 ? 0 : 64 - __builtin_clzl(value);
+    h->buckets[bucket]++;
+    h->count++;
+    h->sum += value;
+    if (value > h->max) h->max = value;
+}
+
+// Upper bound of the bucket containing the given quantile.
+u64 histogram_quantile(const struct log_histogram* h, double q) {
+    if (h->count == 0) return 0;
+    const u64 rank = (u64) (q * (h->count-1)) + 1;
+    u64 nb_seen = 0;
+    for (int b = 0; b < STATS_NB_BUCKETS; b++) {
+        nb_seen += h->buckets[b];
+        if (nb_seen >= rank) {
+            if (b == 0) return 0;
+            const u64 upper = b == 64 ? ~0UL : (1UL << b) - 1;
+            return upper < h->max ? upper : h->max;
+        }
+    }
+    return h->max;
+}
+
+void reset(void) {
+    for (int i = 0; i < STATS_NB_DIRECTIVES; i++) directive_latency[i] = (struct log_histogram) {0};
+    for (int i = 0; i < STATS_NB_VALUES; i++) values[i] = (struct log_histogram) {0};
+    input_wait_ns = sig_time_ns = nb_sigs = 0;
+    time_start_ns = time_last_write_ns = stats_now_ns();
+}
+
+void stats_init(const char* path_or_null, float interval_secs) {
+    stats_enabled = true;
+    stats_path = path_or_null;
+    interval_ns = (u64) (interval_secs * 1000000000.0f);
+    reset();
+}
+
+void stats_init_stream(int stream) {
+    if (!stats_enabled) return;
+    if (stats_path) {
+        snprintf(stream_path, 512, "%s.%i", stats_path, stream);
+        stats_path = stream_path;
+    }
+    reset();
+}
+
+u64 stats_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+
+void stats_add_input_wait(u64 ns) {
+    input_wait_ns += ns;
+}
+u64 stats_input_wait(void) {
+    return input_wait_ns;
+}
+
+void stats_add_directive(char directive, u64 ns) {
+    enum stats_directive d;
+    switch (directive) {
+    case TRUSTED_CHK_CLS_PRODUCE: d = STATS_DIR_PRODUCE; break;
+    case TRUSTED_CHK_CLS_IMPORT: d = STATS_DIR_IMPORT; break;
+    case TRUSTED_CHK_CLS_DELETE:
+    case TRUSTED_CHK_CLS_DELETE_RANGES:
+    case TRUSTED_CHK_CLS_DELETE_BITMAP: d = STATS_DIR_DELETE; break;
+    case TRUSTED_CHK_LOAD:
+    case TRUSTED_CHK_ADD_INCREMENT: d = STATS_DIR_LOAD; break;
+    case TRUSTED_CHK_INIT: d = STATS_DIR_INIT; break;
+    case TRUSTED_CHK_END_LOAD: d = STATS_DIR_END_LOAD; break;
+    case TRUSTED_CHK_VALIDATE_UNSAT:
+    case TRUSTED_CHK_VALIDATE_UNSAT_ASSUMING:
+    case TRUSTED_CHK_VALIDATE_SAT: d = STATS_DIR_VALIDATE; break;
+    default: d = STATS_DIR_OTHER; break;
+    }
+    histogram_add(&directive_latency[d], ns);
+}
+
+void stats_add_value(enum stats_value kind, u64 value) {
+    histogram_add(&values[kind], value);
+}
+
+void stats_add_sig_time(u64 ns) {
+    sig_time_ns += ns;
+    nb_sigs++;
+}
+
+void stats_memory_add(enum stats_memory kind, long nb_bytes) {
+    memory[kind] += nb_bytes;
+    memory_total += nb_bytes;
+    if (kind == STATS_MEM_PRODUCED || kind == STATS_MEM_IMPORTED) {
+        if (nb_bytes > 0) {
+            nb_clauses[kind]++;
+            nb_clauses_total[kind]++;
+        } else nb_clauses[kind]--;
+    }
+    if (MALLOB_UNLIKELY(memory_total > memory_peak_total)) {
+        memory_peak_total = memory_total;
+        for (int i = 0; i < STATS_NB_MEMORY; i++) memory_at_peak[i] = memory[i];
+    }
+}
+
+void stats_memory_set(enum stats_memory kind, u64 nb_bytes) {
+    stats_memory_add(kind, (long) nb_bytes - (long) memory[kind]);
+}
+
+int append_memory(int len, const char* name, const u64* bytes, u64 total) {
+    len += snprintf(report+len, STATS_REPORT_SIZE-len, "%s total=%lu", name, total);
+    for (int i = 0; i < STATS_NB_MEMORY && len < STATS_REPORT_SIZE; i++)
+        len += snprintf(report+len, STATS_REPORT_SIZE-len, " %s=%lu", memory_names[i], bytes[i]);
+    if (len < STATS_REPORT_SIZE) len += snprintf(report+len, STATS_REPORT_SIZE-len, "\n");
+    return len;
+}
+
+int append_memory_report(int len) {
+    len = append_memory(len, "memory_bytes", memory, memory_total);
+    if (len < STATS_REPORT_SIZE)
+        len = append_memory(len, "memory_peak_bytes", memory_at_peak, memory_peak_total);
+    if (len < STATS_REPORT_SIZE)
+        len += snprintf(report+len, STATS_REPORT_SIZE-len,
+            "clauses produced_live=%lu produced_total=%lu imported_live=%lu imported_total=%lu\n",
+            nb_clauses[STATS_MEM_PRODUCED], nb_clauses_total[STATS_MEM_PRODUCED],
+            nb_clauses[STATS_MEM_IMPORTED], nb_clauses_total[STATS_MEM_IMPORTED]);
+    return len;
+}
+
+int append_histogram(int len, const char* name, const struct log_histogram* h) {
+    len += snprintf(report+len, STATS_REPORT_SIZE-len,
+        "%s count=%lu sum=%lu mean=%.1f p50<=%lu p90<=%lu p99<=%lu max=%lu buckets=",
+        name, h->count, h->sum, h->count == 0 ? 0.0 : (double) h->sum / h->count,
+        histogram_quantile(h, 0.5), histogram_quantile(h, 0.9), histogram_quantile(h, 0.99), h->max);
+    bool first = true;
+    for (int b = 0; b < STATS_NB_BUCKETS && len < STATS_REPORT_SIZE; b++) {
+        if (h->buckets[b] == 0) continue;
+        len += snprintf(report+len, STATS_REPORT_SIZE-len, "%s%i:%lu", first ? "" : ",", b, h->buckets[b]);
+        first = false;
+    }
+    if (len < STATS_REPORT_SIZE) len += snprintf(report+len, STATS_REPORT_SIZE-len, "\n");
+    return len;
+}
+
+// Report into the static buffer; returns its length.
+int write_report(void) {
+    if (!stats_enabled) {
+        const int len = append_memory_report(0);
+        return len < STATS_REPORT_SIZE ? len : STATS_REPORT_SIZE-1;
+    }
+    const u64 elapsed_ns = stats_now_ns() - time_start_ns;
+    u64 checking_ns = 0;
+    for (int i = 0; i < STATS_NB_DIRECTIVES; i++) checking_ns += directive_latency[i].sum;
+    int len = snprintf(report, STATS_REPORT_SIZE,
+        "elapsed_ns=%lu input_wait_ns=%lu checking_ns=%lu sig_count=%lu sig_ns=%lu\n",
+        elapsed_ns, input_wait_ns, checking_ns, nb_sigs, sig_time_ns);
+    // histogram buckets: index b counts values in [2^(b-1), 2^b - 1]
+    for (int i = 0; i < STATS_NB_DIRECTIVES && len < STATS_REPORT_SIZE; i++) {
+        if (directive_latency[i].count == 0) continue;
+        char name[64];
+        snprintf(name, 64, "latency_ns.%s", directive_names[i]);
+        len = append_histogram(len, name, &directive_latency[i]);
+    }
+    for (int i = 0; i < STATS_NB_VALUES && len < STATS_REPORT_SIZE; i++) {
+        len = append_histogram(len, value_names[i], &values[i]);
+    }
+    if (len < STATS_REPORT_SIZE) len = append_memory_report(len);
+    return len < STATS_REPORT_SIZE ? len : STATS_REPORT_SIZE-1;
+}
+
+int stats_report(char* buf, int buf_size) {
+    int len = write_report();
+    if (len >= buf_size) len = buf_size-1;
+    trusted_utils_copy_bytes((u8*) buf, (u8*) report, len);
+    buf[len] = '\0';
+    return len;
+}
+
+void write_stats_file(void) {
+    const int len = write_report();
+    // write to a temporary file first so that readers never see a partial report
+    char tmp_path[600];
+    snprintf(tmp_path, 600, "%s.tmp", stats_path);
+    FILE* f = fopen(tmp_path, "w");
+    if (!f) {
+        trusted_utils_log_err("Could not write stats file");
+        return;
+    }
+    const bool ok = fwrite(report, 1, len, f) == (u64) len;
+    if (fclose(f) == 0 && ok) rename(tmp_path, stats_path);
+}
+
+void stats_maybe_write(u64 now_ns) {
+    if (!stats_path || now_ns - time_last_write_ns < interval_ns) return;
+    write_stats_file();
+    time_last_write_ns = now_ns;
+}
+
+void stats_end(void) {
+    if (stats_enabled && stats_path) write_stats_file();
+}
+
+void stats_memory_record(void) {
+    // no allocations here since we may have just run out of memory
+    const int len = append_memory_report(0);
+    report[len < STATS_REPORT_SIZE ? len : STATS_REPORT_SIZE-1] = '\0';
+    for (char* line = report; *line != '\0'; ) {
+        char* line_end = line;
+        while (*line_end != '\n' && *line_end != '\0') line_end++;
+        const bool last = *line_end == '\0';
+        *line_end = '\0';
+        trusted_utils_log(line);
+        if (last) break;
+        line = line_end+1;
+    }
+    fflush(stdout);
+    if (stats_enabled && stats_path) write_stats_file();
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdbool.h>        // for bool
+#include "trusted_utils.h"  // for u64
+
+// Performance metrics of a checker: counters and log-scale latency
+// histograms per directive type, histograms of hints per derivation and of
+// clause lengths, time spent on clause signatures, and the time spent
+// waiting for input versus processing directives. All recording functions
+// must only be called if stats_enabled is set, so that disabled metrics
+// cost no more than a well-predicted branch per directive.
+
+extern bool stats_enabled;
+
+enum stats_value {
+    STATS_HINTS_PER_DERIVATION,
+    STATS_CLAUSE_LENGTH,
+    STATS_DELETION_AGE, // in clause IDs: highest ID so far minus deleted ID
+    STATS_NB_VALUES
+};
+
+// Live bytes by category. Unlike the other metrics, memory accounting is
+// always active (it only consists of a few counters), so that a record can
+// be written even if the checker runs out of memory.
+enum stats_memory {
+    STATS_MEM_ORIGINAL, // original problem clauses (incl. a mapped image)
+    STATS_MEM_PRODUCED, // locally derived clauses
+    STATS_MEM_IMPORTED, // imported clauses
+    STATS_MEM_TABLE,    // clause index
+    STATS_MEM_IO,       // input buffers
+    STATS_MEM_SCRATCH,  // variable assignments and other scratch data
+    STATS_NB_MEMORY
+};
+
+// Enable metrics. If path is not null, a report is (re-)written to this
+// file at most every interval_secs seconds and once in the end.
+void stats_init(const char* path_or_null, float interval_secs);
+// In a forked checker serving the given further stream: reset all metrics
+// and write the report to "<path>.<stream>" instead.
+void stats_init_stream(int stream);
+u64 stats_now_ns(void);
+void stats_add_input_wait(u64 ns);
+u64 stats_input_wait(void);
+void stats_add_directive(char directive, u64 ns);
+void stats_add_value(enum stats_value kind, u64 value);
+void stats_add_sig_time(u64 ns);
+// Account for a change in live bytes, e.g., upon a clause's (de)allocation.
+void stats_memory_add(enum stats_memory kind, long nb_bytes);
+// Set the live bytes of a category, e.g., after a buffer was resized.
+void stats_memory_set(enum stats_memory kind, u64 nb_bytes);
+// Log the current and the peak memory usage (e.g., before exiting due to
+// a failed allocation) and write the stats file, if any.
+void stats_memory_record(void);
+// Rewrite the stats file if the interval has passed.
+void stats_maybe_write(u64 now_ns);
+// Write a human-readable report to buf; returns its length.
+int stats_report(char* buf, int buf_size);
+void stats_end(void);
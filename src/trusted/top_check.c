@@ -1,100 +1,340 @@
 
+#include "top_check.h"
 #include <stdbool.h>        // for bool, false, true
 #include <stdio.h>          // for snprintf
+#include <stdlib.h>         // for free
+#include "confirm.h"        // for confirm_result_ctx, confirm_increment_ctx, ...
 #include "lrat_check.h"     // for lrat_check_add_axiomatic_clause, lrat_che...
+#include "probes.h"         // for IMPCHECK_PROBE1, IMPCHECK_PROBE2
 #include "secret.h"         // for SECRET_KEY
-#include "siphash.h"        // for siphash_update, siphash_digest, siphash_r...
+#include "siphash.h"        // for siphash_ctx_update, siphash_ctx_digest, ...
+#include "snapshot.h"       // for snapshot_writer_init, snapshot_map, snapshot
+#include "stats.h"          // for stats_enabled, stats_add_sig_time, stats_now_ns
 #include "trusted_utils.h"  // for u8, trusted_utils_copy_bytes, trusted_uti...
-#include "confirm.h"
 
-bool parsed_formula = false;
-signature formula_signature;
+struct top_check {
+    struct lrat_check* lc;
+    signature formula_signature;
+    int formula_nb_vars;
+    bool valid;
+    struct siphash sh; // for clause, increment and result signatures
+    struct snapshot snap; // if restored from a snapshot
+    bool process_stats; // see lrat_check_init
+};
 
-bool valid = true;
+// The context behind the process-wide interface
+struct top_check* default_ctx = 0;
+bool default_rup_fallback = false;
 
 
-void compute_clause_signature(u64 id, const int* lits, int nb_lits, u8* out) {
-    siphash_reset();
-    siphash_update((u8*) &id, sizeof(u64));
-    siphash_update((u8*) lits, nb_lits*sizeof(int));
-    siphash_update(formula_signature, SIG_SIZE_BYTES);
-    const u8* hash_out = siphash_digest();
+void compute_clause_signature(struct top_check* tc, u64 id, const int* lits, int nb_lits, u8* out) {
+    IMPCHECK_PROBE2(sig_begin, id, nb_lits);
+    const bool timed = MALLOB_UNLIKELY(stats_enabled) && tc->process_stats;
+    const u64 time_start = timed ? stats_now_ns() : 0;
+    siphash_ctx_reset(&tc->sh);
+    siphash_ctx_update(&tc->sh, (u8*) &id, sizeof(u64));
+    siphash_ctx_update(&tc->sh, (u8*) lits, nb_lits*sizeof(int));
+    siphash_ctx_update(&tc->sh, tc->formula_signature, SIG_SIZE_BYTES);
+    const u8* hash_out = siphash_ctx_digest(&tc->sh);
     trusted_utils_copy_bytes(out, hash_out, SIG_SIZE_BYTES);
+    if (timed) stats_add_sig_time(stats_now_ns() - time_start);
+    IMPCHECK_PROBE1(sig_end, id);
 }
 
+struct top_check* init(int nb_vars, bool check_model, bool lenient, bool process_stats) {
+    IMPCHECK_PROBE1(load_begin, nb_vars);
+    struct top_check* tc = trusted_utils_calloc(1, sizeof(struct top_check));
+    siphash_ctx_init(&tc->sh, SECRET_KEY);
+    tc->formula_nb_vars = nb_vars;
+    tc->valid = true;
+    tc->process_stats = process_stats;
+    tc->lc = lrat_check_init(nb_vars, check_model, lenient, process_stats);
+    return tc;
+}
 
-void top_check_init(int nb_vars, bool check_model, bool lenient) {
-    siphash_init(SECRET_KEY);
-    lrat_check_init(nb_vars, check_model, lenient);
+struct top_check* restore(const char* path, bool process_stats) {
+    struct snapshot snap;
+    if (!snapshot_map(path, &snap)) {
+        snprintf(trusted_utils_msgstr, 512, "Cannot restore from %.400s - missing or unauthentic", path);
+        return 0;
+    }
+    const struct snapshot_header* h = snap.header;
+    struct top_check* tc = init(h->nb_vars, h->flags & SNAPSHOT_FLAG_CHECK_MODEL,
+        h->flags & SNAPSHOT_FLAG_LENIENT, process_stats);
+    top_check_ctx_commit_formula_sig(tc, h->formula_sig);
+    // The mapping remains alive as long as the checker.
+    tc->snap = snap;
+    tc->valid = lrat_check_restore(tc->lc, &snap);
+    IMPCHECK_PROBE1(load_end, tc->valid);
+    if (!tc->valid) {
+        top_check_ctx_free(tc);
+        return 0;
+    }
+    return tc;
 }
 
-void top_check_commit_formula_sig(const u8* f_sig) {
+
+struct top_check* top_check_ctx_init(int nb_vars, bool check_model, bool lenient) {
+    return init(nb_vars, check_model, lenient, false);
+}
+
+struct top_check* top_check_ctx_restore(const char* path) {
+    return restore(path, false);
+}
+
+void top_check_ctx_free(struct top_check* tc) {
+    lrat_check_free(tc->lc);
+    if (tc->snap.mapping) snapshot_unmap(&tc->snap);
+    free(tc);
+}
+
+void top_check_ctx_use_rup_fallback(struct top_check* tc) {
+    lrat_check_use_rup_fallback(tc->lc);
+}
+
+void top_check_ctx_commit_formula_sig(struct top_check* tc, const u8* f_sig) {
     // Store formula signature to validate later after loading
-    trusted_utils_copy_bytes(formula_signature, f_sig, SIG_SIZE_BYTES);
+    trusted_utils_copy_bytes(tc->formula_signature, f_sig, SIG_SIZE_BYTES);
 }
 
-void top_check_load(int lit) {
-    valid &= lrat_check_load(lit);
+bool top_check_ctx_attach(struct top_check* tc, int nb_vars, const u8* f_sig) {
+    // The formula has already been loaded and verified (in this process
+    // or in a parent process) - just check that the new client agrees.
+    tc->valid &= nb_vars == tc->formula_nb_vars && trusted_utils_equal_signatures(f_sig, tc->formula_signature);
+    if (!tc->valid) snprintf(trusted_utils_msgstr, 512, "Formula does not match the loaded formula");
+    return tc->valid;
 }
 
-bool top_check_end_load(void) {
+void top_check_ctx_load(struct top_check* tc, const int* lits, int nb_lits) {
+    IMPCHECK_PROBE1(load_chunk, nb_lits);
+    tc->valid &= lrat_check_load(tc->lc, lits, nb_lits);
+}
+
+bool top_check_ctx_load_image(struct top_check* tc, const char* path) {
+    tc->valid &= lrat_check_load_image(tc->lc, path, tc->formula_nb_vars);
+    IMPCHECK_PROBE1(load_image, tc->valid);
+    return tc->valid;
+}
+
+bool top_check_ctx_end_load(struct top_check* tc) {
     u8* sig_from_chk;
-    valid = valid && lrat_check_end_load(&sig_from_chk);
-    if (!valid) return false;
+    tc->valid = tc->valid && lrat_check_end_load(tc->lc, &sig_from_chk);
+    if (!tc->valid) return false;
     // Check against provided signature
-    valid = trusted_utils_equal_signatures(sig_from_chk, formula_signature);
-    if (!valid) snprintf(trusted_utils_msgstr, 512, "Formula signature check failed");
-    return valid;
+    tc->valid = trusted_utils_equal_signatures(sig_from_chk, tc->formula_signature);
+    IMPCHECK_PROBE1(load_end, tc->valid);
+    if (!tc->valid) snprintf(trusted_utils_msgstr, 512, "Formula signature check failed");
+    return tc->valid;
 }
 
-bool top_check_produce(unsigned long id, const int* literals, int nb_literals,
+bool top_check_ctx_produce(struct top_check* tc, unsigned long id, const int* literals, int nb_literals,
     const unsigned long* hints, int nb_hints, u8* out_sig_or_null) {
-    
+
     // forward clause to checker
-    valid &= lrat_check_add_clause(id, literals, nb_literals, hints, nb_hints);
-    if (!valid) return false;
+    tc->valid &= lrat_check_add_clause(tc->lc, id, literals, nb_literals, hints, nb_hints);
+    if (!tc->valid) return false;
     // compute signature if desired
     if (out_sig_or_null) {
-        compute_clause_signature(id, literals, nb_literals, out_sig_or_null);
+        compute_clause_signature(tc, id, literals, nb_literals, out_sig_or_null);
     }
     return true;
 }
 
-bool top_check_import(unsigned long id, const int* literals, int nb_literals,
+bool top_check_ctx_import(struct top_check* tc, unsigned long id, const int* literals, int nb_literals,
     const u8* signature_data) {
-    
+
     // verify signature
     signature computed_sig;
-    compute_clause_signature(id, literals, nb_literals, computed_sig);
-    if (!trusted_utils_equal_signatures(signature_data, computed_sig)) {
-        valid = false;
+    compute_clause_signature(tc, id, literals, nb_literals, computed_sig);
+    const bool sig_ok = trusted_utils_equal_signatures(signature_data, computed_sig);
+    IMPCHECK_PROBE2(sig_verify, id, sig_ok);
+    if (!sig_ok) {
+        tc->valid = false;
         snprintf(trusted_utils_msgstr, 512, "Signature check of clause %lu failed", id);
         return false;
     }
 
     // signature verified - forward clause to checker as an axiom
-    valid &= lrat_check_add_axiomatic_clause(id, literals, nb_literals);
-    return valid;
+    tc->valid &= lrat_check_add_axiomatic_clause(tc->lc, id, literals, nb_literals);
+    return tc->valid;
 }
 
-bool top_check_delete(const unsigned long* ids, int nb_ids) {
-    return lrat_check_delete_clause(ids, nb_ids);
+bool top_check_ctx_add_increment(struct top_check* tc, unsigned long first_id, const int* lits, int nb_lits,
+    const u8* inc_sig) {
+
+    // verify signature, which is computed like a formula signature
+    siphash_ctx_reset(&tc->sh);
+    siphash_ctx_update(&tc->sh, (u8*) lits, nb_lits*sizeof(int));
+    siphash_ctx_pad(&tc->sh, 2);
+    const bool sig_ok = trusted_utils_equal_signatures(inc_sig, siphash_ctx_digest(&tc->sh));
+    if (!sig_ok) {
+        tc->valid = false;
+        snprintf(trusted_utils_msgstr, 512, "Signature check of increment %lu failed", first_id);
+        return false;
+    }
+
+    // signature verified - add clauses as originals and extend the formula
+    // signature, on which all clause and result signatures from now on depend
+    tc->valid &= lrat_check_add_increment(tc->lc, first_id, lits, nb_lits);
+    if (!tc->valid) return false;
+    signature f_sig;
+    confirm_increment_ctx(&tc->sh, tc->formula_signature, inc_sig, f_sig);
+    trusted_utils_copy_bytes(tc->formula_signature, f_sig, SIG_SIZE_BYTES);
+    return true;
 }
 
-bool top_check_validate_unsat(u8* out_signature_or_null) {
-    valid &= lrat_check_validate_unsat();
-    if (!valid) return false;
+bool top_check_ctx_has_clause(struct top_check* tc, unsigned long id) {
+    return lrat_check_has_clause(tc->lc, id);
+}
+
+bool top_check_ctx_delete(struct top_check* tc, const unsigned long* ids, int nb_ids) {
+    return lrat_check_delete_clause(tc->lc, ids, nb_ids);
+}
+
+bool top_check_ctx_delete_range(struct top_check* tc, unsigned long first_id, unsigned long nb_ids,
+    unsigned long stride) {
+    return lrat_check_delete_range(tc->lc, first_id, nb_ids, stride);
+}
+
+bool top_check_ctx_delete_bitmap(struct top_check* tc, unsigned long base_id, const unsigned long* words,
+    int nb_words) {
+    return lrat_check_delete_bitmap(tc->lc, base_id, words, nb_words);
+}
+
+bool top_check_ctx_validate_unsat(struct top_check* tc, u8* out_signature_or_null) {
+    tc->valid &= lrat_check_validate_unsat(tc->lc);
+    if (!tc->valid) return false;
     if (out_signature_or_null)
-        confirm_result(formula_signature, 20, out_signature_or_null);
+        confirm_result_ctx(&tc->sh, tc->formula_signature, 20, out_signature_or_null);
     return true;
 }
 
-bool top_check_validate_sat(int* model, u64 size, u8* out_signature_or_null) {
-    valid &= lrat_check_validate_sat(model, size);
-    if (!valid) return false;
+bool top_check_ctx_validate_unsat_assuming(struct top_check* tc, const int* assumptions, int nb_assumptions,
+    unsigned long id, u8* out_signature_or_null) {
+    tc->valid &= lrat_check_validate_unsat_assuming(tc->lc, assumptions, nb_assumptions, id);
+    if (!tc->valid) return false;
     if (out_signature_or_null)
-        confirm_result(formula_signature, 10, out_signature_or_null);
+        confirm_result_assuming_ctx(&tc->sh, tc->formula_signature, assumptions, nb_assumptions,
+            out_signature_or_null);
+    return true;
+}
+
+bool top_check_ctx_validate_sat(struct top_check* tc, int* model, u64 size, u8* out_signature_or_null) {
+    tc->valid &= lrat_check_validate_sat(tc->lc, model, size);
+    if (!tc->valid) return false;
+    if (out_signature_or_null)
+        confirm_result_ctx(&tc->sh, tc->formula_signature, 10, out_signature_or_null);
+    return true;
+}
+
+bool top_check_ctx_checkpoint(struct top_check* tc, const char* path) {
+    if (!tc->valid) {
+        snprintf(trusted_utils_msgstr, 512, "Checkpoint illegal - checker is in an invalid state");
+        return false;
+    }
+    struct snapshot_writer w;
+    if (!snapshot_writer_init(&w, path)) {
+        snprintf(trusted_utils_msgstr, 512, "Cannot write checkpoint %.400s", path);
+        return false;
+    }
+    struct snapshot_header h;
+    h.magic = SNAPSHOT_MAGIC;
+    h.nb_vars = tc->formula_nb_vars;
+    trusted_utils_copy_bytes(h.formula_sig, tc->formula_signature, SIG_SIZE_BYTES);
+    const bool ok = lrat_check_write_snapshot(tc->lc, &w, &h);
+    if (!snapshot_writer_end(&w) && ok) {
+        snprintf(trusted_utils_msgstr, 512, "Cannot write checkpoint %.400s", path);
+        return false;
+    }
+    return ok;
+}
+
+bool top_check_ctx_valid(struct top_check* tc) {return tc->valid;}
+
+
+void top_check_use_rup_fallback(void) {
+    default_rup_fallback = true;
+}
+
+void top_check_init(int nb_vars, bool check_model, bool lenient) {
+    default_ctx = init(nb_vars, check_model, lenient, true);
+    if (default_rup_fallback) top_check_ctx_use_rup_fallback(default_ctx);
+}
+
+void top_check_commit_formula_sig(const u8* f_sig) {
+    top_check_ctx_commit_formula_sig(default_ctx, f_sig);
+}
+
+bool top_check_attach(int nb_vars, const u8* f_sig) {
+    return top_check_ctx_attach(default_ctx, nb_vars, f_sig);
+}
+
+void top_check_load(const int* lits, int nb_lits) {
+    top_check_ctx_load(default_ctx, lits, nb_lits);
+}
+
+bool top_check_load_image(const char* path) {
+    return top_check_ctx_load_image(default_ctx, path);
+}
+
+bool top_check_end_load(void) {
+    return top_check_ctx_end_load(default_ctx);
+}
+
+bool top_check_produce(unsigned long id, const int* literals, int nb_literals,
+    const unsigned long* hints, int nb_hints, u8* out_sig_or_null) {
+    return top_check_ctx_produce(default_ctx, id, literals, nb_literals, hints, nb_hints, out_sig_or_null);
+}
+
+bool top_check_import(unsigned long id, const int* literals, int nb_literals,
+    const u8* signature_data) {
+    return top_check_ctx_import(default_ctx, id, literals, nb_literals, signature_data);
+}
+
+bool top_check_add_increment(unsigned long first_id, const int* lits, int nb_lits,
+    const u8* inc_sig) {
+    return top_check_ctx_add_increment(default_ctx, first_id, lits, nb_lits, inc_sig);
+}
+
+bool top_check_has_clause(unsigned long id) {
+    return top_check_ctx_has_clause(default_ctx, id);
+}
+
+bool top_check_delete(const unsigned long* ids, int nb_ids) {
+    return top_check_ctx_delete(default_ctx, ids, nb_ids);
+}
+
+bool top_check_delete_range(unsigned long first_id, unsigned long nb_ids, unsigned long stride) {
+    return top_check_ctx_delete_range(default_ctx, first_id, nb_ids, stride);
+}
+
+bool top_check_delete_bitmap(unsigned long base_id, const unsigned long* words, int nb_words) {
+    return top_check_ctx_delete_bitmap(default_ctx, base_id, words, nb_words);
+}
+
+bool top_check_validate_unsat(u8* out_signature_or_null) {
+    return top_check_ctx_validate_unsat(default_ctx, out_signature_or_null);
+}
+
+bool top_check_validate_unsat_assuming(const int* assumptions, int nb_assumptions,
+    unsigned long id, u8* out_signature_or_null) {
+    return top_check_ctx_validate_unsat_assuming(default_ctx, assumptions, nb_assumptions, id,
+        out_signature_or_null);
+}
+
+bool top_check_validate_sat(int* model, u64 size, u8* out_signature_or_null) {
+    return top_check_ctx_validate_sat(default_ctx, model, size, out_signature_or_null);
+}
+
+bool top_check_checkpoint(const char* path) {
+    return top_check_ctx_checkpoint(default_ctx, path);
+}
+
+bool top_check_restore(const char* path) {
+    default_ctx = restore(path, true);
+    if (!default_ctx) return false;
+    if (default_rup_fallback) top_check_ctx_use_rup_fallback(default_ctx);
     return true;
 }
 
-bool top_check_valid(void) {return valid;}
+bool top_check_valid(void) {return !default_ctx || default_ctx->valid;}
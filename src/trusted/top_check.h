@@ -5,15 +5,73 @@
 // Top level checking procedure. Checks clauses, validates signatures,
 // and returns certificates for (un)satisfiability.
 
+// Embeddable interface: each checker is an explicit context, so that a
+// process can run several independent checkers (e.g., one per thread).
+// A context must only be used by one thread at a time. The functions
+// behave like their process-wide counterparts below.
+struct top_check;
+
+struct top_check* top_check_ctx_init(int nb_vars, bool check_model, bool lenient);
+// Returns 0 (and sets trusted_utils_msgstr) if the snapshot cannot be restored.
+struct top_check* top_check_ctx_restore(const char* path);
+void top_check_ctx_free(struct top_check* tc);
+// Accept derivations without hints from now on.
+void top_check_ctx_use_rup_fallback(struct top_check* tc);
+void top_check_ctx_commit_formula_sig(struct top_check* tc, const u8* f_sig);
+bool top_check_ctx_attach(struct top_check* tc, int nb_vars, const u8* f_sig);
+void top_check_ctx_load(struct top_check* tc, const int* lits, int nb_lits);
+bool top_check_ctx_load_image(struct top_check* tc, const char* path);
+bool top_check_ctx_end_load(struct top_check* tc);
+bool top_check_ctx_produce(struct top_check* tc, unsigned long id, const int* literals, int nb_literals,
+    const unsigned long* hints, int nb_hints, u8* out_sig_or_null);
+bool top_check_ctx_import(struct top_check* tc, unsigned long id, const int* literals, int nb_literals,
+    const u8* signature_data);
+bool top_check_ctx_add_increment(struct top_check* tc, unsigned long first_id, const int* lits, int nb_lits,
+    const u8* inc_sig);
+bool top_check_ctx_has_clause(struct top_check* tc, unsigned long id);
+bool top_check_ctx_delete(struct top_check* tc, const unsigned long* ids, int nb_ids);
+bool top_check_ctx_delete_range(struct top_check* tc, unsigned long first_id, unsigned long nb_ids,
+    unsigned long stride);
+bool top_check_ctx_delete_bitmap(struct top_check* tc, unsigned long base_id, const unsigned long* words,
+    int nb_words);
+bool top_check_ctx_validate_unsat(struct top_check* tc, u8* out_signature_or_null);
+bool top_check_ctx_validate_unsat_assuming(struct top_check* tc, const int* assumptions, int nb_assumptions,
+    unsigned long id, u8* out_signature_or_null);
+bool top_check_ctx_validate_sat(struct top_check* tc, int* model, u64 size, u8* out_signature_or_null);
+bool top_check_ctx_checkpoint(struct top_check* tc, const char* path);
+bool top_check_ctx_valid(struct top_check* tc);
+
+// Process-wide interface on a single default context, as used by the
+// checker executable.
+
+// Accept derivations without hints, which are checked by unit propagation.
+// Must be called before top_check_init (or top_check_restore).
+void top_check_use_rup_fallback();
 void top_check_init(int nb_vars, bool check_model, bool lenient);
 void top_check_commit_formula_sig(const u8* f_sig);
-void top_check_load(int lit);
+bool top_check_attach(int nb_vars, const u8* f_sig);
+void top_check_load(const int* lits, int nb_lits);
+bool top_check_load_image(const char* path);
 bool top_check_end_load();
 bool top_check_produce(unsigned long id, const int* literals, int nb_literals,
     const unsigned long* hints, int nb_hints, u8* out_sig_or_null);
 bool top_check_import(unsigned long id, const int* literals, int nb_literals,
     const u8* signature_data);
+// Add an increment of original clauses (see lrat_check_add_increment),
+// verified against its signature from the trusted parser, and extend the
+// formula signature accordingly.
+bool top_check_add_increment(unsigned long first_id, const int* lits, int nb_lits,
+    const u8* inc_sig);
+bool top_check_has_clause(unsigned long id);
 bool top_check_delete(const unsigned long* ids, int nb_ids);
+bool top_check_delete_range(unsigned long first_id, unsigned long nb_ids, unsigned long stride);
+bool top_check_delete_bitmap(unsigned long base_id, const unsigned long* words, int nb_words);
 bool top_check_validate_unsat(u8* out_signature_or_null);
+bool top_check_validate_unsat_assuming(const int* assumptions, int nb_assumptions,
+    unsigned long id, u8* out_signature_or_null);
 bool top_check_validate_sat(int* model, u64 size, u8* out_signature_or_null);
+// Write the checker's state to a snapshot file (see snapshot.h).
+bool top_check_checkpoint(const char* path);
+// Initialize the checker from a snapshot file instead of loading a formula.
+bool top_check_restore(const char* path);
 bool top_check_valid();
@@ -1,14 +1,21 @@
 
+#define _GNU_SOURCE // for fopencookie
+
+#include <errno.h>          // for errno, EINTR
 #include <stdbool.h>        // for bool, true, false
-#include <stdio.h>          // for fclose, fflush_unlocked, fopen, snprintf
+#include <stdio.h>          // for fclose, fflush_unlocked, fopen, fopencookie, snprintf
 #include <stdlib.h>         // for free
+#include <string.h>         // for memcpy
 #include <time.h>           // for clock, CLOCKS_PER_SEC, clock_t
+#include <unistd.h>         // for fork, close, read, _exit
+#include <sys/wait.h>       // for wait, waitpid
+#include "probes.h"         // for IMPCHECK_PROBE1, IMPCHECK_PROBE2
+#include "stats.h"          // for stats_enabled, stats_now_ns, stats_add_...
 #include "top_check.h"      // for top_check_commit_formula_sig, top_check_d...
 #include "trusted_utils.h"  // for trusted_utils_read_int, trusted_utils_log...
 #include "checker_interface.h"
 
 #if IMPCHECK_WRITE_DIRECTIVES
-#include <unistd.h>
 #include "../writer.h"
 #endif
 
@@ -26,13 +33,59 @@
 #undef TYPED
 #undef TYPE
 
+// Instantiate u8_vec
+#define TYPE u8
+#define TYPED(THING) u8_ ## THING
+#include "vec.h"
+#undef TYPED
+#undef TYPE
+
 FILE* input; // named pipe
+FILE* input_pipe; // the named pipe beneath input, which may wrap it (see open_stream)
 FILE* output; // named pipe
 int nb_vars; // # variables in formula
 signature formula_sig; // formula signature
 
 bool do_logging = true;
 
+// Further directive/feedback channel pairs. Once the formula has been
+// loaded and verified via the first channel pair, each further pair is
+// served by a forked child process. All children share the (read-only)
+// original clauses with the parent.
+int nb_extra_streams = 0;
+const char** extra_fifos_in;
+const char** extra_fifos_out;
+int nb_children = 0;
+// Set if the formula has been loaded before this stream began.
+bool preloaded = false;
+// Path to a binary formula image to map instead of receiving LOAD directives.
+const char* formula_image = 0;
+
+// With overlap_load, clause directives (PRODUCE, IMPORT, and deletions) may
+// arrive while the formula is still being loaded. They are queued in their
+// input format and executed in order of arrival, each as soon as all the
+// clauses it refers to are present. The responses to these directives are
+// withheld until END_LOAD has verified the formula signature; if this fails,
+// each of them is answered with an error. QUERY_STATS is queued as well,
+// so that its response does not overtake the withheld ones.
+bool overlap_load = false;
+bool loading = false; // between INIT and END_LOAD of a formula loaded here
+struct u8_vec* deferred = 0; // queued directives
+u64 deferred_pos = 0; // beginning of the first directive not executed yet
+struct u8_vec* responses; // withheld responses: result, kind, signature
+
+// Kinds of withheld responses
+#define RESPONSE_PLAIN 0
+#define RESPONSE_SIG 1 // with a signature
+#define RESPONSE_STATS 2 // with the statistics report as of its release
+
+// Process which writes the latest checkpoint, if any.
+pid_t checkpoint_pid = 0;
+#define MAX_CHECKPOINT_PATH_LENGTH 1000
+
+// Buffer for the text reported upon a QUERY_STATS directive.
+#define STATS_REPORT_BUF_SIZE (1 << 15)
+
 // Buffering.
 signature buf_sig;
 struct int_vec* buf_lits;
@@ -53,30 +106,364 @@ void say_with_flush(bool ok) {
     UNLOCKED_IO(fflush)(output);
 }
 
+void report_stats(void) {
+    char* report = trusted_utils_malloc(STATS_REPORT_BUF_SIZE);
+    const int len = stats_report(report, STATS_REPORT_BUF_SIZE);
+    say(true);
+    trusted_utils_write_int(len, output);
+    UNLOCKED_IO(fwrite)(report, 1, len, output);
+    UNLOCKED_IO(fflush)(output);
+    free(report);
+}
+
+void account_buffers(void) {
+    stats_memory_set(STATS_MEM_IO, buf_lits->capacity * sizeof(int) + buf_hints->capacity * sizeof(u64)
+        + (deferred ? deferred->capacity + responses->capacity : 0));
+}
+
 void read_literals(int nb_lits) {
-    int_vec_reserve(buf_lits, nb_lits);
+    if (MALLOB_UNLIKELY((u64) nb_lits > buf_lits->capacity)) {
+        int_vec_reserve(buf_lits, nb_lits);
+        account_buffers();
+    }
     trusted_utils_read_ints(buf_lits->data, nb_lits, input);
 }
 
 void read_hints(int nb_hints) {
-    u64_vec_reserve(buf_hints, nb_hints);
+    if (MALLOB_UNLIKELY((u64) nb_hints > buf_hints->capacity)) {
+        u64_vec_reserve(buf_hints, nb_hints);
+        account_buffers();
+    }
     trusted_utils_read_uls(buf_hints->data, nb_hints, input);
 }
 
-void tc_init(const char* fifo_in, const char* fifo_out) {
-    input = fopen(fifo_in, "r");
+void append_bytes(struct u8_vec* vec, const void* data, u64 nb_bytes) {
+    if (vec->size + nb_bytes > vec->capacity) u8_vec_reserve(vec, 2 * (vec->size + nb_bytes));
+    memcpy(vec->data + vec->size, data, nb_bytes);
+    vec->size += nb_bytes;
+}
+
+const u8* take_bytes(u64* pos, u64 nb_bytes) {
+    const u8* data = deferred->data + *pos;
+    *pos += nb_bytes;
+    return data;
+}
+u64 take_ul(u64* pos) {u64 u; memcpy(&u, take_bytes(pos, sizeof(u64)), sizeof(u64)); return u;}
+int take_int(u64* pos) {int i; memcpy(&i, take_bytes(pos, sizeof(int)), sizeof(int)); return i;}
+void take_literals(u64* pos, int nb_lits) {
+    if (MALLOB_UNLIKELY((u64) nb_lits > buf_lits->capacity)) int_vec_reserve(buf_lits, nb_lits);
+    memcpy(buf_lits->data, take_bytes(pos, nb_lits*sizeof(int)), nb_lits*sizeof(int));
+}
+void take_hints(u64* pos, int nb_hints) {
+    if (MALLOB_UNLIKELY((u64) nb_hints > buf_hints->capacity)) u64_vec_reserve(buf_hints, nb_hints);
+    memcpy(buf_hints->data, take_bytes(pos, nb_hints*sizeof(u64)), nb_hints*sizeof(u64));
+}
+
+// Read a clause directive from the input and queue it.
+// Returns the number of clauses which the directive deletes.
+u64 defer_directive(char c) {
+    append_bytes(deferred, &c, 1);
+    if (c == TRUSTED_CHK_QUERY_STATS) return 0;
+    if (c == TRUSTED_CHK_CLS_PRODUCE || c == TRUSTED_CHK_CLS_IMPORT || c == TRUSTED_CHK_CLS_DELETE_BITMAP) {
+        const u64 id = trusted_utils_read_ul(input);
+        append_bytes(deferred, &id, sizeof(u64));
+    }
+    const int nb = trusted_utils_read_int(input);
+    append_bytes(deferred, &nb, sizeof(int));
+    if (c == TRUSTED_CHK_CLS_PRODUCE || c == TRUSTED_CHK_CLS_IMPORT) {
+        read_literals(nb);
+        append_bytes(deferred, buf_lits->data, nb*sizeof(int));
+    }
+    if (c == TRUSTED_CHK_CLS_PRODUCE) {
+        const int nb_hints = trusted_utils_read_int(input);
+        read_hints(nb_hints);
+        const u8 share = trusted_utils_read_bool(input);
+        append_bytes(deferred, &nb_hints, sizeof(int));
+        append_bytes(deferred, buf_hints->data, nb_hints*sizeof(u64));
+        append_bytes(deferred, &share, 1);
+    } else if (c == TRUSTED_CHK_CLS_IMPORT) {
+        trusted_utils_read_sig(buf_sig, input);
+        append_bytes(deferred, buf_sig, SIG_SIZE_BYTES);
+    } else {
+        const int nb_ids = c == TRUSTED_CHK_CLS_DELETE_RANGES ? 3*nb : nb;
+        read_hints(nb_ids);
+        append_bytes(deferred, buf_hints->data, nb_ids*sizeof(u64));
+        u64 nb_deleted = c == TRUSTED_CHK_CLS_DELETE ? (u64) nb : 0;
+        for (int i = 0; c == TRUSTED_CHK_CLS_DELETE_RANGES && i < nb; i++) nb_deleted += buf_hints->data[3*i+1];
+        for (int i = 0; c == TRUSTED_CHK_CLS_DELETE_BITMAP && i < nb; i++) nb_deleted += __builtin_popcountl(buf_hints->data[i]);
+        return nb_deleted;
+    }
+    return 0;
+}
+
+bool all_present(const u64* ids, int nb_ids) {
+    for (int i = 0; i < nb_ids; i++) if (!top_check_has_clause(ids[i])) return false;
+    return true;
+}
+
+bool all_present_in_ranges(const u64* ranges, int nb_ranges) {
+    for (int r = 0; r < nb_ranges; r++) {
+        const u64 first = ranges[3*r], nb_ids = ranges[3*r+1], stride = ranges[3*r+2];
+        for (u64 i = 0; i < nb_ids; i++) if (!top_check_has_clause(first + i*stride)) return false;
+    }
+    return true;
+}
+
+bool all_present_in_bitmap(u64 base_id, const u64* words, int nb_words) {
+    for (int i = 0; i < nb_words; i++) {
+        for (u64 word = words[i]; word != 0; word &= word - 1)
+            if (!top_check_has_clause(base_id + 64 * (u64) i + __builtin_ctzl(word))) return false;
+    }
+    return true;
+}
+
+// Execute the first queued directive unless force is false and some of
+// the clauses it refers to are not present yet. Returns whether the
+// directive has been executed.
+bool execute_deferred(bool force) {
+    u64 pos = deferred_pos;
+    const char c = *take_bytes(&pos, 1);
+    bool res = true;
+    u8 share = 0;
+    u8 kind = RESPONSE_PLAIN;
+    if (c == TRUSTED_CHK_QUERY_STATS) {
+        kind = RESPONSE_STATS;
+    } else if (c == TRUSTED_CHK_CLS_PRODUCE) {
+        const u64 id = take_ul(&pos);
+        const int nb_lits = take_int(&pos);
+        take_literals(&pos, nb_lits);
+        const int nb_hints = take_int(&pos);
+        take_hints(&pos, nb_hints);
+        share = *take_bytes(&pos, 1);
+        // (derivations without hints may need the entire formula)
+        if (!force && (nb_hints == 0 || !all_present(buf_hints->data, nb_hints))) return false;
+        res = top_check_produce(id, buf_lits->data, nb_lits, buf_hints->data, nb_hints, share ? buf_sig : 0);
+    } else if (c == TRUSTED_CHK_CLS_IMPORT) {
+        const u64 id = take_ul(&pos);
+        const int nb_lits = take_int(&pos);
+        take_literals(&pos, nb_lits);
+        res = top_check_import(id, buf_lits->data, nb_lits, take_bytes(&pos, SIG_SIZE_BYTES));
+    } else if (c == TRUSTED_CHK_CLS_DELETE) {
+        const int nb_ids = take_int(&pos);
+        take_hints(&pos, nb_ids);
+        if (!force && !all_present(buf_hints->data, nb_ids)) return false;
+        res = top_check_delete(buf_hints->data, nb_ids);
+    } else if (c == TRUSTED_CHK_CLS_DELETE_RANGES) {
+        const int nb_ranges = take_int(&pos);
+        take_hints(&pos, 3*nb_ranges);
+        if (!force && !all_present_in_ranges(buf_hints->data, nb_ranges)) return false;
+        for (int i = 0; res && i < nb_ranges; i++) {
+            const u64* range = buf_hints->data + 3*i;
+            res = top_check_delete_range(range[0], range[1], range[2]);
+        }
+    } else if (c == TRUSTED_CHK_CLS_DELETE_BITMAP) {
+        const u64 base_id = take_ul(&pos);
+        const int nb_words = take_int(&pos);
+        take_hints(&pos, nb_words);
+        if (!force && !all_present_in_bitmap(base_id, buf_hints->data, nb_words)) return false;
+        res = top_check_delete_bitmap(base_id, buf_hints->data, nb_words);
+    }
+    deferred_pos = pos;
+    const u8 res_byte = res;
+    if (share) kind = RESPONSE_SIG;
+    append_bytes(responses, &res_byte, 1);
+    append_bytes(responses, &kind, 1);
+    if (share) append_bytes(responses, buf_sig, SIG_SIZE_BYTES);
+    return true;
+}
+
+// Execute queued directives in order as far as possible (or all of them).
+void execute_all_deferred(bool force) {
+    while (deferred_pos < deferred->size && execute_deferred(force)) {}
+    if (deferred_pos == deferred->size) {
+        u8_vec_clear(deferred);
+        deferred_pos = 0;
+    }
+    account_buffers();
+}
+
+// Write all withheld responses. If the formula has not been verified,
+// all of them (including those of directives not executed) are errors,
+// except for the statistics reports.
+void release_responses(bool verified) {
+    const signature no_sig = {0};
+    u64 pos = 0;
+    while (pos < responses->size) {
+        const bool res = responses->data[pos++];
+        const u8 kind = responses->data[pos++];
+        if (kind == RESPONSE_STATS) {
+            report_stats();
+            continue;
+        }
+        say(verified && res);
+        if (kind == RESPONSE_SIG) trusted_utils_write_sig(verified ? responses->data+pos : no_sig, output);
+        if (kind == RESPONSE_SIG) pos += SIG_SIZE_BYTES;
+    }
+    u8_vec_clear(responses);
+    // Answer the directives which have not been executed
+    while (!verified && deferred_pos < deferred->size) {
+        u64 pos = deferred_pos;
+        const char c = *take_bytes(&pos, 1);
+        if (c == TRUSTED_CHK_QUERY_STATS) {
+            report_stats();
+            deferred_pos = pos;
+            continue;
+        }
+        if (c != TRUSTED_CHK_CLS_DELETE && c != TRUSTED_CHK_CLS_DELETE_RANGES) take_ul(&pos);
+        const int nb = take_int(&pos);
+        bool share = false;
+        if (c == TRUSTED_CHK_CLS_PRODUCE) {
+            pos += nb * sizeof(int);
+            pos += take_int(&pos) * sizeof(u64);
+            share = *take_bytes(&pos, 1);
+        } else if (c == TRUSTED_CHK_CLS_IMPORT) {
+            pos += nb * sizeof(int) + SIG_SIZE_BYTES;
+        } else {
+            pos += (c == TRUSTED_CHK_CLS_DELETE_RANGES ? 3*nb : nb) * sizeof(u64);
+        }
+        say(false);
+        if (share) trusted_utils_write_sig(no_sig, output);
+        deferred_pos = pos;
+    }
+    u8_vec_clear(deferred);
+    deferred_pos = 0;
+}
+
+// With metrics enabled, the input is read via these functions, which account
+// the time spent in read() - i.e., blocked on the client - as input wait.
+ssize_t read_input_timed(void* cookie, char* buf, size_t size) {
+    const u64 time_start = stats_now_ns();
+    ssize_t res;
+    do res = read(fileno((FILE*) cookie), buf, size);
+    while (res < 0 && errno == EINTR);
+    stats_add_input_wait(stats_now_ns() - time_start);
+    return res;
+}
+int close_input_timed(void* cookie) {
+    return fclose((FILE*) cookie);
+}
+
+void open_stream(const char* fifo_in, const char* fifo_out) {
+    input = input_pipe = fopen(fifo_in, "r");
     if (!input) trusted_utils_exit_eof();
+    if (MALLOB_UNLIKELY(stats_enabled)) {
+        const cookie_io_functions_t funcs = {read_input_timed, 0, 0, close_input_timed};
+        input = fopencookie(input_pipe, "r", funcs);
+        if (!input) trusted_utils_exit_eof();
+    }
     output = fopen(fifo_out, "w");
     if (!output) trusted_utils_exit_eof();
+}
+
+void fork_streams(void) {
+    fflush(stdout); // do not duplicate buffered log output in children
+    for (int s = 0; s < nb_extra_streams; s++) {
+        const pid_t pid = fork();
+        if (pid < 0) {
+            trusted_utils_log_err("Could not fork checker for additional stream");
+            continue;
+        }
+        if (pid > 0) {
+            nb_children++;
+            continue;
+        }
+        // Child process: serve stream s instead of the parent's stream.
+        // The parent's buffered input must remain untouched, which is why
+        // we only close the underlying file descriptors.
+        close(fileno(input_pipe));
+        close(fileno(output));
+        open_stream(extra_fifos_in[s], extra_fifos_out[s]);
+#if IMPCHECK_WRITE_DIRECTIVES
+        char output_path[512];
+        snprintf(output_path, 512, "directives.%i.impcheck", getpid());
+        writer_init(output_path);
+#endif
+        stats_init_stream(s+1);
+        nb_children = 0;
+        preloaded = true;
+        break;
+    }
+    nb_extra_streams = 0;
+}
+
+bool join_checkpoint(void) {
+    if (checkpoint_pid <= 0) return true;
+    int status;
+    const bool ok = waitpid(checkpoint_pid, &status, 0) == checkpoint_pid
+        && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    if (!ok) trusted_utils_log_err("Writing a checkpoint failed");
+    checkpoint_pid = 0;
+    return ok;
+}
+
+// Write a snapshot in a forked child process, which sees a copy-on-write
+// image of the checker's state, so that checking can proceed meanwhile.
+// At most one checkpoint is written at a time; if the previous one failed,
+// this is reported instead of beginning a new one.
+bool start_checkpoint(const char* path) {
+    if (!top_check_valid()) return false;
+    if (!join_checkpoint()) return false;
+    fflush(stdout); // do not duplicate buffered log output in the child
+    const pid_t pid = fork();
+    if (pid < 0) {
+        trusted_utils_log_err("Could not fork checkpoint writer");
+        return false;
+    }
+    if (pid == 0) {
+        // Child process: leave the parent's streams and buffers alone
+        // by exiting without any cleanup.
+        const bool ok = top_check_checkpoint(path);
+        if (!ok) trusted_utils_log_err(trusted_utils_msgstr);
+        fflush(stdout);
+        _exit(ok ? 0 : 1);
+    }
+    checkpoint_pid = pid;
+    return true;
+}
+
+void tc_init(const char* fifo_in, const char* fifo_out) {
+    open_stream(fifo_in, fifo_out);
     buf_lits = int_vec_init(1 << 14);
     buf_hints = u64_vec_init(1 << 14);
+    account_buffers();
+}
+
+void tc_add_streams(int nb_streams, const char** fifos_in, const char** fifos_out) {
+    nb_extra_streams = nb_streams;
+    extra_fifos_in = fifos_in;
+    extra_fifos_out = fifos_out;
+}
+
+void tc_use_formula_image(const char* path) {
+    formula_image = path;
+}
+
+void tc_overlap_load(void) {
+    overlap_load = true;
+    deferred = u8_vec_init(1 << 14);
+    responses = u8_vec_init(1 << 10);
+    account_buffers();
+}
+
+bool tc_restore(const char* path) {
+    if (!top_check_restore(path)) return false;
+    preloaded = true;
+    return true;
 }
 
 void tc_end(void) {
     int_vec_free(buf_lits);
     u64_vec_free(buf_hints);
+    if (deferred) {
+        u8_vec_free(deferred);
+        u8_vec_free(responses);
+    }
     fclose(output);
     fclose(input);
+    stats_end();
+    join_checkpoint();
+    // join the checkers of any further streams
+    for (int i = 0; i < nb_children; i++) wait(0);
 }
 
 int tc_run(bool check_model, bool lenient) {
@@ -86,9 +473,38 @@ int tc_run(bool check_model, bool lenient) {
 
     bool reported_error = false;
 
+    // Start of the current directive and input wait up to then: the directive's
+    // latency excludes any waiting for its input (see read_input_timed).
+    u64 time_directive = 0, input_wait_before = 0;
+
     while (true) {
         int c = trusted_utils_read_char(input);
-        if (c == TRUSTED_CHK_CLS_PRODUCE) {
+        IMPCHECK_PROBE1(directive, c);
+        if (MALLOB_UNLIKELY(stats_enabled)) {
+            time_directive = stats_now_ns();
+            input_wait_before = stats_input_wait();
+        }
+        if (MALLOB_UNLIKELY(loading) && c != TRUSTED_CHK_LOAD && c != TRUSTED_CHK_END_LOAD) {
+
+            if (c == TRUSTED_CHK_CLS_PRODUCE || c == TRUSTED_CHK_CLS_IMPORT || c == TRUSTED_CHK_CLS_DELETE
+                    || c == TRUSTED_CHK_CLS_DELETE_RANGES || c == TRUSTED_CHK_CLS_DELETE_BITMAP
+                    || c == TRUSTED_CHK_QUERY_STATS) {
+                // queue and execute as far as possible; respond later
+                nb_deleted += defer_directive(c);
+                nb_produced += c == TRUSTED_CHK_CLS_PRODUCE;
+                nb_imported += c == TRUSTED_CHK_CLS_IMPORT;
+                execute_all_deferred(false);
+            } else if (c == TRUSTED_CHK_TERMINATE) {
+                release_responses(false);
+                say_with_flush(true);
+                break;
+            } else {
+                // responding now would overtake the withheld responses
+                trusted_utils_log_err("Directive illegal while loading the formula!");
+                break;
+            }
+
+        } else if (c == TRUSTED_CHK_CLS_PRODUCE) {
 
             // parse
             const u64 id = trusted_utils_read_ul(input);
@@ -97,6 +513,10 @@ int tc_run(bool check_model, bool lenient) {
             const int nb_hints = trusted_utils_read_int(input);
             read_hints(nb_hints);
             const bool share = trusted_utils_read_bool(input);
+            if (MALLOB_UNLIKELY(stats_enabled)) {
+                stats_add_value(STATS_HINTS_PER_DERIVATION, nb_hints);
+                stats_add_value(STATS_CLAUSE_LENGTH, nb_lits);
+            }
             // forward to checker
             bool res = top_check_produce(id, buf_lits->data, nb_lits,
                 buf_hints->data, nb_hints, share ? buf_sig : 0);
@@ -132,24 +552,87 @@ int tc_run(bool check_model, bool lenient) {
             say(res);
             nb_deleted += nb_hints;
 
+        } else if (c == TRUSTED_CHK_CLS_DELETE_RANGES) {
+
+            // parse
+            const int nb_ranges = trusted_utils_read_int(input);
+            read_hints(3 * nb_ranges);
+            // forward to checker
+            bool res = true;
+            for (int i = 0; res && i < nb_ranges; i++) {
+                const u64* range = buf_hints->data + 3*i;
+                res = top_check_delete_range(range[0], range[1], range[2]);
+                nb_deleted += range[1];
+            }
+            // respond
+            say(res);
+
+        } else if (c == TRUSTED_CHK_CLS_DELETE_BITMAP) {
+
+            // parse
+            const u64 base_id = trusted_utils_read_ul(input);
+            const int nb_words = trusted_utils_read_int(input);
+            read_hints(nb_words);
+            // forward to checker
+            bool res = top_check_delete_bitmap(base_id, buf_hints->data, nb_words);
+            for (int i = 0; i < nb_words; i++) nb_deleted += __builtin_popcountl(buf_hints->data[i]);
+            // respond
+            say(res);
+
         } else if (c == TRUSTED_CHK_LOAD) {
 
             const int nb_lits = trusted_utils_read_int(input);
             read_literals(nb_lits);
-            for (int i = 0; i < nb_lits; i++) top_check_load(buf_lits->data[i]);
+            if (MALLOB_UNLIKELY(preloaded || formula_image)) {
+                trusted_utils_log_err("Formula has already been loaded!");
+                break;
+            }
+            top_check_load(buf_lits->data, nb_lits);
+            // queued directives may refer to the new clauses
+            if (loading && deferred->size > 0) execute_all_deferred(false);
             // NO FEEDBACK
 
+        } else if (c == TRUSTED_CHK_ADD_INCREMENT) {
+
+            // parse
+            const u64 first_id = trusted_utils_read_ul(input);
+            const int nb_lits = trusted_utils_read_int(input);
+            read_literals(nb_lits);
+            trusted_utils_read_sig(buf_sig, input);
+            // forward to checker
+            bool res = top_check_add_increment(first_id, buf_lits->data, nb_lits, buf_sig);
+            // respond
+            say_with_flush(res);
+
         } else if (c == TRUSTED_CHK_INIT) {
 
             nb_vars = trusted_utils_read_int(input);
-            top_check_init(nb_vars, check_model, lenient);
             trusted_utils_read_sig(formula_sig, input);
-            top_check_commit_formula_sig(formula_sig);
-            say_with_flush(true);
+            if (preloaded) {
+                say_with_flush(top_check_attach(nb_vars, formula_sig));
+            } else {
+                top_check_init(nb_vars, check_model, lenient);
+                top_check_commit_formula_sig(formula_sig);
+                loading = overlap_load;
+                say_with_flush(true);
+            }
 
         } else if (c == TRUSTED_CHK_END_LOAD) {
 
-            say_with_flush(top_check_end_load());
+            if (preloaded) {
+                say_with_flush(top_check_valid());
+            } else {
+                if (formula_image) top_check_load_image(formula_image);
+                bool res = top_check_end_load();
+                if (loading) {
+                    // formula verified: execute the remaining directives
+                    loading = false;
+                    if (res) execute_all_deferred(true);
+                    release_responses(res);
+                }
+                say_with_flush(res);
+                if (res && nb_extra_streams > 0) fork_streams();
+            }
 
         } else if (c == TRUSTED_CHK_VALIDATE_UNSAT) {
 
@@ -159,6 +642,17 @@ int tc_run(bool check_model, bool lenient) {
             UNLOCKED_IO(fflush)(output);
             if (res) trusted_utils_log("UNSAT validated");
 
+        } else if (c == TRUSTED_CHK_VALIDATE_UNSAT_ASSUMING) {
+
+            const int nb_assumptions = trusted_utils_read_int(input);
+            read_literals(nb_assumptions);
+            const u64 id = trusted_utils_read_ul(input);
+            bool res = top_check_validate_unsat_assuming(buf_lits->data, nb_assumptions, id, buf_sig);
+            say(res);
+            trusted_utils_write_sig(buf_sig, output);
+            UNLOCKED_IO(fflush)(output);
+            if (res) trusted_utils_log("UNSAT under assumptions validated");
+
         } else if (c == TRUSTED_CHK_VALIDATE_SAT) {
 
             const int model_size = trusted_utils_read_int(input);
@@ -171,6 +665,23 @@ int tc_run(bool check_model, bool lenient) {
             if (res) trusted_utils_log("SAT validated");
             free(model);
 
+        } else if (c == TRUSTED_CHK_QUERY_STATS) {
+
+            report_stats();
+
+        } else if (c == TRUSTED_CHK_CHECKPOINT) {
+
+            const int path_len = trusted_utils_read_int(input);
+            char path[MAX_CHECKPOINT_PATH_LENGTH+1];
+            for (int i = 0; i < path_len; i++) {
+                const int path_char = trusted_utils_read_char(input);
+                if (i < MAX_CHECKPOINT_PATH_LENGTH) path[i] = path_char;
+            }
+            const bool path_ok = path_len >= 0 && path_len <= MAX_CHECKPOINT_PATH_LENGTH;
+            if (path_ok) path[path_len] = '\0';
+            // an empty path only awaits the checkpoint being written
+            say_with_flush(path_ok && (path_len == 0 ? join_checkpoint() : start_checkpoint(path)));
+
         } else if (c == TRUSTED_CHK_TERMINATE) {
 
             say_with_flush(true);
@@ -185,6 +696,14 @@ int tc_run(bool check_model, bool lenient) {
         writer_flush();
 #endif
 
+        IMPCHECK_PROBE2(directive_done, c, top_check_valid());
+
+        if (MALLOB_UNLIKELY(stats_enabled)) {
+            const u64 time_done = stats_now_ns();
+            stats_add_directive(c, time_done - time_directive - (stats_input_wait() - input_wait_before));
+            stats_maybe_write(time_done);
+        }
+
         if (MALLOB_UNLIKELY(!top_check_valid())) {
             if (!reported_error) {
                 trusted_utils_log_err(trusted_utils_msgstr);
@@ -196,6 +715,7 @@ int tc_run(bool check_model, bool lenient) {
     float elapsed = (float) (clock() - start) / CLOCKS_PER_SEC;
     snprintf(trusted_utils_msgstr, 512, "cpu:%.3f prod:%lu imp:%lu del:%lu", elapsed, nb_produced, nb_imported, nb_deleted);
     trusted_utils_log(trusted_utils_msgstr);
+    stats_memory_record();
 
     return 0;
 }
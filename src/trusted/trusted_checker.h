@@ -4,5 +4,10 @@
 #include <stdbool.h>
 
 void tc_init(const char* fifo_in, const char* fifo_out);
+void tc_use_formula_image(const char* path);
+// Accept clause directives while the formula is still being loaded.
+void tc_overlap_load();
+bool tc_restore(const char* path);
+void tc_add_streams(int nb_streams, const char** fifos_in, const char** fifos_out);
 void tc_end();
 int tc_run(bool check_model, bool lenient);
@@ -1,10 +1,25 @@
 
+#define _GNU_SOURCE // for pipe2
+
+#include <fcntl.h>          // for O_CLOEXEC
+#include <pthread.h>        // for pthread_create, pthread_join, pthread_t
 #include <stdbool.h>        // for false, bool, true
-#include <stdio.h>          // for FILE, fgetc_unlocked, fopen, EOF
+#include <stdio.h>          // for FILE, fread_unlocked, fopen, fdopen, EOF
 #include <stdlib.h>         // for abort, free
+#include <string.h>         // for memchr, memcmp, memcpy
+#include <sys/mman.h>       // for mmap, madvise, munmap
+#include <sys/stat.h>       // for fstat, S_ISREG
+#include <sys/wait.h>       // for waitpid, WIFEXITED, WEXITSTATUS
+#include <unistd.h>         // for getpid, fork, pipe2, dup2, execl
+#include "broadcast.h"      // for broadcast_write, broadcast_end, broadcast_init
+#include "formula_cache.h"  // for formula_cache_compute_key, formula_cache_...
+#include "formula_image.h"  // for formula_image_writer_add, formula_image_...
 #include "secret.h"         // for SECRET_KEY
-#include "siphash.h"        // for siphash_digest, siphash_init, siphash_update
+#include "siphash.h"        // for siphash_ctx_update, siphash_ctx_digest, siphash_...
 #include "trusted_utils.h"  // for trusted_utils_write_int, trusted_utils_wr...
+#ifdef __SSE2__
+#include <emmintrin.h>      // for _mm_loadu_si128, _mm_cmpeq_epi8, _mm_movemask_epi8
+#endif
 
 // Instantiate int_vec
 #define TYPE int
@@ -13,88 +28,163 @@
 #undef TYPED
 #undef TYPE
 
-FILE* f;
-FILE* f_out;
+// State of the DIMACS tokenizer. The main state processes the header and
+// writes literals to the outputs; in parallel mode, each chunk of the input
+// is tokenized with a separate state into its own literal buffer.
+struct tp_state {
+    struct trusted_parser* tp;
+    struct int_vec* lits;
+    bool in_chunk;
+    bool comment;
+    bool header;
+    bool began_num;
+    bool finished; // EOF character encountered
+    bool saw_header; // problem line within a chunk: chunk must be re-parsed
+    int num;
+    int sign;
+    int nb_read_cls;
+};
+
+// Parallel tokenization of a memory-mapped input file
+struct tp_chunk {
+    const char* begin;
+    const char* end;
+    struct tp_state state;
+    pthread_t thread;
+};
+#define TP_CHUNK_SIZE (1 << 24)
+
+struct trusted_parser {
+    const char* input_path;
+    FILE* f;
+    pid_t decompressor_pid; // process writing the decompressed input to f
+    FILE* f_out; // may be null
+    struct broadcast* outputs; // several outputs (may be null)
+    struct formula_image_writer* image; // may be null
+
+    // Cache of parsed formulas (may be null)
+    const char* cache_dir;
+    struct formula_image_writer* cache_image;
+    char cache_tmp_path[1024];
+
+    struct siphash sh;
+    signature formula_sig;
+
+    struct tp_state st;
+    int nb_threads;
+    struct tp_chunk* chunks;
 
-struct int_vec* data;
+    bool input_finished;
+    bool input_invalid;
 
-bool comment = false;
-bool header = false;
-bool input_finished = false;
-bool input_invalid = false;
-bool began_num = false;
+    int nb_vars;
+    int nb_cls;
+};
 
-int num = 0;
-int sign = 1;
-int nb_read_cls = 0;
+// Parser behind the process-wide interface
+struct trusted_parser* parser;
 
-int nb_vars = -1;
-int nb_cls = -1;
 
+void reset_state(struct tp_state* s) {
+    s->comment = false;
+    s->header = false;
+    s->began_num = false;
+    s->finished = false;
+    s->saw_header = false;
+    s->num = 0;
+    s->sign = 1;
+    s->nb_read_cls = 0;
+}
+
+void output_ints(struct trusted_parser* tp, const int* data, u64 nb_ints) {
+    if (tp->f_out) trusted_utils_write_ints(data, nb_ints, tp->f_out);
+    if (tp->outputs) broadcast_write(tp->outputs, data, nb_ints * sizeof(int));
+}
 
-void output_literal_buffer(void) {
-    siphash_update((unsigned char*) data->data, data->size * sizeof(int));
-    trusted_utils_write_ints(data->data, data->size, f_out);
-    int_vec_clear(data);
+void output_sig(struct trusted_parser* tp, const u8* sig) {
+    if (tp->f_out) trusted_utils_write_sig(sig, tp->f_out);
+    if (tp->outputs) broadcast_write(tp->outputs, sig, SIG_SIZE_BYTES);
 }
 
-void append_integer(void) {
-    if (header) {
-        if (nb_vars == -1) {
-            nb_vars = num;
-            trusted_utils_write_int(nb_vars, f_out);
-        } else if (nb_cls == -1) {
-            nb_cls = num;
-            trusted_utils_write_int(nb_cls, f_out);
-            header = false;
-        } else abort();
-        num = 0;
-        began_num = false;
+void output_literals(struct trusted_parser* tp, const int* lits, u64 nb_lits) {
+    siphash_ctx_update(&tp->sh, (unsigned char*) lits, nb_lits * sizeof(int));
+    output_ints(tp, lits, nb_lits);
+    if (tp->image) formula_image_writer_add(tp->image, lits, nb_lits);
+    if (tp->cache_image) formula_image_writer_add(tp->cache_image, lits, nb_lits);
+}
+
+void output_literal_buffer(struct trusted_parser* tp) {
+    output_literals(tp, tp->st.lits->data, tp->st.lits->size);
+    int_vec_clear(tp->st.lits);
+}
+
+void append_integer(struct tp_state* s) {
+    if (s->header) {
+        struct trusted_parser* tp = s->tp;
+        if (tp->nb_vars == -1) {
+            tp->nb_vars = s->num;
+            output_ints(tp, &tp->nb_vars, 1);
+        } else if (tp->nb_cls == -1) {
+            tp->nb_cls = s->num;
+            output_ints(tp, &tp->nb_cls, 1);
+            s->header = false;
+        } else tp->input_invalid = true; // second problem line
+        s->num = 0;
+        s->began_num = false;
         return;
     }
 
-    const int lit = sign * num;
-    if (lit == 0) nb_read_cls++;
-    num = 0;
-    sign = 1;
-    began_num = false;
+    const int lit = s->sign * s->num;
+    if (lit == 0) s->nb_read_cls++;
+    s->num = 0;
+    s->sign = 1;
+    s->began_num = false;
 
-    if (data->size == data->capacity) output_literal_buffer();
-    int_vec_push(data, lit);
+    if (MALLOB_LIKELY(s->lits->size < s->lits->capacity)) {
+        s->lits->data[s->lits->size++] = lit;
+        return;
+    }
+    if (!s->in_chunk) output_literal_buffer(s->tp);
+    int_vec_push(s->lits, lit);
 }
 
-bool process(char c) {
+// Returns true iff tokenization must stop.
+bool process(struct tp_state* s, char c) {
 
-    if (comment && c != '\n' && c != '\r') return false;
+    if (s->comment && c != '\n' && c != '\r') return false;
 
     signed char uc = *((signed char*) &c);
     switch (uc) {
     case EOF:
-        input_finished = true;
+        s->finished = true;
         return true;
     case '\n':
     case '\r':
-        comment = false;
-        if (began_num) append_integer();
+        s->comment = false;
+        if (s->began_num) append_integer(s);
         break;
     case 'p':
-        header = true;
+        if (s->in_chunk) {
+            s->saw_header = true;
+            return true;
+        }
+        s->header = true;
         break;
     case 'c':
-        if (!header) comment = true;
+        if (!s->header) s->comment = true;
         break;
     case ' ':
-        if (began_num) append_integer();
+        if (s->began_num) append_integer(s);
         break;
     case '-':
-        sign = -1;
-        began_num = true;
+        s->sign = -1;
+        s->began_num = true;
         break;
     case '0': case '1': case '2': case '3': case '4':
     case '5': case '6': case '7': case '8': case '9':
         // Add digit to current number
-        num = num*10 + (c-'0');
-        began_num = true;
+        s->num = s->num*10 + (c-'0');
+        s->began_num = true;
         break;
     default:
         break;
@@ -102,27 +192,438 @@ bool process(char c) {
     return false;
 }
 
+#ifdef __SSE2__
 
-void tp_init(const char* filename, FILE* out) {
-    siphash_init(SECRET_KEY);
-    f = fopen(filename, "r");
-    f_out = out;
-    data = int_vec_init(TRUSTED_CHK_MAX_BUF_SIZE);
+// Convert eight ASCII digits (first digit in the lowest byte) to an integer.
+u32 convert_8_digits(const char* c) {
+    u64 v;
+    memcpy(&v, c, 8);
+    v -= 0x3030303030303030UL;
+    v = (v * 10 + (v >> 8)) & 0x00FF00FF00FF00FFUL;
+    v = (v * 100 + (v >> 16)) & 0x0000FFFF0000FFFFUL;
+    v = (v * 10000 + (v >> 32)) & 0x00000000FFFFFFFFUL;
+    return (u32) v;
 }
 
-void tp_end(void) {
-    free(data);
+// Append a run of digits to the current number. Like the digit-wise
+// computation in process(), this wraps around modulo 2^32.
+void append_digits(struct tp_state* s, const char* c, int nb_digits) {
+    u32 num = (u32) s->num;
+    for (; nb_digits >= 8; nb_digits -= 8, c += 8)
+        num = num * 100000000U + convert_8_digits(c);
+    for (; nb_digits > 0; nb_digits--, c++)
+        num = num * 10 + (u32) (*c - '0');
+    s->num = (int) num;
+    s->began_num = true;
+}
+
+// Position of the next line break at or after c, or end if there is none.
+const char* find_line_end(const char* c, const char* end) {
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i carriage_return = _mm_set1_epi8('\r');
+    for (; c + 16 <= end; c += 16) {
+        const __m128i block = _mm_loadu_si128((const __m128i*) c);
+        const int mask = _mm_movemask_epi8(_mm_or_si128(
+            _mm_cmpeq_epi8(block, newline), _mm_cmpeq_epi8(block, carriage_return)));
+        if (mask != 0) return c + __builtin_ctz(mask);
+    }
+    for (; c != end; c++) if (*c == '\n' || *c == '\r') return c;
+    return end;
+}
+
+// Tokenize a chunk 16 bytes at a time. Each block is classified into digits,
+// separators (spaces and line feeds), signs, and all other characters. Digit
+// runs are converted in bulk and comments are skipped up to their line break.
+// All other characters (carriage returns, comment and header starts, EOF)
+// go through process(), so that the literals are exactly those which
+// process() alone would produce.
+void tokenize(struct tp_state* s, const char* c, const char* end) {
+    const __m128i zero_char = _mm_set1_epi8('0');
+    const __m128i nine = _mm_set1_epi8(9);
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i minus = _mm_set1_epi8('-');
+    const __m128i newline = _mm_set1_epi8('\n');
+    while (c + 16 <= end) {
+        if (s->comment) {
+            c = find_line_end(c, end);
+            if (c == end) return;
+            process(s, *(c++)); // line break: ends the comment
+            continue;
+        }
+        const __m128i block = _mm_loadu_si128((const __m128i*) c);
+        const __m128i offset = _mm_sub_epi8(block, zero_char);
+        const u32 digits = (u32) _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(offset, nine), offset));
+        const u32 spaces = (u32) _mm_movemask_epi8(_mm_cmpeq_epi8(block, space));
+        const u32 signs = (u32) _mm_movemask_epi8(_mm_cmpeq_epi8(block, minus));
+        const u32 newlines = (u32) _mm_movemask_epi8(_mm_cmpeq_epi8(block, newline));
+        int i = 0;
+        while (i < 16 && !s->comment) {
+            const u32 bit = 1U << i;
+            if (digits & bit) {
+                // run of digits (up to the end of the block)
+                const int len = __builtin_ctz(~(digits >> i));
+                append_digits(s, c+i, len);
+                i += len;
+            } else if ((spaces | newlines) & bit) {
+                // separator(s): not within a comment here
+                if (s->began_num) append_integer(s);
+                i += __builtin_ctz(~((spaces | newlines) >> i));
+            } else if (signs & bit) {
+                s->sign = -1;
+                s->began_num = true;
+                i++;
+            } else {
+                if (process(s, c[i])) return;
+                i++;
+            }
+        }
+        c += i;
+    }
+    for (; c != end; c++) {
+        if (process(s, *c)) return;
+    }
+}
+
+#else
+
+void tokenize(struct tp_state* s, const char* c, const char* end) {
+    for (; c != end; c++) {
+        if (process(s, *c)) return;
+    }
+}
+
+#endif
+
+void* tokenize_chunk(void* arg) {
+    struct tp_chunk* chunk = (struct tp_chunk*) arg;
+    struct tp_state* s = &chunk->state;
+    tokenize(s, chunk->begin, chunk->end);
+    if (s->began_num && !s->saw_header) append_integer(s);
+    return 0;
+}
+
+// Sequentially tokenize the input with the main state until the header has
+// been read and its line is complete. Returns the position after that line.
+const char* parse_prefix(struct trusted_parser* tp, const char* begin, const char* end) {
+    const char* c = begin;
+    while (c != end) {
+        const char ch = *(c++);
+        if (process(&tp->st, ch)) break;
+        if (ch == '\n' && tp->nb_cls != -1) break;
+    }
+    return c;
+}
+
+void parse_sequentially(struct trusted_parser* tp, const char* begin, const char* end) {
+    for (const char* c = begin; c != end; c++) {
+        if (process(&tp->st, *c)) return;
+    }
+    tp->st.finished = true;
+}
+
+// Parse the mapped input on nb_threads threads. Behind the header, the input
+// is split into chunks at line breaks where no token can continue, so that
+// every chunk can be tokenized independently. The chunks' literals are then
+// output in their original order.
+void parse_mapped(struct trusted_parser* tp, const char* begin, const char* end) {
+    struct tp_state* st = &tp->st;
+    struct tp_chunk* chunks = tp->chunks;
+    const char* pos = parse_prefix(tp, begin, end);
+    if (st->finished) return;
+    if (tp->nb_cls == -1) {
+        // no complete header: nothing to split
+        parse_sequentially(tp, pos, end);
+        return;
+    }
+    while (!st->finished && pos != end) {
+        // Split the next part of the input into chunks
+        int nb_chunks = 0;
+        while (nb_chunks < tp->nb_threads && pos != end) {
+            struct tp_chunk* chunk = &chunks[nb_chunks++];
+            chunk->begin = pos;
+            chunk->end = (u64) (end - pos) > TP_CHUNK_SIZE ? pos + TP_CHUNK_SIZE : end;
+            if (chunk->end != end) {
+                const char* nl = memchr(chunk->end, '\n', end - chunk->end);
+                chunk->end = nl ? nl+1 : end;
+            }
+            reset_state(&chunk->state);
+            int_vec_clear(chunk->state.lits);
+            pos = chunk->end;
+        }
+        // Tokenize the chunks in parallel
+        for (int i = 1; i < nb_chunks; i++) {
+            if (pthread_create(&chunks[i].thread, 0, tokenize_chunk, &chunks[i]) != 0) abort();
+        }
+        tokenize_chunk(&chunks[0]);
+        for (int i = 1; i < nb_chunks; i++) pthread_join(chunks[i].thread, 0);
+        // Output the chunks' literals in order
+        if (st->lits->size > 0) output_literal_buffer(tp);
+        for (int i = 0; i < nb_chunks; i++) {
+            struct tp_state* s = &chunks[i].state;
+            if (s->saw_header) {
+                // another problem line: re-parse the rest sequentially
+                parse_sequentially(tp, chunks[i].begin, end);
+                return;
+            }
+            output_literals(tp, s->lits->data, s->lits->size);
+            st->nb_read_cls += s->nb_read_cls;
+            if (s->finished) {
+                st->finished = true;
+                return;
+            }
+        }
+    }
+    st->finished = true;
+}
+
+// Returns false iff the input cannot be mapped into memory.
+bool try_parse_mapped(struct trusted_parser* tp) {
+    struct stat stat_buf;
+    const int fd = fileno(tp->f);
+    if (fstat(fd, &stat_buf) != 0 || !S_ISREG(stat_buf.st_mode) || stat_buf.st_size == 0)
+        return false;
+    const u64 size = stat_buf.st_size;
+    void* mapping = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping == MAP_FAILED) return false;
+    madvise(mapping, size, MADV_SEQUENTIAL);
+
+    tp->chunks = trusted_utils_calloc(tp->nb_threads, sizeof(struct tp_chunk));
+    for (int i = 0; i < tp->nb_threads; i++) {
+        tp->chunks[i].state.tp = tp;
+        tp->chunks[i].state.lits = int_vec_init(TRUSTED_CHK_MAX_BUF_SIZE);
+        tp->chunks[i].state.in_chunk = true;
+    }
+    parse_mapped(tp, (const char*) mapping, ((const char*) mapping) + size);
+    for (int i = 0; i < tp->nb_threads; i++) int_vec_free(tp->chunks[i].state.lits);
+    free(tp->chunks);
+    tp->chunks = 0;
+    munmap(mapping, size);
+    return true;
 }
 
+
+// Parse an input which cannot be mapped (e.g., a pipe) block by block.
+// Returns true iff the end of the input has been reached.
+bool parse_stream(struct trusted_parser* tp) {
+    const u64 buf_size = 1 << 20;
+    char* buf = trusted_utils_malloc(buf_size);
+    bool reached_end = false;
+    while (!tp->st.finished) {
+        const u64 nb_read = UNLOCKED_IO(fread)(buf, 1, buf_size, tp->f);
+        if (nb_read == 0) {
+            tp->st.finished = reached_end = true;
+            break;
+        }
+        tokenize(&tp->st, buf, buf + nb_read);
+    }
+    free(buf);
+    return reached_end;
+}
+
+// Directory of the decompression commands, which are part of the trusted
+// computing base and are therefore not looked up in the PATH.
+#ifndef IMPCHECK_DECOMPRESSOR_DIR
+#define IMPCHECK_DECOMPRESSOR_DIR "/usr/bin"
+#endif
+
+// Compression formats which are recognized by their magic number and
+// decompressed by a separate process.
+struct decompressor {
+    const char* magic;
+    u64 magic_len;
+    const char* command;
+};
+const struct decompressor decompressors[] = {
+    {"\x1f\x8b", 2, IMPCHECK_DECOMPRESSOR_DIR "/gzip"},
+    {"\xfd" "7zXZ\x00", 6, IMPCHECK_DECOMPRESSOR_DIR "/xz"},
+    {"BZh", 3, IMPCHECK_DECOMPRESSOR_DIR "/bzip2"},
+    {"\x28\xb5\x2f\xfd", 4, IMPCHECK_DECOMPRESSOR_DIR "/zstd"},
+};
+
+// Open the input file. A compressed file is decompressed by a child process
+// (running "<command> -dc -- <file>") whose output is read through a pipe.
+// Since parsers may run concurrently in several threads, all descriptors are
+// opened close-on-exec, so that a decompressor only inherits its own pipe.
+FILE* open_input(struct trusted_parser* tp, const char* filename) {
+    FILE* file = fopen(filename, "re");
+    if (!file) return 0;
+    // Only regular files are checked since other inputs cannot be rewound.
+    struct stat stat_buf;
+    if (fstat(fileno(file), &stat_buf) != 0 || !S_ISREG(stat_buf.st_mode)) return file;
+    char magic[8];
+    const u64 nb_read = UNLOCKED_IO(fread)(magic, 1, 8, file);
+    const char* command = 0;
+    for (u64 i = 0; i < sizeof(decompressors) / sizeof(struct decompressor); i++) {
+        const struct decompressor* d = &decompressors[i];
+        if (nb_read >= d->magic_len && memcmp(magic, d->magic, d->magic_len) == 0)
+            command = d->command;
+    }
+    if (!command) {
+        rewind(file);
+        return file;
+    }
+    fclose(file);
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) != 0) return 0;
+    tp->decompressor_pid = fork();
+    if (tp->decompressor_pid < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        return 0;
+    }
+    if (tp->decompressor_pid == 0) {
+        // child: decompress the file to the pipe (dup2 clears close-on-exec)
+        if (dup2(fds[1], STDOUT_FILENO) < 0) _exit(1);
+        execl(command, command, "-dc", "--", filename, (char*) 0);
+        _exit(127); // command not found
+    }
+    close(fds[1]);
+    FILE* pipe_file = fdopen(fds[0], "r");
+    if (!pipe_file) close(fds[0]);
+    return pipe_file;
+}
+
+// Close the input. Returns false iff a decompressor did not succeed
+// even though its entire output has been read.
+bool close_input(struct trusted_parser* tp, bool reached_end) {
+    if (tp->f) fclose(tp->f);
+    tp->f = 0;
+    if (tp->decompressor_pid < 0) return true;
+    int status;
+    const bool reaped = waitpid(tp->decompressor_pid, &status, 0) == tp->decompressor_pid;
+    tp->decompressor_pid = -1;
+    if (!reached_end) return true; // decompressor may have been cut off
+    return reaped && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+struct trusted_parser* tp_ctx_init(const char* filename, FILE* out) {
+    struct trusted_parser* tp = trusted_utils_calloc(1, sizeof(struct trusted_parser));
+    siphash_ctx_init(&tp->sh, SECRET_KEY);
+    tp->input_path = filename;
+    tp->decompressor_pid = -1;
+    tp->f = open_input(tp, filename);
+    tp->f_out = out;
+    reset_state(&tp->st);
+    tp->st.tp = tp;
+    tp->st.lits = int_vec_init(TRUSTED_CHK_MAX_BUF_SIZE);
+    tp->st.in_chunk = false;
+    tp->nb_threads = 1;
+    tp->nb_vars = -1;
+    tp->nb_cls = -1;
+    return tp;
+}
+
+bool tp_ctx_write_image(struct trusted_parser* tp, const char* path) {
+    tp->image = formula_image_writer_init(path);
+    return tp->image != 0;
+}
+
+void tp_ctx_broadcast(struct trusted_parser* tp, const char** paths, int nb_paths) {
+    tp->outputs = broadcast_init(paths, nb_paths);
+}
+
+void tp_ctx_use_cache(struct trusted_parser* tp, const char* dir) {
+    tp->cache_dir = dir;
+}
+
+void tp_ctx_set_threads(struct trusted_parser* tp, int nb_threads) {
+    tp->nb_threads = nb_threads < 1 ? 1 : nb_threads;
+}
+
+// Output the formula from an authenticated cache entry, if present.
+bool output_cached_formula(struct trusted_parser* tp, const struct formula_cache_key* key) {
+    struct formula_image img;
+    struct formula_cache_trailer trailer;
+    if (!formula_cache_load(tp->cache_dir, key, &img, &trailer)) return false;
+
+    tp->nb_vars = trailer.nb_vars_declared;
+    tp->nb_cls = trailer.nb_clauses_declared;
+    const u64 nb_lits = img.header->nb_lits;
+    if (tp->nb_vars != -1) output_ints(tp, &tp->nb_vars, 1);
+    if (tp->nb_cls != -1) output_ints(tp, &tp->nb_cls, 1);
+    output_ints(tp, img.lits, nb_lits);
+    if (tp->image) formula_image_writer_add(tp->image, img.lits, nb_lits);
+    trusted_utils_copy_bytes(tp->formula_sig, img.sig, SIG_SIZE_BYTES);
+    formula_image_unmap(&img);
+
+    output_sig(tp, tp->formula_sig);
+    if (tp->image && !formula_image_writer_end(tp->image, tp->nb_vars, tp->formula_sig))
+        tp->input_invalid = true;
+    tp->input_finished = true;
+    return true;
+}
+
+void tp_ctx_end(struct trusted_parser* tp) {
+    int_vec_free(tp->st.lits);
+    close_input(tp, false);
+    free(tp);
+}
+
+bool tp_ctx_parse(struct trusted_parser* tp, u8** sig) {
+    if (!tp->f) return false;
+    *sig = tp->formula_sig;
+    struct formula_cache_key key;
+    const bool use_cache = tp->cache_dir
+        && formula_cache_compute_key(tp->input_path, &key);
+    if (use_cache) {
+        if (output_cached_formula(tp, &key)) {
+            close_input(tp, false);
+            if (tp->outputs && !broadcast_end(tp->outputs)) tp->input_invalid = true;
+            return tp->input_finished && !tp->input_invalid;
+        }
+        // Cache miss: write a new cache entry while parsing
+        snprintf(tp->cache_tmp_path, 1024, "%s/.tmp.%i.%lx.impcache",
+            tp->cache_dir, getpid(), (u64) tp);
+        tp->cache_image = formula_image_writer_init(tp->cache_tmp_path);
+    }
+
+    bool reached_end = true;
+    if (!try_parse_mapped(tp)) reached_end = parse_stream(tp);
+    if (!close_input(tp, reached_end)) tp->input_invalid = true;
+    tp->input_finished = tp->st.finished;
+    if (tp->st.began_num) append_integer(&tp->st);
+    if (tp->st.lits->size > 0) output_literal_buffer(tp);
+    siphash_ctx_pad(&tp->sh, 2); // two-byte padding for formula signature input
+    trusted_utils_copy_bytes(tp->formula_sig, siphash_ctx_digest(&tp->sh), SIG_SIZE_BYTES);
+    output_sig(tp, tp->formula_sig);
+    if (tp->outputs && !broadcast_end(tp->outputs)) tp->input_invalid = true;
+    if (tp->image && !formula_image_writer_end(tp->image, tp->nb_vars, tp->formula_sig))
+        tp->input_invalid = true;
+    const bool ok = tp->input_finished && !tp->input_invalid;
+    if (tp->cache_image) {
+        // Only a successfully parsed formula is added to the cache.
+        if (!formula_image_writer_end(tp->cache_image, tp->nb_vars, tp->formula_sig) || !ok
+                || !formula_cache_commit(tp->cache_dir, tp->cache_tmp_path,
+                    &key, tp->nb_vars, tp->nb_cls))
+            remove(tp->cache_tmp_path);
+    }
+    return ok;
+}
+
+int tp_ctx_nb_vars(struct trusted_parser* tp) {
+    return tp->nb_vars;
+}
+
+void tp_init(const char* filename, FILE* out) {
+    siphash_init(SECRET_KEY); // for callers which sign further data
+    parser = tp_ctx_init(filename, out);
+}
+bool tp_write_image(const char* path) {
+    return tp_ctx_write_image(parser, path);
+}
+void tp_broadcast(const char** paths, int nb_paths) {
+    tp_ctx_broadcast(parser, paths, nb_paths);
+}
+void tp_use_cache(const char* dir) {
+    tp_ctx_use_cache(parser, dir);
+}
+void tp_set_threads(int nb_threads) {
+    tp_ctx_set_threads(parser, nb_threads);
+}
 bool tp_parse(u8** sig) {
-    while (true) {
-        int c_int = UNLOCKED_IO(fgetc)(f);
-        if (process((char) c_int)) break;
-    }
-    if (began_num) append_integer();
-    if (data->size > 0) output_literal_buffer();
-    siphash_pad(2); // two-byte padding for formula signature input
-    *sig = siphash_digest();
-    trusted_utils_write_sig(*sig, f_out);
-    return input_finished && !input_invalid;
+    return tp_ctx_parse(parser, sig);
+}
+void tp_end(void) {
+    tp_ctx_end(parser);
+    parser = 0;
 }
@@ -1,10 +1,36 @@
-
 #pragma once
 
 #include <stdbool.h>        // for bool
 #include <stdio.h>          // for FILE
 #include "trusted_utils.h"  // for u8
 
+// Parser of a DIMACS CNF file. Each parser context is independent of all
+// others, so several formulas can be parsed concurrently (one context per
+// thread). The tp_* functions without "ctx" operate on a single
+// process-wide parser.
+struct trusted_parser;
+
+struct trusted_parser* tp_ctx_init(const char* filename, FILE* out);
+bool tp_ctx_write_image(struct trusted_parser* tp, const char* path);
+void tp_ctx_broadcast(struct trusted_parser* tp, const char** paths, int nb_paths);
+void tp_ctx_use_cache(struct trusted_parser* tp, const char* dir);
+void tp_ctx_set_threads(struct trusted_parser* tp, int nb_threads);
+// The signature written to *sig remains valid until tp_ctx_end.
+bool tp_ctx_parse(struct trusted_parser* tp, u8** sig);
+// The number of variables declared in the parsed formula's header.
+int tp_ctx_nb_vars(struct trusted_parser* tp);
+void tp_ctx_end(struct trusted_parser* tp);
+
 void tp_init(const char* filename, FILE* out);
+// Additionally write a binary formula image (see formula_image.h).
+bool tp_write_image(const char* path);
+// Additionally write the parsed formula to each of the given files
+// concurrently (see broadcast.h).
+void tp_broadcast(const char** paths, int nb_paths);
+// Use (and fill) a cache of parsed formulas in the given directory.
+void tp_use_cache(const char* dir);
+// Tokenize the (memory-mapped) input on several threads. The output is
+// identical to that of sequential parsing.
+void tp_set_threads(int nb_threads);
 bool tp_parse(u8** sig);
 void tp_end();
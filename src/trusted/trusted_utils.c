@@ -9,7 +9,8 @@
 #include <stdlib.h> // exit
 #include <unistd.h> // getpid
 
-char trusted_utils_msgstr[512] = "";
+__thread char trusted_utils_msgstr[512] = "";
+void (*trusted_utils_oom_hook)(void) = 0;
 
 void trusted_utils_log(const char* msg) {
     printf("c [TRUSTED_CORE %i] %s\n", getpid(), msg);
@@ -24,6 +25,7 @@ void trusted_utils_exit_eof(void) {
 }
 void exit_oom(void) {
     trusted_utils_log("allocation failed - terminating");
+    if (trusted_utils_oom_hook) trusted_utils_oom_hook();
     exit(0);
 }
 
@@ -27,12 +27,15 @@ typedef unsigned char u8;
 typedef u8 signature[SIG_SIZE_BYTES];
 #define TRUSTED_CHK_MAX_BUF_SIZE (1<<14)
 
-extern char trusted_utils_msgstr[512];
+// Message of the last error, per thread
+extern __thread char trusted_utils_msgstr[512];
 
 void trusted_utils_log(const char* msg);
 void trusted_utils_log_err(const char* msg);
 
 void trusted_utils_exit_eof(void);
+// Called (if set) before exiting due to a failed allocation.
+extern void (*trusted_utils_oom_hook)(void);
 
 void trusted_utils_try_match_arg(const char* arg, const char* opt, const char** out);
 void trusted_utils_try_match_flag(const char* arg, const char* opt, bool* out);
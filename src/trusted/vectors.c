@@ -24,3 +24,9 @@
 #include "vec.c"
 #undef TYPED
 #undef TYPE
+
+#define TYPE void*
+#define TYPED(THING) ptr_ ## THING
+#include "vec.c"
+#undef TYPED
+#undef TYPE
@@ -0,0 +1,240 @@
+
+#include "watch_index.h"
+#include <stdlib.h>         // for free
+#include "hash.h"           // for hash_table_insert, hash_table_find, ...
+#include "trusted_utils.h"  // for trusted_utils_calloc, MALLOB_UNLIKELY
+
+// Instantiate ptr_vec
+#define TYPE void*
+#define TYPED(THING) ptr_ ## THING
+#include "vec.h"
+#undef TYPED
+#undef TYPE
+
+u64 lit_index(int lit) {
+    return lit > 0 ? 2*(u64)lit : 2*(u64)(-lit) + 1;
+}
+
+int lit_value(const signed char* values, int lit) {
+    return lit > 0 ? values[lit] : -values[-lit];
+}
+
+void push_tracked(struct watch_index* wi, struct ptr_vec* vec, void* elem) {
+    const u64 old_capacity = vec->capacity;
+    ptr_vec_push(vec, elem);
+    wi->nb_bytes += (vec->capacity - old_capacity) * sizeof(void*);
+}
+
+void add_watch(struct watch_index* wi, int lit, struct watched_clause* wc) {
+    struct ptr_vec** list = &wi->lists[lit_index(lit)];
+    if (!*list) {
+        *list = ptr_vec_init(4);
+        wi->nb_bytes += sizeof(struct ptr_vec) + 4 * sizeof(void*);
+    }
+    push_tracked(wi, *list, wc);
+}
+
+void remove_from(struct ptr_vec* vec, void* elem) {
+    for (u64 i = 0; i < vec->size; i++) {
+        if (vec->data[i] != elem) continue;
+        vec->data[i] = vec->data[--vec->size];
+        return;
+    }
+}
+
+void mark_pending(struct watch_index* wi, struct watched_clause* wc) {
+    if (wc->pending) return;
+    wc->pending = true;
+    push_tracked(wi, wi->pending, wc);
+}
+
+// Find a literal (other than the watched ones) which is not false,
+// preferring a true literal; returns its position or -1.
+int find_replacement(const struct watch_index* wi, const struct watched_clause* wc) {
+    int replacement = -1;
+    for (int p = 0; p < wc->nb_lits; p++) {
+        if (p == wc->watch[0] || p == wc->watch[1]) continue;
+        const int value = lit_value(wi->values, wc->lits[p]);
+        if (value > 0) return p;
+        if (value == 0 && replacement < 0) replacement = p;
+    }
+    return replacement;
+}
+
+// Replace watch k (which is false) if possible. Returns true iff replaced,
+// in which case the caller must drop the clause from the old watch list.
+bool rewatch(struct watch_index* wi, struct watched_clause* wc, int k) {
+    const int replacement = find_replacement(wi, wc);
+    if (replacement < 0) return false;
+    wc->watch[k] = replacement;
+    add_watch(wi, wc->lits[replacement], wc);
+    return true;
+}
+
+struct watch_index* watch_index_init(int nb_vars, signed char* values) {
+    struct watch_index* wi = trusted_utils_malloc(sizeof(struct watch_index));
+    wi->values = values;
+    wi->nb_lists = 2 * (u64) nb_vars + 2;
+    wi->lists = trusted_utils_calloc(wi->nb_lists, sizeof(struct ptr_vec*));
+    wi->pending = ptr_vec_init(16);
+    wi->clauses = hash_table_init(16);
+    wi->nb_bytes = wi->nb_lists * sizeof(struct ptr_vec*) + 16 * sizeof(void*);
+    return wi;
+}
+
+void watch_index_free(struct watch_index* wi) {
+    for (u64 i = 0; i < wi->nb_lists; i++) if (wi->lists[i]) ptr_vec_free(wi->lists[i]);
+    free(wi->lists);
+    ptr_vec_free(wi->pending);
+    for (u64 i = 0; i < wi->clauses->capacity; i++) {
+        if (wi->clauses->data[i].key != 0) free(wi->clauses->data[i].val);
+    }
+    hash_table_free(wi->clauses);
+    free(wi);
+}
+
+void watch_index_add(struct watch_index* wi, u64 id, const int* lits, int nb_lits) {
+    struct watched_clause* wc = trusted_utils_malloc(sizeof(struct watched_clause));
+    wc->lits = lits;
+    wc->nb_lits = nb_lits;
+    wc->pending = false;
+    if (!hash_table_insert(wi->clauses, id, wc)) {
+        free(wc);
+        return;
+    }
+    wi->nb_bytes += sizeof(struct watched_clause);
+    // Watch the first two literals which are not false, if possible
+    wc->watch[0] = wc->watch[1] = -1;
+    for (int p = 0; p < nb_lits && wc->watch[1] < 0; p++) {
+        if (lit_value(wi->values, lits[p]) < 0) continue;
+        wc->watch[wc->watch[0] < 0 ? 0 : 1] = p;
+    }
+    bool settled = wc->watch[1] >= 0;
+    for (int k = 0; k < 2; k++) {
+        if (wc->watch[k] >= 0) {
+            settled |= lit_value(wi->values, lits[wc->watch[k]]) > 0;
+            continue;
+        }
+        // fill up with false literals
+        for (int p = 0; p < nb_lits; p++) {
+            if (p != wc->watch[1-k]) {wc->watch[k] = p; break;}
+        }
+    }
+    add_watch(wi, lits[wc->watch[0]], wc);
+    add_watch(wi, lits[wc->watch[1]], wc);
+    if (!settled) mark_pending(wi, wc);
+}
+
+void watch_index_remove(struct watch_index* wi, u64 id) {
+    struct watched_clause* wc = hash_table_find(wi->clauses, id);
+    if (!wc) return;
+    hash_table_delete_last_found(wi->clauses);
+    remove_from(wi->lists[lit_index(wc->lits[wc->watch[0]])], wc);
+    remove_from(wi->lists[lit_index(wc->lits[wc->watch[1]])], wc);
+    if (wc->pending) remove_from(wi->pending, wc);
+    wi->nb_bytes -= sizeof(struct watched_clause);
+    free(wc);
+}
+
+void watch_index_assign(struct watch_index* wi, int lit) {
+    struct ptr_vec* list = wi->lists[lit_index(-lit)];
+    if (!list) return;
+    u64 i = 0;
+    while (i < list->size) {
+        struct watched_clause* wc = list->data[i];
+        const int k = wc->lits[wc->watch[0]] == -lit ? 0 : 1;
+        if (lit_value(wi->values, wc->lits[wc->watch[1-k]]) > 0) {i++; continue;}
+        if (rewatch(wi, wc, k)) {
+            list->data[i] = list->data[--list->size];
+            continue;
+        }
+        mark_pending(wi, wc);
+        i++;
+    }
+}
+
+void watch_index_unassign(struct watch_index* wi, int lit) {
+    // Clauses which were satisfied by lit may now have a false watch
+    struct ptr_vec* list = wi->lists[lit_index(lit)];
+    if (!list) return;
+    for (u64 i = 0; i < list->size; i++) {
+        struct watched_clause* wc = list->data[i];
+        const int k = wc->lits[wc->watch[0]] == lit ? 1 : 0; // the other watch
+        const int other = wc->lits[wc->watch[k]];
+        if (lit_value(wi->values, other) >= 0) continue;
+        struct ptr_vec* other_list = wi->lists[lit_index(other)];
+        if (other_list != list && rewatch(wi, wc, k)) remove_from(other_list, wc);
+        else mark_pending(wi, wc);
+    }
+}
+
+void watch_index_settle(struct watch_index* wi) {
+    u64 nb_kept = 0;
+    for (u64 i = 0; i < wi->pending->size; i++) {
+        struct watched_clause* wc = wi->pending->data[i];
+        bool settled = false;
+        for (int k = 0; k < 2 && !settled; k++) {
+            const int lit = wc->lits[wc->watch[k]];
+            const int value = lit_value(wi->values, lit);
+            if (value > 0) settled = true;
+            else if (value < 0 && rewatch(wi, wc, k)) {
+                remove_from(wi->lists[lit_index(lit)], wc);
+                k = -1; // start over
+            }
+        }
+        settled |= lit_value(wi->values, wc->lits[wc->watch[0]]) >= 0
+            && lit_value(wi->values, wc->lits[wc->watch[1]]) >= 0;
+        if (settled) wc->pending = false;
+        else wi->pending->data[nb_kept++] = wc;
+    }
+    wi->pending->size = nb_kept;
+}
+
+bool watch_index_propagate(struct watch_index* wi, int* queue, u64* size) {
+    signed char* values = wi->values;
+
+    // Pending clauses have at most one literal which is not false
+    // at the top level; they are not reached via their watches.
+    for (u64 i = 0; i < wi->pending->size; i++) {
+        const struct watched_clause* wc = wi->pending->data[i];
+        int unit = 0;
+        bool satisfied = false;
+        for (int p = 0; p < wc->nb_lits; p++) {
+            const int value = lit_value(values, wc->lits[p]);
+            if (value > 0) {satisfied = true; break;}
+            if (value == 0) unit = wc->lits[p];
+        }
+        if (satisfied) continue;
+        if (unit == 0) return false; // conflict
+        const int var = unit > 0 ? unit : -unit;
+        values[var] = unit > 0 ? 1 : -1;
+        queue[(*size)++] = var;
+    }
+
+    u64 head = 0;
+    while (head < *size) {
+        const int var = queue[head++];
+        const int false_lit = values[var] > 0 ? -var : var;
+        struct ptr_vec* list = wi->lists[lit_index(false_lit)];
+        if (!list) continue;
+        u64 i = 0;
+        while (i < list->size) {
+            struct watched_clause* wc = list->data[i];
+            const int k = wc->lits[wc->watch[0]] == false_lit ? 0 : 1;
+            const int other = wc->lits[wc->watch[1-k]];
+            const int other_value = lit_value(values, other);
+            if (other_value > 0) {i++; continue;} // satisfied
+            if (rewatch(wi, wc, k)) {
+                list->data[i] = list->data[--list->size];
+                continue;
+            }
+            // All other literals are false
+            if (MALLOB_UNLIKELY(other_value < 0)) return false; // conflict
+            const int other_var = other > 0 ? other : -other;
+            values[other_var] = other > 0 ? 1 : -1;
+            queue[(*size)++] = other_var;
+            i++;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdbool.h>        // for bool
+#include "trusted_utils.h"  // for u64
+
+// Watched-literal index over clauses with at least two literals, which
+// allows to check a clause by unit propagation without any hints.
+// Each clause watches two of its literals at positions kept in a separate
+// record, so that the clause's literals themselves (which may be shared
+// or mapped read-only) are never written to.
+//
+// The index follows a persistent top-level assignment (see lrat_check.c)
+// without propagating it. Between checks, each clause either watches two
+// literals which are not false, or watches a true literal, or is "pending":
+// it has at most one literal which is not false. Pending clauses are
+// evaluated at the beginning of each propagation.
+
+struct watched_clause {
+    const int* lits; // zero-terminated
+    int nb_lits;
+    int watch[2]; // positions of the watched literals
+    bool pending;
+};
+
+struct watch_index {
+    signed char* values; // assignment of each variable (-1/0/1)
+    struct ptr_vec** lists; // per literal: clauses watching it (lazily allocated)
+    u64 nb_lists;
+    struct ptr_vec* pending;
+    struct hash_table* clauses; // ID -> struct watched_clause*
+    u64 nb_bytes;
+};
+
+struct watch_index* watch_index_init(int nb_vars, signed char* values);
+// Release the index (but not the indexed clauses' literals).
+void watch_index_free(struct watch_index* wi);
+// The literals must remain valid until the clause is removed.
+void watch_index_add(struct watch_index* wi, u64 id, const int* lits, int nb_lits);
+void watch_index_remove(struct watch_index* wi, u64 id);
+// Update the watches after lit has been assigned true / has been unassigned
+// at the top level (i.e., between propagations).
+void watch_index_assign(struct watch_index* wi, int lit);
+void watch_index_unassign(struct watch_index* wi, int lit);
+// Reconsider the watches of pending clauses. Must be called before any
+// assignments are made for a propagation.
+void watch_index_settle(struct watch_index* wi);
+// Propagate the assignments of the variables queue[0], ..., queue[*size-1],
+// appending each variable assigned by propagation to the queue, which must
+// have room for all variables. Returns false iff a conflict has been found.
+// All assignments in the queue must be undone afterwards.
+bool watch_index_propagate(struct watch_index* wi, int* queue, u64* size);
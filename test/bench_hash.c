@@ -0,0 +1,212 @@
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#include "test.h"
+#include "../src/trusted/hash.h"
+#include "../src/trusted/trusted_utils.h"
+
+// Benchmark of the clause ID hash table on workloads resembling those of
+// a checker behind a parallel solver:
+// - "strided": IDs are produced by several solver threads, each of which
+//   uses the IDs offset + k*nb_streams + stream (as in Mallob), and the
+//   streams are interleaved irregularly. All IDs stay alive; finds are
+//   uniformly random.
+// - "window": the same ID streams, but only a sliding window of the most
+//   recent IDs is alive. Older IDs are deleted in bulk, and finds are
+//   weighted toward recent IDs (exponentially distributed age).
+// For each table size n (10^5, 10^6, ... up to the given maximum), reports
+// ns per insert/find/delete, the distribution of probe lengths, the pauses
+// caused by growing the table, and its memory.
+// Usage: bench_hash [<log10 of max. size> [<# streams>]]
+
+#define NB_PROBE_SAMPLES 1000000
+
+u64 rng_state = 88172645463325252UL;
+u64 next_random(void) {
+    // xorshift64
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+double next_uniform(void) {
+    return (next_random() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 0.000000001 * ts.tv_nsec;
+}
+
+// Generator of interleaved, strided ID streams.
+struct id_gen {
+    int nb_streams;
+    u64* next_local; // per stream
+};
+u64 next_id(struct id_gen* gen) {
+    // Streams progress at different speeds: a stream is picked with a
+    // probability roughly proportional to its index + 1.
+    const int s = (int) (sqrt(next_uniform()) * gen->nb_streams);
+    return 1 + (gen->next_local[s]++) * gen->nb_streams + s;
+}
+
+struct rehash_stats {
+    u64 count;
+    double total;
+    double max;
+};
+
+void insert(struct hash_table* ht, u64 id, struct rehash_stats* rehash) {
+    if (ht->size == ht->max_size) {
+        // this insertion grows the table
+        const double time = now();
+        do_assert(hash_table_insert(ht, id, (void*) id));
+        const double pause = now() - time;
+        rehash->count++;
+        rehash->total += pause;
+        if (pause > rehash->max) rehash->max = pause;
+        return;
+    }
+    do_assert(hash_table_insert(ht, id, (void*) id));
+}
+
+int compare_u64(const void* left, const void* right) {
+    const u64 l = *(const u64*) left, r = *(const u64*) right;
+    return l < r ? -1 : (l > r ? 1 : 0);
+}
+
+void report_probe_lengths(struct hash_table* ht, const u64* ids, u64 nb_ids) {
+    const u64 nb_samples = nb_ids < NB_PROBE_SAMPLES ? nb_ids : NB_PROBE_SAMPLES;
+    u64* lengths = trusted_utils_malloc(nb_samples * sizeof(u64));
+    double sum = 0;
+    for (u64 i = 0; i < nb_samples; i++) {
+        lengths[i] = hash_table_probe_length(ht, ids[next_random() % nb_ids]);
+        sum += lengths[i];
+    }
+    qsort(lengths, nb_samples, sizeof(u64), compare_u64);
+    printf("  probe length: mean=%.2f p50=%lu p90=%lu p99=%lu p99.9=%lu max=%lu\n",
+        sum / nb_samples, lengths[nb_samples/2], lengths[nb_samples*9/10],
+        lengths[nb_samples*99/100], lengths[nb_samples*999/1000], lengths[nb_samples-1]);
+    free(lengths);
+}
+
+void report_table(struct hash_table* ht, const struct rehash_stats* rehash) {
+    printf("  table: size=%lu capacity=%lu memory=%.1fMB rehashes=%lu pause_total=%.3fms pause_max=%.3fms\n",
+        ht->size, ht->capacity, ht->capacity * sizeof(struct hash_table_entry) / (1024.0*1024.0),
+        rehash->count, 1000 * rehash->total, 1000 * rehash->max);
+}
+
+void bench_strided(u64 n, int nb_streams) {
+    printf("strided n=%lu streams=%i\n", n, nb_streams);
+    struct id_gen gen = {nb_streams, trusted_utils_calloc(nb_streams, sizeof(u64))};
+    u64* ids = trusted_utils_malloc(n * sizeof(u64));
+    for (u64 i = 0; i < n; i++) ids[i] = next_id(&gen);
+
+    struct hash_table* ht = hash_table_init(16);
+    struct rehash_stats rehash = {0};
+    double time = now();
+    for (u64 i = 0; i < n; i++) insert(ht, ids[i], &rehash);
+    const double time_insert = now() - time;
+
+    u64* lookups = trusted_utils_malloc(n * sizeof(u64));
+    for (u64 i = 0; i < n; i++) lookups[i] = ids[next_random() % n];
+    time = now();
+    for (u64 i = 0; i < n; i++) do_assert(hash_table_find(ht, lookups[i]) != 0);
+    const double time_find = now() - time;
+
+    report_probe_lengths(ht, ids, n);
+    report_table(ht, &rehash);
+
+    time = now();
+    for (u64 i = 0; i < n; i++) do_assert(hash_table_delete(ht, ids[i]));
+    const double time_delete = now() - time;
+    printf("  ns/op: insert=%.1f find=%.1f delete=%.1f\n",
+        1e9 * time_insert / n, 1e9 * time_find / n, 1e9 * time_delete / n);
+
+    free(ht->data);
+    hash_table_free(ht);
+    free(lookups);
+    free(ids);
+    free(gen.next_local);
+}
+
+void bench_window(u64 n, int nb_streams) {
+    // n live IDs; 4n IDs are produced overall; deletions in batches of n/100
+    const u64 batch = n / 100;
+    const u64 nb_total = 4 * n;
+    printf("window n=%lu streams=%i total=%lu batch=%lu\n", n, nb_streams, nb_total, batch);
+    struct id_gen gen = {nb_streams, trusted_utils_calloc(nb_streams, sizeof(u64))};
+    u64* ids = trusted_utils_malloc(nb_total * sizeof(u64));
+    for (u64 i = 0; i < nb_total; i++) ids[i] = next_id(&gen);
+
+    struct hash_table* ht = hash_table_init(16);
+    struct rehash_stats rehash = {0};
+    double time_insert = 0, time_find = 0, time_delete = 0;
+    u64 nb_inserts = 0, nb_finds = 0, nb_deletes = 0;
+    u64* lookups = trusted_utils_malloc(batch * sizeof(u64));
+    u64 begin = 0; // oldest live ID
+    for (u64 end = 0; end < nb_total; ) {
+        // insert a batch of new IDs
+        const u64 new_end = end + batch < nb_total ? end + batch : nb_total;
+        double time = now();
+        for (u64 i = end; i < new_end; i++) insert(ht, ids[i], &rehash);
+        time_insert += now() - time;
+        nb_inserts += new_end - end;
+        end = new_end;
+
+        // look up live IDs, most of them recent (mean age: 5% of the window)
+        const u64 nb_live = end - begin;
+        const double mean_age = 0.05 * nb_live;
+        for (u64 i = 0; i < batch; i++) {
+            u64 age = (u64) (-log(1 - next_uniform()) * mean_age);
+            if (age >= nb_live) age = next_random() % nb_live;
+            lookups[i] = ids[end - 1 - age];
+        }
+        time = now();
+        for (u64 i = 0; i < batch; i++) do_assert(hash_table_find(ht, lookups[i]) != 0);
+        time_find += now() - time;
+        nb_finds += batch;
+
+        // bulk-delete the oldest IDs beyond the window
+        if (end - begin > n) {
+            const u64 new_begin = end - n;
+            time = now();
+            for (u64 i = begin; i < new_begin; i++) do_assert(hash_table_delete(ht, ids[i]));
+            time_delete += now() - time;
+            nb_deletes += new_begin - begin;
+            begin = new_begin;
+        }
+    }
+
+    report_probe_lengths(ht, ids + begin, nb_total - begin);
+    report_table(ht, &rehash);
+    printf("  ns/op: insert=%.1f find=%.1f delete=%.1f\n", 1e9 * time_insert / nb_inserts,
+        1e9 * time_find / nb_finds, nb_deletes == 0 ? 0 : 1e9 * time_delete / nb_deletes);
+
+    free(ht->data);
+    hash_table_free(ht);
+    free(lookups);
+    free(ids);
+    free(gen.next_local);
+}
+
+int main(int argc, char *argv[]) {
+    const int max_log10 = argc > 1 ? atoi(argv[1]) : 7;
+    const int nb_streams = argc > 2 ? atoi(argv[2]) : 32;
+    u64 n = 100000;
+    for (int l = 5; l <= max_log10; l++) {
+        bench_strided(n, nb_streams);
+        bench_window(n, nb_streams);
+        fflush(stdout);
+        n *= 10;
+    }
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    printf("peak_rss=%ldkB\n", usage.ru_maxrss);
+    return 0;
+}
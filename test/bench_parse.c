@@ -0,0 +1,74 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include "test.h"
+#include "../src/trusted/siphash.h"
+#include "../src/trusted/trusted_parser.h"
+#include "../src/trusted/trusted_utils.h"
+
+// Throughput benchmark of the trusted parser.
+// Usage: bench_parse [<path/to/cnf> [<max. threads> [<repetitions>]]]
+// Without a CNF file, a random 3-SAT formula of roughly 256 MB is generated.
+
+double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 0.000000001 * ts.tv_nsec;
+}
+
+void generate_cnf(const char* path, int nb_vars, int nb_cls) {
+    FILE* f = fopen(path, "w");
+    do_assert(f != 0);
+    fprintf(f, "c random 3-SAT formula\np cnf %i %i\n", nb_vars, nb_cls);
+    srand(1);
+    for (int i = 0; i < nb_cls; i++) {
+        if (i % 100000 == 0) fprintf(f, "c progress %i\n", i);
+        for (int j = 0; j < 3; j++) {
+            const int var = 1 + rand() % nb_vars;
+            fprintf(f, "%i ", rand() % 2 ? var : -var);
+        }
+        fprintf(f, "0\n");
+    }
+    fclose(f);
+}
+
+double run(const char* path, int nb_threads, u8* sig_out) {
+    const double time_start = now();
+    tp_init(path, 0);
+    tp_set_threads(nb_threads);
+    u8* sig;
+    bool ok = tp_parse(&sig);
+    do_assert(ok);
+    trusted_utils_copy_bytes(sig_out, sig, SIG_SIZE_BYTES);
+    tp_end();
+    siphash_free();
+    return now() - time_start;
+}
+
+int main(int argc, char *argv[]) {
+    const char* path = argc > 1 ? argv[1] : "bench_parse.cnf";
+    const int max_threads = argc > 2 ? atoi(argv[2]) : 8;
+    const int nb_reps = argc > 3 ? atoi(argv[3]) : 3;
+    if (argc <= 1) generate_cnf(path, 1000000, 20000000);
+
+    struct stat st;
+    do_assert(stat(path, &st) == 0);
+    const double mb = st.st_size / (1024.0 * 1024.0);
+    printf("%s: %.1f MB\n", path, mb);
+
+    signature sig_sequential, sig;
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        double best = 0;
+        for (int rep = 0; rep < nb_reps; rep++) {
+            const double time = run(path, threads, threads == 1 ? sig_sequential : sig);
+            if (threads > 1) do_assert(trusted_utils_equal_signatures(sig, sig_sequential));
+            if (rep == 0 || time < best) best = time;
+        }
+        printf("threads=%i time=%.3fs throughput=%.1f MB/s\n", threads, best, mb / best);
+    }
+    if (argc <= 1) remove(path);
+    return 0;
+}
@@ -0,0 +1,254 @@
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "test.h"
+#include "../src/trusted/checker_interface.h"
+#include "../src/trusted/top_check.h"
+#include "../src/trusted/trusted_utils.h"
+
+// Replays directive files recorded by a checker built with
+// IMPCHECK_WRITE_DIRECTIVES=1 (directives.<pid>.impcheck) directly on the
+// checker core (top_check_*), without the feedback pipe and without any
+// waiting for a solver. Each file is replayed in a process of its own,
+// which reports throughput, per-phase timings and its peak RSS.
+// With -pipe, the file is fed through a pipe by a separate process and read
+// like the checker reads its input, which allows to compare against the
+// transport overhead of an actual checker process.
+// Usage: bench_replay [-pipe] [-check-model] [-lenient] <directives file>...
+// Only recordings of a checker's first stream, which contain the formula's
+// LOAD directives, can be replayed.
+
+enum phase {PHASE_LOAD, PHASE_CHECK, PHASE_VALIDATE, NB_PHASES};
+const char* phase_names[NB_PHASES] = {"load", "check", "validate"};
+
+// Source of directive data: either the mapped file or a pipe.
+struct replay_input {
+    const u8* data;
+    u64 size;
+    u64 pos;
+    FILE* pipe;
+    u8* buf;
+    u64 buf_size;
+};
+
+double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 0.000000001 * ts.tv_nsec;
+}
+
+bool has_more(struct replay_input* in) {
+    if (!in->pipe) return in->pos < in->size;
+    const int c = UNLOCKED_IO(fgetc)(in->pipe);
+    if (c == EOF) return false;
+    ungetc(c, in->pipe);
+    return true;
+}
+
+// Returns a pointer to the next nb_bytes bytes of input, which is valid
+// until the next call. Exits if the input ends prematurely.
+const void* next(struct replay_input* in, u64 nb_bytes) {
+    if (!in->pipe) {
+        if (in->pos + nb_bytes > in->size) trusted_utils_exit_eof();
+        const void* out = in->data + in->pos;
+        in->pos += nb_bytes;
+        return out;
+    }
+    if (nb_bytes > in->buf_size) {
+        free(in->buf);
+        in->buf_size = nb_bytes;
+        in->buf = trusted_utils_malloc(in->buf_size);
+    }
+    if (UNLOCKED_IO(fread)(in->buf, 1, nb_bytes, in->pipe) != nb_bytes) trusted_utils_exit_eof();
+    return in->buf;
+}
+
+char next_char(struct replay_input* in) {return *(const char*) next(in, 1);}
+int next_int(struct replay_input* in) {int i; memcpy(&i, next(in, sizeof(int)), sizeof(int)); return i;}
+u64 next_ul(struct replay_input* in) {u64 u; memcpy(&u, next(in, sizeof(u64)), sizeof(u64)); return u;}
+
+// Copy (instead of pointing into the mapping) since the data is not
+// necessarily aligned and the checker may modify its input.
+void* next_array(struct replay_input* in, u64 nb_bytes, void** buf, u64* buf_size) {
+    if (nb_bytes > *buf_size) {
+        free(*buf);
+        *buf_size = nb_bytes;
+        *buf = trusted_utils_malloc(*buf_size);
+    }
+    if (nb_bytes > 0) memcpy(*buf, next(in, nb_bytes), nb_bytes);
+    return *buf;
+}
+
+// Start a process which writes the mapped file to a pipe; returns the
+// reading end of the pipe.
+FILE* start_feeder(const u8* data, u64 size) {
+    int fds[2];
+    do_assert(pipe(fds) == 0);
+    const pid_t pid = fork();
+    do_assert(pid >= 0);
+    if (pid == 0) {
+        close(fds[0]);
+        u64 pos = 0;
+        while (pos < size) {
+            const ssize_t nb_written = write(fds[1], data + pos, size - pos);
+            if (nb_written <= 0) exit(1);
+            pos += nb_written;
+        }
+        close(fds[1]);
+        exit(0);
+    }
+    close(fds[1]);
+    return fdopen(fds[0], "r");
+}
+
+// Replays a single file; runs in a process of its own.
+int replay(const char* path, bool use_pipe, bool check_model, bool lenient) {
+    const int fd = open(path, O_RDONLY);
+    struct stat st;
+    do_assert(fd >= 0 && fstat(fd, &st) == 0 && st.st_size > 0);
+    struct replay_input in = {0};
+    in.size = st.st_size;
+    in.data = mmap(0, in.size, PROT_READ, MAP_PRIVATE, fd, 0);
+    do_assert(in.data != MAP_FAILED);
+    close(fd);
+    if (use_pipe) in.pipe = start_feeder(in.data, in.size);
+    else madvise((void*) in.data, in.size, MADV_SEQUENTIAL);
+
+    void *lits = 0, *hints = 0;
+    u64 lits_size = 0, hints_size = 0;
+    signature sig;
+    u64 nb_directives = 0, nb_derivations = 0, nb_hints = 0;
+    double phase_time[NB_PHASES] = {0};
+    bool ok = true;
+
+    const double time_start = now();
+    double time_last = time_start;
+    while (ok && has_more(&in)) {
+        const char c = next_char(&in);
+        enum phase phase = PHASE_CHECK;
+        if (c == TRUSTED_CHK_CLS_PRODUCE) {
+            const u64 id = next_ul(&in);
+            const int nb_lits = next_int(&in);
+            next_array(&in, nb_lits*sizeof(int), &lits, &lits_size);
+            const int nb_cls_hints = next_int(&in);
+            next_array(&in, nb_cls_hints*sizeof(u64), &hints, &hints_size);
+            const bool share = next_char(&in) != 0;
+            ok = top_check_produce(id, lits, nb_lits, hints, nb_cls_hints, share ? sig : 0);
+            nb_derivations++;
+            nb_hints += nb_cls_hints;
+        } else if (c == TRUSTED_CHK_CLS_IMPORT) {
+            const u64 id = next_ul(&in);
+            const int nb_lits = next_int(&in);
+            next_array(&in, nb_lits*sizeof(int), &lits, &lits_size);
+            memcpy(sig, next(&in, SIG_SIZE_BYTES), SIG_SIZE_BYTES);
+            ok = top_check_import(id, lits, nb_lits, sig);
+        } else if (c == TRUSTED_CHK_CLS_DELETE) {
+            const int nb_ids = next_int(&in);
+            next_array(&in, nb_ids*sizeof(u64), &hints, &hints_size);
+            ok = top_check_delete(hints, nb_ids);
+        } else if (c == TRUSTED_CHK_CLS_DELETE_RANGES) {
+            const int nb_ranges = next_int(&in);
+            const u64* ranges = next_array(&in, 3*nb_ranges*sizeof(u64), &hints, &hints_size);
+            for (int i = 0; ok && i < nb_ranges; i++)
+                ok = top_check_delete_range(ranges[3*i], ranges[3*i+1], ranges[3*i+2]);
+        } else if (c == TRUSTED_CHK_CLS_DELETE_BITMAP) {
+            const u64 base_id = next_ul(&in);
+            const int nb_words = next_int(&in);
+            next_array(&in, nb_words*sizeof(u64), &hints, &hints_size);
+            ok = top_check_delete_bitmap(base_id, hints, nb_words);
+        } else if (c == TRUSTED_CHK_LOAD) {
+            phase = PHASE_LOAD;
+            const int nb_lits = next_int(&in);
+            next_array(&in, nb_lits*sizeof(int), &lits, &lits_size);
+            top_check_load(lits, nb_lits);
+        } else if (c == TRUSTED_CHK_ADD_INCREMENT) {
+            phase = PHASE_LOAD;
+            const u64 first_id = next_ul(&in);
+            const int nb_lits = next_int(&in);
+            next_array(&in, nb_lits*sizeof(int), &lits, &lits_size);
+            memcpy(sig, next(&in, SIG_SIZE_BYTES), SIG_SIZE_BYTES);
+            ok = top_check_add_increment(first_id, lits, nb_lits, sig);
+        } else if (c == TRUSTED_CHK_INIT) {
+            phase = PHASE_LOAD;
+            const int nb_vars = next_int(&in);
+            memcpy(sig, next(&in, SIG_SIZE_BYTES), SIG_SIZE_BYTES);
+            top_check_init(nb_vars, check_model, lenient);
+            top_check_commit_formula_sig(sig);
+        } else if (c == TRUSTED_CHK_END_LOAD) {
+            phase = PHASE_LOAD;
+            ok = top_check_end_load();
+        } else if (c == TRUSTED_CHK_VALIDATE_UNSAT) {
+            phase = PHASE_VALIDATE;
+            ok = top_check_validate_unsat(sig);
+        } else if (c == TRUSTED_CHK_VALIDATE_UNSAT_ASSUMING) {
+            phase = PHASE_VALIDATE;
+            const int nb_assumptions = next_int(&in);
+            next_array(&in, nb_assumptions*sizeof(int), &lits, &lits_size);
+            ok = top_check_validate_unsat_assuming(lits, nb_assumptions, next_ul(&in), sig);
+        } else if (c == TRUSTED_CHK_VALIDATE_SAT) {
+            phase = PHASE_VALIDATE;
+            const int model_size = next_int(&in);
+            int* model = next_array(&in, model_size*sizeof(int), &lits, &lits_size);
+            ok = top_check_validate_sat(model, model_size, sig);
+        } else if (c == TRUSTED_CHK_QUERY_STATS) {
+            // nothing to replay
+        } else if (c == TRUSTED_CHK_CHECKPOINT) {
+            next(&in, next_int(&in)); // not replayed: skip the path
+        } else if (c == TRUSTED_CHK_TERMINATE) {
+            break;
+        } else {
+            snprintf(trusted_utils_msgstr, 512, "Invalid directive '%c'", c);
+            ok = false;
+        }
+        nb_directives++;
+        const double time = now();
+        phase_time[phase] += time - time_last;
+        time_last = time;
+    }
+    const double elapsed = now() - time_start;
+    if (!ok) trusted_utils_log_err(trusted_utils_msgstr);
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    printf("%s: %s directives=%lu derivations=%lu hints=%lu time=%.3fs"
+        " directives/s=%.0f hints/s=%.0f", path, ok ? "OK" : "FAILED", nb_directives,
+        nb_derivations, nb_hints, elapsed, nb_directives / elapsed, nb_hints / elapsed);
+    for (int p = 0; p < NB_PHASES; p++) printf(" %s=%.3fs", phase_names[p], phase_time[p]);
+    printf(" peak_rss=%ldkB%s\n", usage.ru_maxrss, use_pipe ? " (pipe)" : "");
+    fflush(stdout);
+
+    if (in.pipe) {
+        fclose(in.pipe);
+        wait(0);
+    }
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char *argv[]) {
+    bool use_pipe = false, check_model = false, lenient = false;
+    int nb_failed = 0;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-pipe")) {use_pipe = true; continue;}
+        if (!strcmp(argv[i], "-check-model")) {check_model = true; continue;}
+        if (!strcmp(argv[i], "-lenient")) {lenient = true; continue;}
+        // Replay in a child process so that each file begins with a fresh
+        // checker and has its peak RSS measured separately.
+        fflush(stdout);
+        const pid_t pid = fork();
+        do_assert(pid >= 0);
+        if (pid == 0) exit(replay(argv[i], use_pipe, check_model, lenient));
+        int status;
+        waitpid(pid, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) nb_failed++;
+    }
+    return nb_failed == 0 ? 0 : 1;
+}
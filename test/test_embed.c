@@ -0,0 +1,257 @@
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test.h"
+#include "../src/trusted/confirm.h"
+#include "../src/trusted/secret.h"
+#include "../src/trusted/siphash.h"
+#include "../src/trusted/top_check.h"
+#include "../src/trusted/trusted_utils.h"
+
+// Tests of the in-process checker library with several independent
+// checker contexts in a single process.
+
+// (1 2) (-1 2) (1 -2) (-1 -2)
+const int unsat_formula[] = {1, 2, 0, -1, 2, 0, 1, -2, 0, -1, -2, 0};
+// (1 2) (-1 -2)
+const int sat_formula[] = {1, 2, 0, -1, -2, 0};
+
+void formula_sig(const int* lits, int nb_lits, u8* out) {
+    struct siphash sh;
+    siphash_ctx_init(&sh, SECRET_KEY);
+    siphash_ctx_update(&sh, (const u8*) lits, nb_lits*sizeof(int));
+    siphash_ctx_pad(&sh, 2);
+    trusted_utils_copy_bytes(out, siphash_ctx_digest(&sh), SIG_SIZE_BYTES);
+}
+
+struct top_check* load(const int* lits, int nb_lits, int nb_vars, bool check_model) {
+    signature sig;
+    formula_sig(lits, nb_lits, sig);
+    struct top_check* tc = top_check_ctx_init(nb_vars, check_model, false);
+    top_check_ctx_commit_formula_sig(tc, sig);
+    top_check_ctx_load(tc, lits, nb_lits);
+    do_assert(top_check_ctx_end_load(tc));
+    return tc;
+}
+
+// Derive the empty clause for unsat_formula, with hints or (if rup) without.
+bool prove_unsat(struct top_check* tc, bool rup, u8* out_sig) {
+    const int lit2 = 2, lit_neg2 = -2;
+    const u64 hints5[] = {1, 2}, hints6[] = {3, 4}, hints7[] = {5, 6};
+    return top_check_ctx_produce(tc, 5, &lit2, 1, hints5, rup ? 0 : 2, 0)
+        && top_check_ctx_produce(tc, 6, &lit_neg2, 1, hints6, rup ? 0 : 2, 0)
+        && top_check_ctx_produce(tc, 7, 0, 0, hints7, rup ? 0 : 2, 0)
+        && top_check_ctx_validate_unsat(tc, out_sig);
+}
+
+void test_interleaved() {
+    printf("[TEST] --- begin test_interleaved() ---\n");
+
+    struct top_check* unsat_tc = load(unsat_formula, 12, 2, false);
+    struct top_check* sat_tc = load(sat_formula, 6, 2, true);
+
+    // Derivations in one context do not affect the other.
+    const int lit2 = 2;
+    const u64 hints[] = {1, 2};
+    do_assert(top_check_ctx_produce(unsat_tc, 5, &lit2, 1, hints, 2, 0));
+    do_assert(!top_check_ctx_has_clause(sat_tc, 5));
+    do_assert(!top_check_ctx_produce(sat_tc, 3, &lit2, 1, hints, 2, 0));
+    do_assert(!top_check_ctx_valid(sat_tc));
+    do_assert(top_check_ctx_valid(unsat_tc));
+    top_check_ctx_free(sat_tc);
+
+    signature sig, expected;
+    formula_sig(unsat_formula, 12, expected);
+    const u64 ids[] = {5};
+    do_assert(top_check_ctx_delete(unsat_tc, ids, 1));
+    do_assert(prove_unsat(unsat_tc, false, sig));
+    struct siphash sh;
+    siphash_ctx_init(&sh, SECRET_KEY);
+    confirm_result_ctx(&sh, expected, 20, expected);
+    do_assert(trusted_utils_equal_signatures(sig, expected));
+    top_check_ctx_free(unsat_tc);
+
+    sat_tc = load(sat_formula, 6, 2, true);
+    int model[] = {1, -2};
+    do_assert(top_check_ctx_validate_sat(sat_tc, model, 2, sig));
+    top_check_ctx_free(sat_tc);
+
+    printf("[TEST] ---  end  test_interleaved() ---\n\n");
+}
+
+// Live unit clauses form a persistent top-level assignment, which makes
+// hints redundant as long as (and only as long as) the units are live.
+void test_root_units() {
+    printf("[TEST] --- begin test_root_units() ---\n");
+
+    const int lit1 = 1, lit_neg1 = -1, lit2 = 2, lit3 = 3;
+    const int lits13[] = {1, 3};
+
+    // (1) (-1 2) (-2 3)
+    const int chain[] = {1, 0, -1, 2, 0, -2, 3, 0};
+    struct top_check* tc = load(chain, 8, 3, false);
+    // A redundant hint may come first and is skipped.
+    const u64 hints_redundant[] = {1, 2, 3};
+    do_assert(top_check_ctx_produce(tc, 4, &lit3, 1, hints_redundant, 3, 0));
+    // A conflict may arise before the final hint.
+    const u64 hints_early[] = {2, 3};
+    do_assert(top_check_ctx_produce(tc, 5, &lit2, 1, hints_early, 2, 0));
+    // A clause with a literal true at the top level needs no hints.
+    do_assert(top_check_ctx_produce(tc, 6, lits13, 2, 0, 0, 0));
+    // The derived unit (2) is used until it is deleted.
+    const u64 hint3 = 3, ids4[] = {4}, ids57[] = {5, 7};
+    do_assert(top_check_ctx_delete(tc, ids4, 1));
+    do_assert(top_check_ctx_produce(tc, 7, &lit3, 1, &hint3, 1, 0));
+    do_assert(top_check_ctx_delete(tc, ids57, 2));
+    do_assert(!top_check_ctx_produce(tc, 8, &lit3, 1, &hint3, 1, 0));
+    top_check_ctx_free(tc);
+
+    // The original unit (1) is not used after its deletion.
+    tc = load(chain, 8, 3, false);
+    const u64 hint2 = 2, id1 = 1, ids14[] = {1, 4};
+    do_assert(top_check_ctx_produce(tc, 4, &lit2, 1, &hint2, 1, 0));
+    do_assert(top_check_ctx_delete(tc, ids14, 2));
+    do_assert(!top_check_ctx_produce(tc, 5, &lit2, 1, &hint2, 1, 0));
+    top_check_ctx_free(tc);
+
+    // (1) (1) (-1 2): a duplicate unit keeps the assignment alive.
+    const int dup[] = {1, 0, 1, 0, -1, 2, 0};
+    tc = load(dup, 7, 2, false);
+    const u64 id2 = 2, ids24[] = {2, 4};
+    do_assert(top_check_ctx_delete(tc, &id1, 1));
+    do_assert(top_check_ctx_produce(tc, 4, &lit2, 1, &hint3, 1, 0));
+    do_assert(top_check_ctx_delete(tc, ids24, 2));
+    do_assert(!top_check_ctx_produce(tc, 5, &lit2, 1, &hint3, 1, 0));
+    top_check_ctx_free(tc);
+
+    // (1) (-1) (1 2): contradictory units imply the empty clause, but
+    // only as long as both of them are live.
+    const int contra[] = {1, 0, -1, 0, 1, 2, 0};
+    tc = load(contra, 7, 2, false);
+    const u64 hints_contra[] = {1, 2};
+    do_assert(top_check_ctx_produce(tc, 4, 0, 0, hints_contra, 2, 0));
+    const u64 id4 = 4;
+    do_assert(top_check_ctx_delete(tc, &id4, 1));
+    do_assert(top_check_ctx_delete(tc, &id2, 1));
+    do_assert(top_check_ctx_produce(tc, 5, &lit1, 1, &hint3, 1, 0));
+    do_assert(!top_check_ctx_produce(tc, 6, &lit_neg1, 1, &id1, 1, 0));
+    top_check_ctx_free(tc);
+
+    printf("[TEST] ---  end  test_root_units() ---\n\n");
+}
+
+// An original unit clause deleted before the end of loading (as with
+// -overlap-load) never enters the top-level assignment.
+void test_delete_unit_while_loading() {
+    printf("[TEST] --- begin test_delete_unit_while_loading() ---\n");
+
+    // (1) (2)
+    const int units[] = {1, 0, 2, 0};
+    signature sig;
+    formula_sig(units, 4, sig);
+    struct top_check* tc = top_check_ctx_init(2, false, false);
+    top_check_ctx_commit_formula_sig(tc, sig);
+    top_check_ctx_load(tc, units, 4);
+    const u64 id1 = 1;
+    do_assert(top_check_ctx_delete(tc, &id1, 1));
+    do_assert(top_check_ctx_end_load(tc));
+    const int lit1 = 1, lit2 = 2;
+    do_assert(top_check_ctx_produce(tc, 3, &lit2, 1, 0, 0, 0));
+    do_assert(!top_check_ctx_produce(tc, 4, &lit1, 1, 0, 0, 0));
+    top_check_ctx_free(tc);
+
+    printf("[TEST] ---  end  test_delete_unit_while_loading() ---\n\n");
+}
+
+// A checker with as many original clauses as its deletion bitmap has bits
+// (64 words) is restored from a snapshot with all of its deletion marks.
+void test_checkpoint_full_bitmap() {
+    printf("[TEST] --- begin test_checkpoint_full_bitmap() ---\n");
+
+    // unsat_formula followed by copies of (3 4) up to 4096 clauses
+    const int nb_clauses = 64 * 64, nb_lits = 3 * nb_clauses;
+    int* lits = trusted_utils_malloc(nb_lits * sizeof(int));
+    memcpy(lits, unsat_formula, sizeof(unsat_formula));
+    for (int i = 12; i < nb_lits; i += 3) {
+        lits[i] = 3; lits[i+1] = 4; lits[i+2] = 0;
+    }
+    struct top_check* tc = load(lits, nb_lits, 4, false);
+    const u64 ids[] = {nb_clauses};
+    do_assert(top_check_ctx_delete(tc, ids, 1));
+    const char* path = ".test-embed.snap";
+    do_assert(top_check_ctx_checkpoint(tc, path));
+    top_check_ctx_free(tc);
+
+    signature sig;
+    formula_sig(lits, nb_lits, sig);
+    tc = top_check_ctx_restore(path);
+    do_assert(tc != 0);
+    do_assert(top_check_ctx_attach(tc, 4, sig));
+    do_assert(!top_check_ctx_has_clause(tc, nb_clauses));
+    do_assert(top_check_ctx_has_clause(tc, nb_clauses - 1));
+    const int lit2 = 2, lit_neg2 = -2;
+    const u64 id = nb_clauses + 1;
+    const u64 hints1[] = {1, 2}, hints2[] = {3, 4}, hints3[] = {id, id + 1};
+    do_assert(top_check_ctx_produce(tc, id, &lit2, 1, hints1, 2, 0));
+    do_assert(top_check_ctx_produce(tc, id + 1, &lit_neg2, 1, hints2, 2, 0));
+    do_assert(top_check_ctx_produce(tc, id + 2, 0, 0, hints3, 2, 0));
+    do_assert(top_check_ctx_validate_unsat(tc, sig));
+    top_check_ctx_free(tc);
+    remove(path);
+    free(lits);
+
+    printf("[TEST] ---  end  test_checkpoint_full_bitmap() ---\n\n");
+}
+
+struct worker {
+    pthread_t thread;
+    int index;
+    bool ok;
+};
+
+void* run_worker(void* arg) {
+    struct worker* w = arg;
+    w->ok = true;
+    for (int i = 0; i < 100 && w->ok; i++) {
+        struct top_check* tc = load(unsat_formula, 12, 2, false);
+        const bool rup = (w->index + i) % 2 == 1;
+        if (rup) top_check_ctx_use_rup_fallback(tc);
+        signature sig;
+        w->ok = prove_unsat(tc, rup, sig);
+        top_check_ctx_free(tc);
+        // An unjustified derivation fails with this thread's error message
+        tc = load(unsat_formula, 12, 2, false);
+        const int lit1 = 1;
+        const u64 hint = 1;
+        trusted_utils_msgstr[0] = '\0';
+        w->ok = w->ok && !top_check_ctx_produce(tc, 5, &lit1, 1, &hint, 1, 0)
+            && strstr(trusted_utils_msgstr, "Derivation 5") != 0;
+        top_check_ctx_free(tc);
+    }
+    return 0;
+}
+
+void test_threads() {
+    printf("[TEST] --- begin test_threads() ---\n");
+    struct worker workers[4];
+    for (int i = 0; i < 4; i++) {
+        workers[i].index = i;
+        do_assert(pthread_create(&workers[i].thread, 0, run_worker, &workers[i]) == 0);
+    }
+    for (int i = 0; i < 4; i++) {
+        pthread_join(workers[i].thread, 0);
+        do_assert(workers[i].ok);
+    }
+    printf("[TEST] ---  end  test_threads() ---\n\n");
+}
+
+int main() {
+    test_interleaved();
+    test_root_units();
+    test_delete_unit_while_loading();
+    test_checkpoint_full_bitmap();
+    test_threads();
+}
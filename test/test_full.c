@@ -1,6 +1,10 @@
 
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -11,6 +15,8 @@
 
 // other imports from this project - just for convenience, not strictly needed
 #include "test.h"
+#include "../src/checker_client.h"
+#include "../src/trusted/formula_cache.h"
 #include "../src/trusted/trusted_utils.h"
 // Instantiate int_vec (poor man's template programming in C)
 #define TYPE int
@@ -46,33 +52,20 @@ void await_ok(FILE* out, FILE* in) {
     do_assert(ok);
 }
 
-// Set up a ready-to-go trusted checker process.
-// - create all named pipes needed for inter-process communication
-// - run a trusted parser instance and read the parsed formula
-//   together with its signature
-// - launch a trusted checker instance and forward the formula
-//   with its signature
-// - return an ID which is needed for the corresponding clean_up() below
-// - return the file handles for writing directives and for reading
-//   feedback via the two out params
-u64 setup(const char* cnfInput, FILE** f_directives_out, FILE** f_feedback_out) {
+// Run a trusted parser instance on the given formula and read the parsed
+// formula together with its signature. The returned vector contains the
+// literals followed by the signature (SIG_SIZE_BYTES bytes).
+// If image_or_null is set, the parser also writes a binary formula image.
+struct int_vec* parse(const char* cnfInput, const char* pipeParsed, const char* image_or_null,
+    int* nb_vars_out) {
 
     char charbuf[1024]; // to construct some strings
 
-    // create pipes (delete old ones, if still present)
-    char pipeParsed[64], pipeDirectives[64], pipeFeedback[64];
-    snprintf(pipeParsed, 64, ".parsed.%lu.pipe", checker_instance_id);
-    snprintf(pipeDirectives, 64, ".directives.%lu.pipe", checker_instance_id);
-    snprintf(pipeFeedback, 64, ".feedback.%lu.pipe", checker_instance_id);
-    create_pipe(pipeParsed);
-    create_pipe(pipeDirectives);
-    create_pipe(pipeFeedback);
-
     // Fork off a parser process.
     if (do_fork()) {
         // child: parser process
-        snprintf(charbuf, 1024, "build/impcheck_parse -formula-input=%s -fifo-parsed-formula=%s",
-            cnfInput, pipeParsed);
+        snprintf(charbuf, 1024, "build/impcheck_parse -formula-input=%s -fifo-parsed-formula=%s%s%s",
+            cnfInput, pipeParsed, image_or_null ? " -formula-image=" : "", image_or_null ? image_or_null : "");
         int res = system(charbuf);
         do_assert(res == 0);
         exit(0); // child process done
@@ -80,7 +73,7 @@ u64 setup(const char* cnfInput, FILE** f_directives_out, FILE** f_feedback_out)
 
     // read parsed formula
     FILE* in_parsed = fopen(pipeParsed, "r");
-    const int nb_vars = trusted_utils_read_int(in_parsed);
+    *nb_vars_out = trusted_utils_read_int(in_parsed);
     /*const int nb_clauses = */trusted_utils_read_int(in_parsed);
     struct int_vec* fvec = int_vec_init(1<<14);
     while (true) {
@@ -90,19 +83,48 @@ u64 setup(const char* cnfInput, FILE** f_directives_out, FILE** f_feedback_out)
         if (nb_read == 0) break;
         int_vec_push(fvec, lit);
     }
+    // wait for parser process to exit (equivalent to "join")
+    wait(0);
+    fclose(in_parsed);
+    return fvec;
+}
+
+// Set up a ready-to-go trusted checker process.
+// - create all named pipes needed for inter-process communication
+// - run a trusted parser instance and read the parsed formula
+//   together with its signature
+// - launch a trusted checker instance and forward the formula
+//   with its signature
+// - return an ID which is needed for the corresponding clean_up() below
+// - return the file handles for writing directives and for reading
+//   feedback via the two out params
+// The checker is launched with the given additional arguments.
+u64 setup_with_args(const char* cnfInput, const char* extra_args, FILE** f_directives_out, FILE** f_feedback_out) {
+
+    char charbuf[1024]; // to construct some strings
+
+    // create pipes (delete old ones, if still present)
+    char pipeParsed[64], pipeDirectives[64], pipeFeedback[64];
+    snprintf(pipeParsed, 64, ".parsed.%lu.pipe", checker_instance_id);
+    snprintf(pipeDirectives, 64, ".directives.%lu.pipe", checker_instance_id);
+    snprintf(pipeFeedback, 64, ".feedback.%lu.pipe", checker_instance_id);
+    create_pipe(pipeParsed);
+    create_pipe(pipeDirectives);
+    create_pipe(pipeFeedback);
+
+    // parse formula
+    int nb_vars;
+    struct int_vec* fvec = parse(cnfInput, pipeParsed, 0, &nb_vars);
     const int* f = fvec->data;
     // the last SIG_SIZE_BYTES bytes of the "formula" are actually its signature
     const u8* fsig = ((u8*) (fvec->data + fvec->size)) - SIG_SIZE_BYTES;
     const u64 fsize = fvec->size - (SIG_SIZE_BYTES / sizeof(int));
-    // wait for parser process to exit (equivalent to "join")
-    wait(0);
-    fclose(in_parsed);
 
     // Fork off a checker process.
     if (do_fork()) {
         // child: checker process
-        snprintf(charbuf, 1024, "build/impcheck_check -fifo-directives=%s -fifo-feedback=%s -check-model",
-            pipeDirectives, pipeFeedback);
+        snprintf(charbuf, 1024, "build/impcheck_check -fifo-directives=%s -fifo-feedback=%s -check-model%s",
+            pipeDirectives, pipeFeedback, extra_args);
         int res = system(charbuf);
         do_assert(res == 0);
         exit(0); // child process done
@@ -141,6 +163,74 @@ u64 setup(const char* cnfInput, FILE** f_directives_out, FILE** f_feedback_out)
     // increment our checker ID for the next call
     return checker_instance_id++;
 }
+u64 setup(const char* cnfInput, FILE** f_directives_out, FILE** f_feedback_out) {
+    return setup_with_args(cnfInput, "", f_directives_out, f_feedback_out);
+}
+
+// Like setup_with_args(), but launches a single checker process which serves
+// two streams of directives. Only the first stream loads the formula; the
+// second stream only needs to present the formula's signature.
+u64 setup_two_streams(const char* cnfInput, const char* extra_args, FILE** f_directives_out, FILE** f_feedback_out) {
+
+    char charbuf[1024];
+
+    // Each of the two streams gets its own pair of pipes, indexed by
+    // checker_instance_id and checker_instance_id+1, respectively.
+    char pipeParsed[64], pipeDirectives[2][64], pipeFeedback[2][64];
+    snprintf(pipeParsed, 64, ".parsed.%lu.pipe", checker_instance_id);
+    create_pipe(pipeParsed);
+    for (int s = 0; s < 2; s++) {
+        snprintf(pipeDirectives[s], 64, ".directives.%lu.pipe", checker_instance_id+s);
+        snprintf(pipeFeedback[s], 64, ".feedback.%lu.pipe", checker_instance_id+s);
+        create_pipe(pipeDirectives[s]);
+        create_pipe(pipeFeedback[s]);
+    }
+
+    int nb_vars;
+    struct int_vec* fvec = parse(cnfInput, pipeParsed, 0, &nb_vars);
+    const u8* fsig = ((u8*) (fvec->data + fvec->size)) - SIG_SIZE_BYTES;
+    const u64 fsize = fvec->size - (SIG_SIZE_BYTES / sizeof(int));
+
+    if (do_fork()) {
+        snprintf(charbuf, 1024, "build/impcheck_check -fifo-directives=%s -fifo-feedback=%s "
+            "-fifo-directives=%s -fifo-feedback=%s -check-model%s",
+            pipeDirectives[0], pipeFeedback[0], pipeDirectives[1], pipeFeedback[1], extra_args);
+        int res = system(charbuf);
+        do_assert(res == 0);
+        exit(0);
+    }
+
+    // First stream: load the formula as usual
+    FILE* out_directives = fopen(pipeDirectives[0], "w");
+    FILE* in_feedback = fopen(pipeFeedback[0], "r");
+    trusted_utils_write_char(TRUSTED_CHK_INIT, out_directives);
+    trusted_utils_write_int(nb_vars, out_directives);
+    trusted_utils_write_sig(fsig, out_directives);
+    await_ok(out_directives, in_feedback);
+    trusted_utils_write_char(TRUSTED_CHK_LOAD, out_directives);
+    trusted_utils_write_int(fsize, out_directives);
+    trusted_utils_write_ints(fvec->data, fsize, out_directives);
+    trusted_utils_write_char(TRUSTED_CHK_END_LOAD, out_directives);
+    await_ok(out_directives, in_feedback);
+    f_directives_out[0] = out_directives;
+    f_feedback_out[0] = in_feedback;
+
+    // Second stream: no LOAD directives
+    out_directives = fopen(pipeDirectives[1], "w");
+    in_feedback = fopen(pipeFeedback[1], "r");
+    trusted_utils_write_char(TRUSTED_CHK_INIT, out_directives);
+    trusted_utils_write_int(nb_vars, out_directives);
+    trusted_utils_write_sig(fsig, out_directives);
+    await_ok(out_directives, in_feedback);
+    trusted_utils_write_char(TRUSTED_CHK_END_LOAD, out_directives);
+    await_ok(out_directives, in_feedback);
+    f_directives_out[1] = out_directives;
+    f_feedback_out[1] = in_feedback;
+
+    int_vec_free(fvec);
+    checker_instance_id += 2;
+    return checker_instance_id-2;
+}
 
 bool confirm(const char* cnfInput, int result, const u8* sig) {
 
@@ -157,6 +247,21 @@ bool confirm(const char* cnfInput, int result, const u8* sig) {
     return res == 0;
 }
 
+// Confirm the result of an incremental run whose formula has been extended
+// by the given increment; assumptions_or_null is a comma-separated list.
+bool confirm_incremental(const char* cnfInput, const char* increment, const char* assumptions_or_null,
+    int result, const u8* sig) {
+
+    char sigstr[2*SIG_SIZE_BYTES+1];
+    trusted_utils_sig_to_str(sig, sigstr);
+    char charbuf[1024];
+    snprintf(charbuf, 1024, "build/impcheck_confirm -formula-input=%s -increment=%s%s%s -result=%i -result-sig=%s",
+        cnfInput, increment, assumptions_or_null ? " -assumptions=" : "",
+        assumptions_or_null ? assumptions_or_null : "", result, sigstr);
+    const int res = system(charbuf);
+    return res == 0;
+}
+
 // Clean up a checker process previously opened via "setup". The checker must already
 // have received and responded to a TERMINATE directive beforehand.
 void clean_up(u64 checker_id, FILE* out_directives, FILE* in_feedback) {
@@ -223,6 +328,65 @@ void delete_cls(FILE* out_directives, FILE* in_feedback, const u64* ids, int nb_
     await_ok(out_directives, in_feedback);
 }
 
+// Helper method to delete ranges of clauses, each given as first ID,
+// number of IDs, and stride. Returns whether the checker accepted.
+bool delete_ranges(FILE* out_directives, FILE* in_feedback, const u64* ranges, int nb_ranges) {
+
+    trusted_utils_write_char(TRUSTED_CHK_CLS_DELETE_RANGES, out_directives);
+    trusted_utils_write_int(nb_ranges, out_directives);
+    trusted_utils_write_uls(ranges, 3*nb_ranges, out_directives);
+    fflush(out_directives);
+    return trusted_utils_read_char(in_feedback) == TRUSTED_CHK_RES_ACCEPT;
+}
+
+// Helper method to delete the clauses marked in a bitmap.
+// Returns whether the checker accepted.
+bool delete_bitmap(FILE* out_directives, FILE* in_feedback, u64 base_id, const u64* words, int nb_words) {
+
+    trusted_utils_write_char(TRUSTED_CHK_CLS_DELETE_BITMAP, out_directives);
+    trusted_utils_write_ul(base_id, out_directives);
+    trusted_utils_write_int(nb_words, out_directives);
+    trusted_utils_write_uls(words, nb_words, out_directives);
+    fflush(out_directives);
+    return trusted_utils_read_char(in_feedback) == TRUSTED_CHK_RES_ACCEPT;
+}
+
+// Helper method to query the checker's performance metrics. Returns
+// a null-terminated string which must be freed by the caller.
+char* query_stats(FILE* out_directives, FILE* in_feedback) {
+
+    trusted_utils_write_char(TRUSTED_CHK_QUERY_STATS, out_directives);
+    await_ok(out_directives, in_feedback);
+    const int len = trusted_utils_read_int(in_feedback);
+    char* report = trusted_utils_malloc(len+1);
+    do_assert(fread(report, 1, len, in_feedback) == (u64) len);
+    report[len] = '\0';
+    return report;
+}
+
+// Helper method to validate unsatisfiability once the empty clause has
+// been derived and to confirm the returned signature for the given formula.
+void validate_unsat(FILE* out_directives, FILE* in_feedback, const char* cnf, u8* unsat_sig) {
+
+    trusted_utils_write_char(TRUSTED_CHK_VALIDATE_UNSAT, out_directives);
+    await_ok(out_directives, in_feedback);
+    trusted_utils_read_sig(unsat_sig, in_feedback);
+    do_assert(confirm(cnf, 20, unsat_sig));
+}
+
+// Helper method to derive the empty clause for cnf/trivial-unsat.cnf as in
+// test_trivial_unsat() (clauses 5, 6, 7), validate and confirm the result.
+void derive_trivial_unsat(FILE* out_directives, FILE* in_feedback, const char* cnf, u8* unsat_sig) {
+
+    const int cls_5[1] = {1}; const u64 hints_5[2] = {1, 2};
+    produce_cls(out_directives, in_feedback, 5, 1, cls_5, 2, hints_5, 0);
+    const int cls_6[1] = {-1}; const u64 hints_6[2] = {3, 4};
+    produce_cls(out_directives, in_feedback, 6, 1, cls_6, 2, hints_6, 0);
+    const u64 hints_7[2] = {5, 6};
+    produce_cls(out_directives, in_feedback, 7, 0, 0, 2, hints_7, 0);
+    validate_unsat(out_directives, in_feedback, cnf, unsat_sig);
+}
+
 
 
 
@@ -298,6 +462,54 @@ void test_trivial_unsat() {
     printf("[TEST] ---  end  test_trivial_unsat() ---\n\n");
 }
 
+/*
+The derivations of test_trivial_unsat() with performance metrics enabled.
+The body of the first derivation arrives late, which must be accounted
+as waiting for input rather than as processing the derivation.
+*/
+void test_trivial_unsat_stats() {
+    printf("[TEST] --- begin test_trivial_unsat_stats() ---\n");
+
+    const char* cnf = "cnf/trivial-unsat.cnf";
+    FILE *out_directives, *in_feedback;
+    u64 chkid = setup_with_args(cnf, " -stats", &out_directives, &in_feedback);
+
+    // PRODUCE, with a pause of 200ms within the first directive
+    const int cls_5[1] = {1}; const u64 hints_5[2] = {1, 2};
+    trusted_utils_write_char(TRUSTED_CHK_CLS_PRODUCE, out_directives);
+    trusted_utils_write_ul(5, out_directives);
+    fflush(out_directives);
+    usleep(200 * 1000);
+    trusted_utils_write_int(1, out_directives);
+    trusted_utils_write_ints(cls_5, 1, out_directives);
+    trusted_utils_write_int(2, out_directives);
+    trusted_utils_write_uls(hints_5, 2, out_directives);
+    trusted_utils_write_bool(false, out_directives);
+    await_ok(out_directives, in_feedback);
+    const int cls_6[1] = {-1}; const u64 hints_6[2] = {3, 4};
+    produce_cls(out_directives, in_feedback, 6, 1, cls_6, 2, hints_6, 0);
+    const u64 hints_7[2] = {5, 6};
+    produce_cls(out_directives, in_feedback, 7, 0, 0, 2, hints_7, 0);
+
+    // QUERY_STATS: all three derivations must have been recorded
+    char* report = query_stats(out_directives, in_feedback);
+    do_assert(strstr(report, "latency_ns.produce count=3 ") != 0);
+    do_assert(strstr(report, "hints_per_derivation count=3 sum=6 ") != 0);
+    do_assert(strstr(report, "clauses produced_live=3 produced_total=3 ") != 0);
+    const char* input_wait = strstr(report, "input_wait_ns=");
+    const char* produce_sum = strstr(report, "latency_ns.produce count=3 sum=");
+    do_assert(input_wait && produce_sum);
+    do_assert(strtoul(input_wait + strlen("input_wait_ns="), 0, 10) >= 200UL * 1000 * 1000);
+    do_assert(strtoul(produce_sum + strlen("latency_ns.produce count=3 sum="), 0, 10) < 100UL * 1000 * 1000);
+    free(report);
+
+    u8 unsat_sig[SIG_SIZE_BYTES];
+    validate_unsat(out_directives, in_feedback, cnf, unsat_sig);
+
+    clean_up(chkid, out_directives, in_feedback);
+    printf("[TEST] ---  end  test_trivial_unsat_stats() ---\n\n");
+}
+
 /*
 Full "trusted solving" run on the same formula as in test_trivial_unsat()
 but now with two checker sub-processes at once.
@@ -334,23 +546,713 @@ void test_trivial_unsat_x2() {
     produce_cls(out_directives_1, in_feedback_1, 7, 0, 0, 2, hints_7, false);
 
     // VALIDATE_UNSAT
-    trusted_utils_write_char(TRUSTED_CHK_VALIDATE_UNSAT, out_directives_1);
-    await_ok(out_directives_1, in_feedback_1);
     u8 unsat_sig[SIG_SIZE_BYTES];
-    trusted_utils_read_sig(unsat_sig, in_feedback_1);
+    validate_unsat(out_directives_1, in_feedback_1, cnf, unsat_sig);
 
-    // (optional) confirm with "confirmer" module
-    bool ok = confirm(cnf, 20, unsat_sig);
-    do_assert(ok);
-    
     // TERMINATE
     clean_up(chkid_1, out_directives_1, in_feedback_1);
     clean_up(chkid_2, out_directives_2, in_feedback_2);
     printf("[TEST] ---  end  test_trivial_unsat_x2() ---\n\n");
 }
 
+/*
+Same as test_trivial_unsat_x2(), but with a single checker process
+which serves both streams and loads the formula only once. The second run
+enables performance metrics, which wrap the checker's input stream.
+After the first stream has terminated, no process may hold its pipe open.
+*/
+void test_trivial_unsat_two_streams() {
+    printf("[TEST] --- begin test_trivial_unsat_two_streams() ---\n");
+
+    const char* cnf = "cnf/trivial-unsat.cnf";
+    const char* extra_args[2] = {"", " -stats"};
+    for (int run = 0; run < 2; run++) {
+        FILE *out_directives[2], *in_feedback[2];
+        u64 chkid = setup_two_streams(cnf, extra_args[run], out_directives, in_feedback);
+
+        // PRODUCE
+        const int cls_5[1] = {1}; const u64 hints_5[2] = {1, 2}; u8 sig_5[SIG_SIZE_BYTES];
+        produce_cls(out_directives[0], in_feedback[0], 5, 1, cls_5, 2, hints_5, sig_5);
+        const int cls_6[1] = {-1}; const u64 hints_6[2] = {3, 4}; u8 sig_6[SIG_SIZE_BYTES];
+        produce_cls(out_directives[1], in_feedback[1], 6, 1, cls_6, 2, hints_6, sig_6);
+
+        // IMPORT
+        import_cls(out_directives[0], in_feedback[0], 6, 1, cls_6, sig_6);
+
+        // PRODUCE
+        const u64 hints_7[2] = {5, 6};
+        produce_cls(out_directives[0], in_feedback[0], 7, 0, 0, 2, hints_7, false);
+
+        // VALIDATE_UNSAT
+        u8 unsat_sig[SIG_SIZE_BYTES];
+        validate_unsat(out_directives[0], in_feedback[0], cnf, unsat_sig);
+
+        // TERMINATE the first stream without waiting for any process
+        // (the checker process only exits once all of its streams are done)
+        trusted_utils_write_char(TRUSTED_CHK_TERMINATE, out_directives[0]);
+        await_ok(out_directives[0], in_feedback[0]);
+        fclose(out_directives[0]);
+        fclose(in_feedback[0]);
+        // Its directives pipe is released (opening it without a reader fails)
+        char pipe[64];
+        snprintf(pipe, 64, ".directives.%lu.pipe", chkid);
+        int fd = -1;
+        for (int i = 0; i < 200; i++) {
+            fd = open(pipe, O_WRONLY | O_NONBLOCK);
+            if (fd < 0 && errno == ENXIO) break;
+            if (fd >= 0) close(fd);
+            usleep(10 * 1000);
+        }
+        do_assert(fd < 0 && errno == ENXIO);
+        remove(pipe);
+        snprintf(pipe, 64, ".feedback.%lu.pipe", chkid); remove(pipe);
+        snprintf(pipe, 64, ".parsed.%lu.pipe", chkid); remove(pipe);
+        // TERMINATE the second stream and clean up everything
+        clean_up(chkid+1, out_directives[1], in_feedback[1]);
+    }
+    printf("[TEST] ---  end  test_trivial_unsat_two_streams() ---\n\n");
+}
+
+/*
+Same as test_trivial_unsat(), but the checker maps a binary formula image
+written by the parser instead of receiving the formula via LOAD directives.
+*/
+void test_trivial_unsat_image() {
+    printf("[TEST] --- begin test_trivial_unsat_image() ---\n");
+
+    const char* cnf = "cnf/trivial-unsat.cnf";
+    char charbuf[1024], pipeParsed[64], pipeDirectives[64], pipeFeedback[64], image[64];
+    snprintf(pipeParsed, 64, ".parsed.%lu.pipe", checker_instance_id);
+    snprintf(pipeDirectives, 64, ".directives.%lu.pipe", checker_instance_id);
+    snprintf(pipeFeedback, 64, ".feedback.%lu.pipe", checker_instance_id);
+    snprintf(image, 64, ".formula.%lu.img", checker_instance_id);
+    create_pipe(pipeParsed);
+    create_pipe(pipeDirectives);
+    create_pipe(pipeFeedback);
+
+    // Parse the formula, also writing the image
+    int nb_vars;
+    struct int_vec* fvec = parse(cnf, pipeParsed, image, &nb_vars);
+    const u8* fsig = ((u8*) (fvec->data + fvec->size)) - SIG_SIZE_BYTES;
+
+    if (do_fork()) {
+        snprintf(charbuf, 1024, "build/impcheck_check -fifo-directives=%s -fifo-feedback=%s -formula-image=%s",
+            pipeDirectives, pipeFeedback, image);
+        int res = system(charbuf);
+        do_assert(res == 0);
+        exit(0);
+    }
+    FILE* out_directives = fopen(pipeDirectives, "w");
+    FILE* in_feedback = fopen(pipeFeedback, "r");
+
+    // INIT and END_LOAD, but no LOAD directives
+    trusted_utils_write_char(TRUSTED_CHK_INIT, out_directives);
+    trusted_utils_write_int(nb_vars, out_directives);
+    trusted_utils_write_sig(fsig, out_directives);
+    await_ok(out_directives, in_feedback);
+    trusted_utils_write_char(TRUSTED_CHK_END_LOAD, out_directives);
+    await_ok(out_directives, in_feedback);
+    int_vec_free(fvec);
+
+    // PRODUCE and VALIDATE_UNSAT
+    u8 unsat_sig[SIG_SIZE_BYTES];
+    derive_trivial_unsat(out_directives, in_feedback, cnf, unsat_sig);
+
+    // TERMINATE
+    clean_up(checker_instance_id++, out_directives, in_feedback);
+    remove(image);
+    printf("[TEST] ---  end  test_trivial_unsat_image() ---\n\n");
+}
+
+/*
+Full "trusted solving" run on a gzip-compressed copy of the formula in
+test_trivial_unsat(). The result is confirmed both with the compressed
+and with the original file since both must yield the same signature.
+The file name starts with a dash so that the decompressor must not take it
+for an option.
+*/
+void test_trivial_unsat_compressed() {
+    printf("[TEST] --- begin test_trivial_unsat_compressed() ---\n");
+
+    const char* cnf = "-trivial-unsat.cnf.gz";
+    int res = system("gzip -c cnf/trivial-unsat.cnf > ./-trivial-unsat.cnf.gz");
+    do_assert(res == 0);
+    FILE *out_directives, *in_feedback;
+    u64 chkid = setup(cnf, &out_directives, &in_feedback);
+
+    u8 unsat_sig[SIG_SIZE_BYTES];
+    derive_trivial_unsat(out_directives, in_feedback, cnf, unsat_sig);
+    bool ok = confirm("cnf/trivial-unsat.cnf", 20, unsat_sig);
+    do_assert(ok);
+
+    clean_up(chkid, out_directives, in_feedback);
+    remove(cnf);
+    printf("[TEST] ---  end  test_trivial_unsat_compressed() ---\n\n");
+}
+
+/*
+Offline checking of an LRAT proof file for the formula in test_trivial_unsat(),
+in textual and binary form, and rejection of an incorrect proof.
+*/
+void test_trivial_unsat_lrat_file() {
+    printf("[TEST] --- begin test_trivial_unsat_lrat_file() ---\n");
+
+    const char* cnf = "cnf/trivial-unsat.cnf";
+    char charbuf[1024];
+
+    FILE* f = fopen(".trivial-unsat.lrat", "w");
+    fprintf(f, "5 1 0 1 2 0\n5 d 1 2 0\n6 -1 0 3 4 0\n7 0 5 6 0\n");
+    fclose(f);
+    snprintf(charbuf, 1024, "build/impcheck_check -formula-input=%s -lrat-proof=.trivial-unsat.lrat", cnf);
+    int res = system(charbuf);
+    do_assert(res == 0);
+
+    // binary: 'a' / 'd', each number x as 2x (or -2x+1 if negative)
+    const unsigned char binary[] = {'a', 10, 2, 0, 2, 4, 0, 'd', 2, 4, 0,
+        'a', 12, 3, 0, 6, 8, 0, 'a', 14, 0, 10, 12, 0};
+    f = fopen(".trivial-unsat.blrat", "w");
+    fwrite(binary, 1, sizeof(binary), f);
+    fclose(f);
+    snprintf(charbuf, 1024, "build/impcheck_check -formula-input=%s -lrat-proof=.trivial-unsat.blrat", cnf);
+    res = system(charbuf);
+    do_assert(res == 0);
+
+    // the empty clause cannot be derived from clauses 5 and 1
+    f = fopen(".trivial-unsat.lrat", "w");
+    fprintf(f, "5 1 0 1 2 0\n6 0 5 1 0\n");
+    fclose(f);
+    snprintf(charbuf, 1024, "build/impcheck_check -formula-input=%s -lrat-proof=.trivial-unsat.lrat", cnf);
+    res = system(charbuf);
+    do_assert(res != 0);
+
+    // clause 6 is incorrect but not needed for the empty clause:
+    // rejected by forward checking, accepted with backward marking
+    f = fopen(".trivial-unsat.lrat", "w");
+    fprintf(f, "5 1 0 1 2 0\n6 2 0 1 0\n7 -1 0 3 4 0\n8 0 5 7 0\n");
+    fclose(f);
+    res = system(charbuf);
+    do_assert(res != 0);
+    snprintf(charbuf, 1024, "build/impcheck_check -formula-input=%s -lrat-proof=.trivial-unsat.lrat -backward", cnf);
+    res = system(charbuf);
+    do_assert(res == 0);
+
+    // derivations without hints: only accepted with -rup-fallback,
+    // and only as long as unit propagation yields a conflict
+    f = fopen(".trivial-unsat.lrat", "w");
+    fprintf(f, "5 1 0 0\n5 d 1 2 0\n6 -1 0 0\n7 0 0\n");
+    fclose(f);
+    snprintf(charbuf, 1024, "build/impcheck_check -formula-input=%s -lrat-proof=.trivial-unsat.lrat", cnf);
+    res = system(charbuf);
+    do_assert(res != 0);
+    snprintf(charbuf, 1024, "build/impcheck_check -formula-input=%s -lrat-proof=.trivial-unsat.lrat -rup-fallback", cnf);
+    res = system(charbuf);
+    do_assert(res == 0);
+    f = fopen(".trivial-unsat.lrat", "w");
+    fprintf(f, "5 1 0 0\n5 d 3 0\n6 -1 0 0\n7 0 0\n");
+    fclose(f);
+    res = system(charbuf);
+    do_assert(res != 0);
+
+    remove(".trivial-unsat.lrat");
+    remove(".trivial-unsat.blrat");
+    printf("[TEST] ---  end  test_trivial_unsat_lrat_file() ---\n\n");
+}
+
+// Send a CHECKPOINT directive for the given path (empty: await the snapshot
+// being written) and return whether it is answered with OK.
+bool checkpoint(FILE* out, FILE* in, const char* path) {
+    trusted_utils_write_char(TRUSTED_CHK_CHECKPOINT, out);
+    trusted_utils_write_int(strlen(path), out);
+    fwrite(path, 1, strlen(path), out);
+    fflush(out);
+    return trusted_utils_read_char(in) == TRUSTED_CHK_RES_ACCEPT;
+}
+
+/*
+Same as test_trivial_unsat(), but the checker is checkpointed after the
+first two derivations and terminated. The proof is then concluded by a
+new checker restored from the snapshot, without loading the formula.
+*/
+void test_trivial_unsat_checkpoint() {
+    printf("[TEST] --- begin test_trivial_unsat_checkpoint() ---\n");
+
+    const char* cnf = "cnf/trivial-unsat.cnf";
+    char charbuf[1024], snapshot[64];
+    snprintf(snapshot, 64, ".checker.%lu.snap", checker_instance_id);
+    remove(snapshot);
+    FILE *out_directives, *in_feedback;
+    u64 chkid = setup(cnf, &out_directives, &in_feedback);
+
+    // PRODUCE the first two clauses
+    const int cls_5[1] = {1}; const u64 hints_5[2] = {1, 2};
+    produce_cls(out_directives, in_feedback, 5, 1, cls_5, 2, hints_5, 0);
+    const int cls_6[1] = {-1}; const u64 hints_6[2] = {3, 4};
+    produce_cls(out_directives, in_feedback, 6, 1, cls_6, 2, hints_6, 0);
+
+    // CHECKPOINT to a path which cannot be written: writing begins in the
+    // background, and the failure is reported when awaiting it
+    do_assert(checkpoint(out_directives, in_feedback, ".no-such-dir/checker.snap"));
+    do_assert(!checkpoint(out_directives, in_feedback, ""));
+
+    // CHECKPOINT, which is written in the background, and await it
+    do_assert(checkpoint(out_directives, in_feedback, snapshot));
+    do_assert(checkpoint(out_directives, in_feedback, ""));
+    do_assert(access(snapshot, R_OK) == 0);
+    clean_up(chkid, out_directives, in_feedback);
+
+    // A tampered snapshot must be rejected
+    FILE* f = fopen(snapshot, "r");
+    FILE* f_bad = fopen(".checker.bad.snap", "w");
+    int c;
+    for (long pos = 0; (c = fgetc(f)) != EOF; pos++) fputc(pos == 100 ? c ^ 1 : c, f_bad);
+    fclose(f);
+    fclose(f_bad);
+    snprintf(charbuf, 1024, "build/impcheck_check -fifo-directives=.x -fifo-feedback=.y -restore=.checker.bad.snap");
+    do_assert(system(charbuf) != 0);
+    remove(".checker.bad.snap");
+
+    // Further streams would inherit the restored clauses, so a restored
+    // checker must be refused more than one stream
+    snprintf(charbuf, 1024, "build/impcheck_check -fifo-directives=.x -fifo-feedback=.y "
+        "-fifo-directives=.x2 -fifo-feedback=.y2 -restore=%s", snapshot);
+    do_assert(system(charbuf) != 0);
+
+    // Restore a checker from the snapshot
+    checker_instance_id++;
+    char pipeDirectives[64], pipeFeedback[64];
+    snprintf(pipeDirectives, 64, ".directives.%lu.pipe", checker_instance_id);
+    snprintf(pipeFeedback, 64, ".feedback.%lu.pipe", checker_instance_id);
+    create_pipe(pipeDirectives);
+    create_pipe(pipeFeedback);
+    if (do_fork()) {
+        snprintf(charbuf, 1024, "build/impcheck_check -fifo-directives=%s -fifo-feedback=%s -restore=%s",
+            pipeDirectives, pipeFeedback, snapshot);
+        int res = system(charbuf);
+        do_assert(res == 0);
+        exit(0);
+    }
+    out_directives = fopen(pipeDirectives, "w");
+    in_feedback = fopen(pipeFeedback, "r");
+
+    // INIT and END_LOAD, but no LOAD directives
+    int nb_vars;
+    char pipeParsed[64];
+    snprintf(pipeParsed, 64, ".parsed.%lu.pipe", checker_instance_id);
+    create_pipe(pipeParsed);
+    struct int_vec* fvec = parse(cnf, pipeParsed, 0, &nb_vars);
+    const u8* fsig = ((u8*) (fvec->data + fvec->size)) - SIG_SIZE_BYTES;
+    trusted_utils_write_char(TRUSTED_CHK_INIT, out_directives);
+    trusted_utils_write_int(nb_vars, out_directives);
+    trusted_utils_write_sig(fsig, out_directives);
+    await_ok(out_directives, in_feedback);
+    trusted_utils_write_char(TRUSTED_CHK_END_LOAD, out_directives);
+    await_ok(out_directives, in_feedback);
+    int_vec_free(fvec);
+
+    // PRODUCE the empty clause from the restored clauses
+    const u64 hints_7[2] = {5, 6};
+    produce_cls(out_directives, in_feedback, 7, 0, 0, 2, hints_7, 0);
+
+    // VALIDATE_UNSAT
+    u8 unsat_sig[SIG_SIZE_BYTES];
+    validate_unsat(out_directives, in_feedback, cnf, unsat_sig);
+
+    // TERMINATE
+    clean_up(checker_instance_id++, out_directives, in_feedback);
+    remove(snapshot);
+    printf("[TEST] ---  end  test_trivial_unsat_checkpoint() ---\n\n");
+}
+
+/*
+Same as test_trivial_unsat(), but with additional derivations which are
+deleted again via ranges and bitmaps of IDs.
+*/
+void test_trivial_unsat_delete_ranges() {
+    printf("[TEST] --- begin test_trivial_unsat_delete_ranges() ---\n");
+
+    const char* cnf = "cnf/trivial-unsat.cnf";
+    FILE *out_directives, *in_feedback;
+    u64 chkid = setup(cnf, &out_directives, &in_feedback);
+
+    // PRODUCE copies of clause 5 with IDs 10, 11, ..., 19
+    const int cls_5[1] = {1}; const u64 hints_5[2] = {1, 2};
+    for (u64 id = 10; id < 20; id++)
+        produce_cls(out_directives, in_feedback, id, 1, cls_5, 2, hints_5, 0);
+
+    // DELETE the even IDs as a strided range, 11 and 13 via a bitmap
+    const u64 ranges[3] = {10, 5, 2};
+    do_assert(delete_ranges(out_directives, in_feedback, ranges, 1));
+    const u64 words[1] = {(1UL << 1) | (1UL << 3)};
+    do_assert(delete_bitmap(out_directives, in_feedback, 10, words, 1));
+    // 12, 13, 14, 16 are gone, so these deletions must fail
+    const u64 ranges_gone[3] = {12, 2, 1};
+    do_assert(!delete_ranges(out_directives, in_feedback, ranges_gone, 1));
+    do_assert(!delete_bitmap(out_directives, in_feedback, 13, words, 1));
+    // 15, 17, 19 remain
+    const u64 ranges_left[3] = {15, 3, 2};
+    do_assert(delete_ranges(out_directives, in_feedback, ranges_left, 1));
+
+    // PRODUCE and VALIDATE_UNSAT as before
+    u8 unsat_sig[SIG_SIZE_BYTES];
+    derive_trivial_unsat(out_directives, in_feedback, cnf, unsat_sig);
+
+    // TERMINATE
+    clean_up(chkid, out_directives, in_feedback);
+    printf("[TEST] ---  end  test_trivial_unsat_delete_ranges() ---\n\n");
+}
+
+/*
+Incremental run on the formula of test_trivial_sat(), which is extended by
+an increment (3) 1 -2 0 after loading. Under the assumption 2, this is
+unsatisfiable:
+4  -2  0  3 2 0
+Afterwards, the extended formula is still satisfiable.
+*/
+void test_trivial_sat_incremental() {
+    printf("[TEST] --- begin test_trivial_sat_incremental() ---\n");
+
+    const char* cnf = "cnf/trivial-sat.cnf";
+    const char* cnf_increment = "cnf/trivial-sat-increment.cnf";
+    FILE *out_directives, *in_feedback;
+    u64 chkid = setup(cnf, &out_directives, &in_feedback);
+
+    // Parse the increment like a formula of its own
+    char pipeParsed[64];
+    snprintf(pipeParsed, 64, ".parsed.%lu.pipe", checker_instance_id++);
+    create_pipe(pipeParsed);
+    int nb_vars;
+    struct int_vec* ivec = parse(cnf_increment, pipeParsed, 0, &nb_vars);
+    remove(pipeParsed);
+    const u8* isig = ((u8*) (ivec->data + ivec->size)) - SIG_SIZE_BYTES;
+    const u64 isize = ivec->size - (SIG_SIZE_BYTES / sizeof(int));
+
+    // ADD_INCREMENT
+    trusted_utils_write_char(TRUSTED_CHK_ADD_INCREMENT, out_directives);
+    trusted_utils_write_ul(3, out_directives);
+    trusted_utils_write_int(isize, out_directives);
+    trusted_utils_write_ints(ivec->data, isize, out_directives);
+    trusted_utils_write_sig(isig, out_directives);
+    await_ok(out_directives, in_feedback);
+    int_vec_free(ivec);
+
+    // PRODUCE and VALIDATE_UNSAT_ASSUMING
+    const int cls_4[1] = {-2}; const u64 hints_4[2] = {3, 2};
+    produce_cls(out_directives, in_feedback, 4, 1, cls_4, 2, hints_4, 0);
+    const int assumptions[1] = {2};
+    trusted_utils_write_char(TRUSTED_CHK_VALIDATE_UNSAT_ASSUMING, out_directives);
+    trusted_utils_write_int(1, out_directives);
+    trusted_utils_write_ints(assumptions, 1, out_directives);
+    trusted_utils_write_ul(4, out_directives);
+    fflush(out_directives);
+    do_assert(trusted_utils_read_char(in_feedback) == TRUSTED_CHK_RES_ACCEPT);
+    u8 unsat_sig[SIG_SIZE_BYTES];
+    trusted_utils_read_sig(unsat_sig, in_feedback);
+    do_assert(confirm_incremental(cnf, cnf_increment, "2", 20, unsat_sig));
+    // The signature is tied to the increment and to the assumptions
+    do_assert(!confirm(cnf, 20, unsat_sig));
+    do_assert(!confirm_incremental(cnf, cnf_increment, 0, 20, unsat_sig));
+    do_assert(!confirm_incremental(cnf, cnf_increment, "-1", 20, unsat_sig));
+
+    // The checker continues: VALIDATE_SAT on the extended formula
+    trusted_utils_write_char(TRUSTED_CHK_VALIDATE_SAT, out_directives);
+    trusted_utils_write_int(2, out_directives);
+    int model[2] = {1, -2};
+    trusted_utils_write_ints(model, 2, out_directives);
+    await_ok(out_directives, in_feedback);
+    u8 sat_sig[SIG_SIZE_BYTES];
+    trusted_utils_read_sig(sat_sig, in_feedback);
+    do_assert(confirm_incremental(cnf, cnf_increment, 0, 10, sat_sig));
+    do_assert(!confirm(cnf, 10, sat_sig));
+
+    // TERMINATE
+    clean_up(chkid, out_directives, in_feedback);
+    printf("[TEST] ---  end  test_trivial_sat_incremental() ---\n\n");
+}
+
+/*
+Same proof as in test_trivial_unsat(), but sent to a checker with
+-overlap-load while the formula is still being loaded: derivation 5 can be
+checked after the first two clauses, 6 and 7 only after all of them. The
+responses arrive once END_LOAD has verified the formula signature, followed
+by the response to a QUERY_STATS directive sent in between.
+The second run presents a wrong formula signature, so that all of these
+directives fail.
+*/
+void test_trivial_unsat_overlap_load() {
+    printf("[TEST] --- begin test_trivial_unsat_overlap_load() ---\n");
+
+    const char* cnf = "cnf/trivial-unsat.cnf";
+    for (int run = 0; run < 2; run++) {
+        const bool corrupt = run == 1;
+        char charbuf[1024], pipeParsed[64], pipeDirectives[64], pipeFeedback[64];
+        snprintf(pipeParsed, 64, ".parsed.%lu.pipe", checker_instance_id);
+        snprintf(pipeDirectives, 64, ".directives.%lu.pipe", checker_instance_id);
+        snprintf(pipeFeedback, 64, ".feedback.%lu.pipe", checker_instance_id);
+        create_pipe(pipeParsed);
+        create_pipe(pipeDirectives);
+        create_pipe(pipeFeedback);
+        int nb_vars;
+        struct int_vec* fvec = parse(cnf, pipeParsed, 0, &nb_vars);
+        u8* fsig = ((u8*) (fvec->data + fvec->size)) - SIG_SIZE_BYTES;
+        const u64 fsize = fvec->size - (SIG_SIZE_BYTES / sizeof(int));
+        if (corrupt) fsig[0] ^= 1;
+        if (do_fork()) {
+            snprintf(charbuf, 1024, "build/impcheck_check -fifo-directives=%s -fifo-feedback=%s -overlap-load",
+                pipeDirectives, pipeFeedback);
+            int res = system(charbuf);
+            do_assert(res == 0);
+            exit(0);
+        }
+        FILE* out_directives = fopen(pipeDirectives, "w");
+        FILE* in_feedback = fopen(pipeFeedback, "r");
+        trusted_utils_write_char(TRUSTED_CHK_INIT, out_directives);
+        trusted_utils_write_int(nb_vars, out_directives);
+        trusted_utils_write_sig(fsig, out_directives);
+        await_ok(out_directives, in_feedback);
+
+        // LOAD clauses 1 and 2 (6 literals), then PRODUCE, then LOAD the rest
+        trusted_utils_write_char(TRUSTED_CHK_LOAD, out_directives);
+        trusted_utils_write_int(6, out_directives);
+        trusted_utils_write_ints(fvec->data, 6, out_directives);
+        const int cls_5[1] = {1}; const u64 hints_5[2] = {1, 2};
+        const int cls_6[1] = {-1}; const u64 hints_6[2] = {3, 4};
+        const u64 hints_7[2] = {5, 6};
+        const int* lits[3] = {cls_5, cls_6, 0};
+        const u64* hints[3] = {hints_5, hints_6, hints_7};
+        for (int i = 0; i < 3; i++) {
+            trusted_utils_write_char(TRUSTED_CHK_CLS_PRODUCE, out_directives);
+            trusted_utils_write_ul(5+i, out_directives);
+            trusted_utils_write_int(lits[i] ? 1 : 0, out_directives);
+            trusted_utils_write_ints(lits[i], lits[i] ? 1 : 0, out_directives);
+            trusted_utils_write_int(2, out_directives);
+            trusted_utils_write_uls(hints[i], 2, out_directives);
+            trusted_utils_write_bool(i == 0, out_directives); // share clause 5
+        }
+        trusted_utils_write_char(TRUSTED_CHK_QUERY_STATS, out_directives);
+        trusted_utils_write_char(TRUSTED_CHK_LOAD, out_directives);
+        trusted_utils_write_int(fsize-6, out_directives);
+        trusted_utils_write_ints(fvec->data+6, fsize-6, out_directives);
+        trusted_utils_write_char(TRUSTED_CHK_END_LOAD, out_directives);
+        fflush(out_directives);
+
+        // withheld responses to the PRODUCE directives, then to END_LOAD
+        const char expected = corrupt ? TRUSTED_CHK_RES_ERROR : TRUSTED_CHK_RES_ACCEPT;
+        u8 sig[SIG_SIZE_BYTES];
+        for (int i = 0; i < 3; i++) {
+            do_assert(trusted_utils_read_char(in_feedback) == expected);
+            if (i == 0) trusted_utils_read_sig(sig, in_feedback);
+        }
+        do_assert(trusted_utils_read_char(in_feedback) == TRUSTED_CHK_RES_ACCEPT);
+        const int len = trusted_utils_read_int(in_feedback);
+        for (int i = 0; i < len; i++) trusted_utils_read_char(in_feedback);
+        do_assert(trusted_utils_read_char(in_feedback) == expected);
+
+        if (!corrupt) validate_unsat(out_directives, in_feedback, cnf, sig);
+        int_vec_free(fvec);
+        clean_up(checker_instance_id++, out_directives, in_feedback);
+    }
+    printf("[TEST] ---  end  test_trivial_unsat_overlap_load() ---\n\n");
+}
+
+/*
+The formula cache stores a digest of the raw input file in the clear. For a
+file which consists of the input of a result signature (formula signature
+and result code), this digest must not be a valid result signature.
+*/
+void test_formula_cache_digest() {
+    printf("[TEST] --- begin test_formula_cache_digest() ---\n");
+
+    const char* cnf = "cnf/trivial-sat.cnf";
+    char pipeParsed[64];
+    snprintf(pipeParsed, 64, ".parsed.%lu.pipe", checker_instance_id++);
+    create_pipe(pipeParsed);
+    int nb_vars;
+    struct int_vec* fvec = parse(cnf, pipeParsed, 0, &nb_vars);
+    const u8* fsig = ((u8*) (fvec->data + fvec->size)) - SIG_SIZE_BYTES;
+    FILE* f = fopen(".forged.cnf", "w");
+    fwrite(fsig, 1, SIG_SIZE_BYTES, f);
+    fputc(20, f);
+    fclose(f);
+    int_vec_free(fvec);
+
+    system("rm -rf .formula_cache && mkdir .formula_cache");
+    int res = system("build/impcheck_parse -formula-input=.forged.cnf -fifo-parsed-formula=/dev/null "
+        "-formula-cache=.formula_cache > /dev/null");
+    do_assert(res == 0);
+    DIR* dir = opendir(".formula_cache");
+    struct dirent* entry;
+    char path[1024] = "";
+    while ((entry = readdir(dir))) {
+        if (strstr(entry->d_name, ".impcache")) snprintf(path, 1024, ".formula_cache/%s", entry->d_name);
+    }
+    closedir(dir);
+    do_assert(path[0] != '\0');
+    struct formula_cache_trailer trailer;
+    f = fopen(path, "r");
+    fseek(f, -(long) sizeof(trailer), SEEK_END);
+    do_assert(fread(&trailer, sizeof(trailer), 1, f) == 1);
+    fclose(f);
+    do_assert(!confirm(cnf, 20, trailer.key.content_digest));
+
+    system("rm -rf .formula_cache .forged.cnf");
+    printf("[TEST] ---  end  test_formula_cache_digest() ---\n\n");
+}
+
+struct client_answers {
+    int nb_accepted;
+    int nb_rejected;
+    u64 last_rejected_id;
+};
+void count_answer(void* user, const struct checker_answer* answer) {
+    struct client_answers* answers = user;
+    if (answer->ok) answers->nb_accepted++;
+    else {
+        answers->nb_rejected++;
+        answers->last_rejected_id = answer->id;
+    }
+}
+
+/*
+The same derivations as in test_trivial_unsat(), but submitted via the
+asynchronous client library without waiting for the individual answers.
+In the second run, the first derivation is unjustified.
+*/
+void test_trivial_unsat_client() {
+    printf("[TEST] --- begin test_trivial_unsat_client() ---\n");
+
+    const char* cnf = "cnf/trivial-unsat.cnf";
+    for (int run = 0; run < 2; run++) {
+        const bool corrupt = run == 1;
+        char pipeParsed[64];
+        snprintf(pipeParsed, 64, ".parsed.%lu.pipe", checker_instance_id++);
+        create_pipe(pipeParsed);
+        int nb_vars;
+        struct int_vec* fvec = parse(cnf, pipeParsed, 0, &nb_vars);
+        const u8* fsig = ((u8*) (fvec->data + fvec->size)) - SIG_SIZE_BYTES;
+        const u64 fsize = fvec->size - (SIG_SIZE_BYTES / sizeof(int));
+
+        struct client_answers answers = {0, 0, 0};
+        struct checker_client_options opts;
+        checker_client_default_options(&opts);
+        do_assert(!checker_client_start(&opts)); // no checker path
+        opts.checker_path = "build/impcheck_check";
+        const char* args[] = {"-check-model", 0};
+        opts.checker_args = args;
+        opts.max_in_flight = 2; // force the client to wait for answers
+        opts.queue_bytes = 16; // force directives to wrap around the queue
+        opts.on_answer = count_answer;
+        opts.user = &answers;
+        struct checker_client* client = checker_client_start(&opts);
+        do_assert(client);
+
+        struct checker_future f_init;
+        do_assert(checker_client_init(client, nb_vars, fsig, &f_init));
+        do_assert(checker_client_load(client, fvec->data, fsize));
+        do_assert(checker_client_end_load(client, 0));
+        do_assert(checker_future_wait(client, &f_init));
+
+        const int cls_5[1] = {1}; const u64 hints_5[2] = {1, 2};
+        const int cls_6[1] = {-1}; const u64 hints_6[2] = {3, 4};
+        const u64 hints_7[2] = {5, 6};
+        struct checker_future f_share;
+        checker_client_produce(client, 5, cls_5, 1, hints_5, corrupt ? 1 : 2, true, &f_share);
+        checker_client_produce(client, 6, cls_6, 1, hints_6, 2, false, 0);
+        checker_client_produce(client, 7, 0, 0, hints_7, 2, false, 0);
+        if (!corrupt) {
+            do_assert(checker_future_wait(client, &f_share));
+            struct checker_future f_unsat;
+            do_assert(checker_client_validate_unsat(client, &f_unsat));
+            do_assert(checker_future_wait(client, &f_unsat));
+            do_assert(confirm(cnf, 20, f_unsat.sig));
+            do_assert(checker_client_sync(client));
+            do_assert(checker_client_stop(client));
+            // INIT, END_LOAD, 3x PRODUCE, VALIDATE_UNSAT, TERMINATE
+            do_assert(answers.nb_accepted == 7 && answers.nb_rejected == 0);
+        } else {
+            do_assert(!checker_future_wait(client, &f_share));
+            do_assert(!checker_client_stop(client));
+            do_assert(answers.nb_rejected >= 1 && answers.last_rejected_id >= 5);
+        }
+        int_vec_free(fvec);
+    }
+    printf("[TEST] ---  end  test_trivial_unsat_client() ---\n\n");
+}
+
+/*
+The derivations of test_trivial_unsat() submitted via the client library
+to a checker with -overlap-load, partly before the formula is loaded.
+Their answers are withheld until END_LOAD, so waiting for them before
+fails instead of blocking, and so does exceeding the in-flight limit.
+*/
+void test_trivial_unsat_client_overlap_load() {
+    printf("[TEST] --- begin test_trivial_unsat_client_overlap_load() ---\n");
+
+    const char* cnf = "cnf/trivial-unsat.cnf";
+    char pipeParsed[64];
+    snprintf(pipeParsed, 64, ".parsed.%lu.pipe", checker_instance_id++);
+    create_pipe(pipeParsed);
+    int nb_vars;
+    struct int_vec* fvec = parse(cnf, pipeParsed, 0, &nb_vars);
+    const u8* fsig = ((u8*) (fvec->data + fvec->size)) - SIG_SIZE_BYTES;
+    const u64 fsize = fvec->size - (SIG_SIZE_BYTES / sizeof(int));
+
+    struct client_answers answers = {0, 0, 0};
+    struct checker_client_options opts;
+    checker_client_default_options(&opts);
+    opts.checker_path = "build/impcheck_check";
+    const char* args[] = {"-overlap-load", 0};
+    opts.checker_args = args;
+    opts.max_in_flight = 2;
+    opts.on_answer = count_answer;
+    opts.user = &answers;
+    struct checker_client* client = checker_client_start(&opts);
+    do_assert(client);
+
+    struct checker_future f_init;
+    do_assert(checker_client_init(client, nb_vars, fsig, &f_init));
+    do_assert(checker_future_wait(client, &f_init));
+
+    const int cls_5[1] = {1}; const u64 hints_5[2] = {1, 2};
+    const int cls_6[1] = {-1}; const u64 hints_6[2] = {3, 4};
+    const u64 hints_7[2] = {5, 6};
+    struct checker_future f_share;
+    do_assert(checker_client_produce(client, 5, cls_5, 1, hints_5, 2, true, &f_share));
+    do_assert(checker_client_produce(client, 6, cls_6, 1, hints_6, 2, false, 0));
+    do_assert(!checker_future_wait(client, &f_share));
+    do_assert(!checker_client_sync(client));
+    do_assert(!checker_client_produce(client, 7, 0, 0, hints_7, 2, false, 0));
+
+    do_assert(checker_client_load(client, fvec->data, fsize));
+    do_assert(checker_client_end_load(client, 0));
+    do_assert(checker_future_wait(client, &f_share));
+    do_assert(checker_client_produce(client, 7, 0, 0, hints_7, 2, false, 0));
+    struct checker_future f_unsat;
+    do_assert(checker_client_validate_unsat(client, &f_unsat));
+    do_assert(checker_future_wait(client, &f_unsat));
+    do_assert(confirm(cnf, 20, f_unsat.sig));
+    do_assert(checker_client_sync(client));
+    do_assert(checker_client_stop(client));
+    // INIT, 2x PRODUCE, END_LOAD, PRODUCE, VALIDATE_UNSAT, TERMINATE
+    do_assert(answers.nb_accepted == 7 && answers.nb_rejected == 0);
+    int_vec_free(fvec);
+
+    printf("[TEST] ---  end  test_trivial_unsat_client_overlap_load() ---\n\n");
+}
+
 int main() {
     test_trivial_sat();
     test_trivial_unsat();
+    test_trivial_unsat_stats();
     test_trivial_unsat_x2();
+    test_trivial_unsat_two_streams();
+    test_trivial_unsat_image();
+    test_trivial_unsat_compressed();
+    test_trivial_unsat_lrat_file();
+    test_trivial_unsat_checkpoint();
+    test_trivial_unsat_delete_ranges();
+    test_trivial_sat_incremental();
+    test_trivial_unsat_overlap_load();
+    test_trivial_unsat_client();
+    test_trivial_unsat_client_overlap_load();
+    test_formula_cache_digest();
 }